@@ -1,22 +1,22 @@
-/* This code should look a lot like the 15-213
- * sample malloc() code.  Guess what...?
+/* This code started out as the 15-213 sample malloc() code, but the
+ * implicit free list has been replaced by segregated free lists.
  */
- 
-/* 
- * Simple allocator based on implicit free lists with boundary 
- * tag coalescing. Each block has header and footer of the form:
- * 
- *      31                     3  2  1  0 
+
+/*
+ * Allocator based on segregated explicit free lists with boundary tag
+ * coalescing. Each block has header and footer of the form:
+ *
+ *      31                     3  2  1  0
  *      -----------------------------------
  *     | s  s  s  s  ... s  s  s  0  0  a/f
- *      ----------------------------------- 
- * 
- * where s are the meaningful size bits and a/f is set 
- * iff the block is allocated. The list has the following form:
+ *      -----------------------------------
+ *
+ * where s are the meaningful size bits and a/f is set
+ * iff the block is allocated. The heap has the following form:
  *
  * begin                                                          end
- * heap                                                           heap  
- *  -----------------------------------------------------------------   
+ * heap                                                           heap
+ *  -----------------------------------------------------------------
  * |  pad   | hdr(8:a) | ftr(8:a) | zero or more usr blks | hdr(8:a) |
  *  -----------------------------------------------------------------
  *          |       prologue      |                       | epilogue |
@@ -24,6 +24,15 @@
  *
  * The allocated prologue and epilogue blocks are overhead that
  * eliminate edge conditions during coalescing.
+ *
+ * The first two words of the payload of a free block are the pred and succ
+ * pointers of a doubly linked free list. There is one list per bin (see
+ * mm_malloc.h): small bins hold blocks of exactly one size and are used
+ * LIFO, large bins cover a power-of-two size range and are kept sorted by
+ * size, so the first fit in a large bin is also the best fit in it. A
+ * request only looks at bins that can hold it instead of walking every
+ * block in the heap, and the heap is extended by at least CHUNKSIZE bytes
+ * at a time so that new_pages() is called rarely.
  */
 #include "mm_malloc.h"
 #include <memlib.h>
@@ -32,15 +41,21 @@
 #include <stdio.h>
 #include <simics.h>
 
-/* The only global variable is a pointer to the first block */
-static char *heap_listp;   
+/* Pointer to the prologue block */
+static char *heap_listp;
+
+/* Heads of the segregated free lists */
+static char *bins[NUM_BINS];
 
 /* function prototypes for internal helper routines */
 static void *extend_heap(int words);
-static void place(void *bp, int asize);
+static void *place(void *bp, int asize);
 static void *find_fit(int asize);
 static void *coalesce(void *bp);
-static void printblock(void *bp); 
+static int bin_index(int size);
+static void insert_free_block(void *bp);
+static void remove_free_block(void *bp);
+static void printblock(void *bp);
 static void checkblock(void *bp);
 
 /* inline helper function */
@@ -50,71 +65,75 @@ min( unsigned int x, unsigned int y )
 	return ( x < y ? x : y );
 }
 
-/* 
- * mm_init - Initialize the memory manager 
+/*
+ * mm_init - Initialize the memory manager
  */
 /* $begin mminit */
-int mm_init(void) 
+int mm_init(void)
 {
-  
+    int i;
+
     /* create the initial empty heap */
-  mem_init(0xffffffff);
-  
-  if ((heap_listp = mem_sbrk(4*WSIZE)) == NULL)
-    return -1;
-  PUT(heap_listp, 0);                        /* alignment padding */
-  PUT(heap_listp+WSIZE, PACK(OVERHEAD, 1));  /* prologue header */ 
-  PUT(heap_listp+DSIZE, PACK(OVERHEAD, 1));  /* prologue footer */ 
-  PUT(heap_listp+WSIZE+DSIZE, PACK(0, 1));   /* epilogue header */
-  heap_listp += DSIZE;
-  
-  /* Extend the empty heap with a free block of CHUNKSIZE bytes */
-  if (extend_heap(CHUNKSIZE/WSIZE) == NULL)
-    return -1;
-  return 0;
+    mem_init(0xffffffff);
+
+    for (i = 0; i < NUM_BINS; i++)
+        bins[i] = NULL;
+
+    if ((heap_listp = mem_sbrk(4*WSIZE)) == NULL)
+        return -1;
+    PUT(heap_listp, 0);                        /* alignment padding */
+    PUT(heap_listp+WSIZE, PACK(OVERHEAD, 1));  /* prologue header */
+    PUT(heap_listp+DSIZE, PACK(OVERHEAD, 1));  /* prologue footer */
+    PUT(heap_listp+WSIZE+DSIZE, PACK(0, 1));   /* epilogue header */
+    heap_listp += DSIZE;
+
+    /* Extend the empty heap with a free block of INITCHUNKSIZE bytes */
+    if (extend_heap(INITCHUNKSIZE/WSIZE) == NULL)
+        return -1;
+    return 0;
 }
-
 /* $end mminit */
 
-/* 
- * mm_malloc - Allocate a block with at least size bytes of payload 
+/*
+ * adjust_size - Adjust a request to include overhead and alignment reqs.
+ */
+static int adjust_size(int size)
+{
+    if (size <= DSIZE)
+        return MINBLOCKSIZE;
+    return DSIZE * ((size + (OVERHEAD) + (DSIZE-1)) / DSIZE);
+}
+
+/*
+ * mm_malloc - Allocate a block with at least size bytes of payload
  */
 /* $begin mmmalloc */
-void *mm_malloc(int size) 
+void *mm_malloc(int size)
 {
     int asize;      /* adjusted block size */
     int extendsize; /* amount to extend heap if no fit */
-    char *bp;      
+    char *bp;
 
     /* Ignore spurious requests */
-    if (size <= 0) {
-		return NULL;
-	 }
-    /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= DSIZE)
-	asize = DSIZE + OVERHEAD;
-    else
-	asize = DSIZE * ((size + (OVERHEAD) + (DSIZE-1)) / DSIZE);
-    
-    /* Search the free list for a fit */
-    if ((bp = find_fit(asize)) != NULL) {
-		place(bp, asize);
-		return bp;
-	 }
-
-    /* No fit found. Get more memory and place the block */
-    extendsize = MAX(asize,CHUNKSIZE);
-    if ((bp = extend_heap(extendsize/WSIZE)) == NULL) {
-		return NULL;
-	 }
-    place(bp, asize);
-    
-    return bp;
-} 
+    if (size <= 0)
+        return NULL;
+
+    asize = adjust_size(size);
+
+    /* Search the free lists for a fit */
+    if ((bp = find_fit(asize)) == NULL) {
+        /* No fit found. Get more memory and place the block */
+        extendsize = MAX(asize, CHUNKSIZE);
+        if ((bp = extend_heap(extendsize/WSIZE)) == NULL)
+            return NULL;
+    }
+
+    return place(bp, asize);
+}
 /* $end mmmalloc */
 
-/* 
- * mm_free - Free a block 
+/*
+ * mm_free - Free a block
  */
 /* $begin mmfree */
 void mm_free(void *bp)
@@ -135,34 +154,56 @@ void mm_free(void *bp)
         coalesce(bp);
     }
 }
-
 /* $end mmfree */
 
-/* Not implemented. For consistency with 15-213 malloc driver */
+/*
+ * mm_realloc - Resize a block, in place if the block itself or the block
+ *              and its free right neighbour are large enough
+ */
 void *mm_realloc(void *ptr, int size)
 {
-	unsigned int old_size;
-	unsigned int *new_chunk;
-
-	new_chunk = mm_malloc( size );
-	if( !new_chunk ) {
-		return NULL;
-	}
-
-	if( ptr ) {
-		old_size = GET_SIZE( HDRP(ptr) );
-		memcpy( new_chunk, ptr, min( old_size, size ) );
-		mm_free( ptr );
-	}
-	return new_chunk;
+    int asize;
+    int old_size;
+    char *new_chunk;
+
+    if (ptr == NULL)
+        return mm_malloc(size);
+    if (size <= 0)
+        return NULL;
+
+    asize = adjust_size(size);
+    old_size = GET_SIZE(HDRP(ptr));
+
+    if (asize <= old_size)
+        return place(ptr, asize);
+
+    if (!GET_ALLOC(HDRP(NEXT_BLKP(ptr))) &&
+        old_size + GET_SIZE(HDRP(NEXT_BLKP(ptr))) >= asize) {
+        /* absorb the free right neighbour */
+        int new_size = old_size + GET_SIZE(HDRP(NEXT_BLKP(ptr)));
+        remove_free_block(NEXT_BLKP(ptr));
+        PUT(HDRP(ptr), PACK(new_size, 1));
+        PUT(FTRP(ptr), PACK(new_size, 1));
+        return place(ptr, asize);
+    }
+
+    new_chunk = mm_malloc(size);
+    if (!new_chunk)
+        return NULL;
+
+    memcpy(new_chunk, ptr, min(old_size - OVERHEAD, size));
+    mm_free(ptr);
+    return new_chunk;
 }
 
-/* 
- * mm_checkheap - Check the heap for consistency 
+/*
+ * mm_checkheap - Check the heap and the free lists for consistency
  */
-void mm_checkheap(int verbose) 
+void mm_checkheap(int verbose)
 {
     char *bp = heap_listp;
+    int num_free = 0;
+    int i;
 
     if (verbose)
 	lprintf("Heap (%p):\n", heap_listp);
@@ -172,31 +213,52 @@ void mm_checkheap(int verbose)
     checkblock(heap_listp);
 
     for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
-	if (verbose) 
+	if (verbose)
 	    printblock(bp);
 	checkblock(bp);
+        if (!GET_ALLOC(HDRP(bp))) {
+            num_free++;
+            if (!GET_ALLOC(HDRP(NEXT_BLKP(bp))))
+                lprintf("Error: %p is not coalesced\n", bp);
+        }
     }
-     
+
     if (verbose)
 	printblock(bp);
     if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
 	lprintf("Bad epilogue header\n");
+
+    for (i = 0; i < NUM_BINS; i++) {
+        char *prev = NULL;
+        for (bp = bins[i]; bp != NULL; bp = SUCC(bp)) {
+            if (GET_ALLOC(HDRP(bp)))
+                lprintf("Error: %p in free list is allocated\n", bp);
+            if (bin_index(GET_SIZE(HDRP(bp))) != i)
+                lprintf("Error: %p is in wrong bin %d\n", bp, i);
+            if (PRED(bp) != prev)
+                lprintf("Error: %p has bad pred pointer\n", bp);
+            prev = bp;
+            num_free--;
+        }
+    }
+    if (num_free != 0)
+        lprintf("Error: free lists do not match the heap\n");
 }
 
 /* The remaining routines are internal helper routines */
 
-/* 
+/*
  * extend_heap - Extend heap with free block and return its block pointer
  */
 /* $begin mmextendheap */
-static void *extend_heap(int words) 
+static void *extend_heap(int words)
 {
     char *bp;
     int size;
-	
+
     /* Allocate an even number of words to maintain alignment */
     size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
-    if ((bp = mem_sbrk(size)) == NULL) 
+    if ((bp = mem_sbrk(size)) == NULL)
 	return NULL;
 
     /* Initialize free block header/footer and the epilogue header */
@@ -209,113 +271,188 @@ static void *extend_heap(int words)
 }
 /* $end mmextendheap */
 
-/* 
- * place - Place block of asize bytes at start of free block bp 
- *         and split if remainder would be at least minimum block size
+/*
+ * place - Place block of asize bytes at start of block bp, which is either
+ *         free or already allocated to the caller, and split if remainder
+ *         would be at least minimum block size. Return bp.
  */
 /* $begin mmplace */
-/* $begin mmplace-proto */
-static void place(void *bp, int asize)
-/* $end mmplace-proto */
+static void *place(void *bp, int asize)
 {
-    int csize = GET_SIZE(HDRP(bp));   
+    int csize = GET_SIZE(HDRP(bp));
 
-    if ((csize - asize) >= (DSIZE + OVERHEAD)) { 
+    if (!GET_ALLOC(HDRP(bp)))
+        remove_free_block(bp);
+
+    if ((csize - asize) >= MINBLOCKSIZE) {
 	PUT(HDRP(bp), PACK(asize, 1));
 	PUT(FTRP(bp), PACK(asize, 1));
-	bp = NEXT_BLKP(bp);
-	PUT(HDRP(bp), PACK(csize-asize, 0));
-	PUT(FTRP(bp), PACK(csize-asize, 0));
+        char *rest = NEXT_BLKP(bp);
+	PUT(HDRP(rest), PACK(csize-asize, 0));
+	PUT(FTRP(rest), PACK(csize-asize, 0));
+        coalesce(rest);
     }
-    else { 
+    else {
 	PUT(HDRP(bp), PACK(csize, 1));
 	PUT(FTRP(bp), PACK(csize, 1));
     }
+    return bp;
 }
 /* $end mmplace */
 
-/* 
- * find_fit - Find a fit for a block with asize bytes 
+/*
+ * find_fit - Find a fit for a block with asize bytes
  */
-/* $begin mmfirstfit */
-/* $begin mmfirstfit-proto */
 static void *find_fit(int asize)
-/* $end mmfirstfit-proto */
 {
-    void *bp;
+    int i = bin_index(asize);
+    char *bp;
 
-    /* first fit search */
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
-	if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp)))) {
-	    return bp;
-	}
+    /* Blocks in a small bin all have the same size, and every block in a
+     * higher bin is large enough */
+    if (i >= NUM_SMALL_BINS) {
+        for (bp = bins[i]; bp != NULL; bp = SUCC(bp)) {
+            if (asize <= GET_SIZE(HDRP(bp)))
+                return bp;
+        }
+        i++;
+    }
+
+    for (; i < NUM_BINS; i++) {
+        if (bins[i] != NULL)
+            return bins[i];
     }
     return NULL; /* no fit */
 }
-/* $end mmfirstfit */
 
 /*
- * coalesce - boundary tag coalescing. Return ptr to coalesced block
+ * bin_index - Get the bin for blocks of size bytes
+ */
+static int bin_index(int size)
+{
+    int i = 0;
+    int limit = SMALLBINMAX << 1;
+
+    if (size <= SMALLBINMAX)
+        return (size - MINBLOCKSIZE) / DSIZE;
+
+    while (size > limit && i < NUM_LARGE_BINS - 1) {
+        limit <<= 1;
+        i++;
+    }
+    return NUM_SMALL_BINS + i;
+}
+
+/*
+ * insert_free_block - Put a free block to its bin
+ */
+static void insert_free_block(void *bp)
+{
+    int size = GET_SIZE(HDRP(bp));
+    int i = bin_index(size);
+    char *prev = NULL;
+    char *next = bins[i];
+
+    /* large bins are sorted by size */
+    if (i >= NUM_SMALL_BINS) {
+        while (next != NULL && GET_SIZE(HDRP(next)) < size) {
+            prev = next;
+            next = SUCC(next);
+        }
+    }
+
+    SET_PRED(bp, prev);
+    SET_SUCC(bp, next);
+    if (prev != NULL)
+        SET_SUCC(prev, bp);
+    else
+        bins[i] = bp;
+    if (next != NULL)
+        SET_PRED(next, bp);
+}
+
+/*
+ * remove_free_block - Take a free block out of its bin
+ */
+static void remove_free_block(void *bp)
+{
+    if (PRED(bp) != NULL)
+        SET_SUCC(PRED(bp), SUCC(bp));
+    else
+        bins[bin_index(GET_SIZE(HDRP(bp)))] = SUCC(bp);
+    if (SUCC(bp) != NULL)
+        SET_PRED(SUCC(bp), PRED(bp));
+}
+
+/*
+ * coalesce - boundary tag coalescing. Merge a block that is not in any
+ *            free list with its free neighbours and put the result to its
+ *            bin. Return ptr to coalesced block
  */
 /* $begin mmfree */
-static void *coalesce(void *bp) 
+static void *coalesce(void *bp)
 {
     int prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
     int next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
     int size = GET_SIZE(HDRP(bp));
 
     if (prev_alloc && next_alloc) {            /* Case 1 */
-	return bp;
+	/* nothing to merge */
     }
 
     else if (prev_alloc && !next_alloc) {      /* Case 2 */
+        remove_free_block(NEXT_BLKP(bp));
 	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
 	PUT(HDRP(bp), PACK(size, 0));
 	PUT(FTRP(bp), PACK(size,0));
-	return(bp);
     }
 
     else if (!prev_alloc && next_alloc) {      /* Case 3 */
+        remove_free_block(PREV_BLKP(bp));
 	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
 	PUT(FTRP(bp), PACK(size, 0));
 	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-	return(PREV_BLKP(bp));
+	bp = PREV_BLKP(bp);
     }
 
     else {                                     /* Case 4 */
-	size += GET_SIZE(HDRP(PREV_BLKP(bp))) + 
+        remove_free_block(PREV_BLKP(bp));
+        remove_free_block(NEXT_BLKP(bp));
+	size += GET_SIZE(HDRP(PREV_BLKP(bp))) +
 	    GET_SIZE(FTRP(NEXT_BLKP(bp)));
 	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
 	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-	return(PREV_BLKP(bp));
+	bp = PREV_BLKP(bp);
     }
+
+    insert_free_block(bp);
+    return bp;
 }
 /* $end mmfree */
 
-void printblock(void *bp) 
+void printblock(void *bp)
 {
     int hsize, halloc, fsize, falloc;
 
     hsize = GET_SIZE(HDRP(bp));
-    halloc = GET_ALLOC(HDRP(bp));  
+    halloc = GET_ALLOC(HDRP(bp));
     fsize = GET_SIZE(FTRP(bp));
-    falloc = GET_ALLOC(FTRP(bp));  
-    
+    falloc = GET_ALLOC(FTRP(bp));
+
     if (hsize == 0) {
 	lprintf("%p: EOL\n", bp);
 	return;
     }
 
-    lprintf("%p: header: [%d:%c] footer: [%d:%c]\n", bp, 
-	   hsize, (halloc ? 'a' : 'f'), 
-	   fsize, (falloc ? 'a' : 'f')); 
+    lprintf("%p: header: [%d:%c] footer: [%d:%c]\n", bp,
+	   hsize, (halloc ? 'a' : 'f'),
+	   fsize, (falloc ? 'a' : 'f'));
 }
 
-static void checkblock(void *bp) 
+static void checkblock(void *bp)
 {
     if ((int)bp % 8)
 	lprintf("Error: %p is not doubleword aligned\n", bp);
     if (GET(HDRP(bp)) != GET(FTRP(bp)))
 	lprintf("Error: header does not match footer\n");
 }
-
@@ -12,8 +12,10 @@
 /* Basic constants and macros */
 #define WSIZE       4       /* word size (bytes) */
 #define DSIZE       8       /* doubleword size (bytes) */
-#define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
+#define INITCHUNKSIZE (1<<12) /* initial heap size (bytes) */
+#define CHUNKSIZE  (1<<16)  /* extend heap by at least this amount (bytes) */
 #define OVERHEAD    8       /* overhead of header and footer (bytes) */
+#define MINBLOCKSIZE 16     /* header, pred, succ and footer (bytes) */
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))
 
@@ -35,11 +37,27 @@
 /* Given block ptr bp, compute address of next and previous blocks */
 #define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
+
+/* Given free block ptr bp, read and write its free list neighbours */
+#define PRED(bp)           (*(char **)(bp))
+#define SUCC(bp)           (*((char **)(bp) + 1))
+#define SET_PRED(bp, ptr)  (PRED(bp) = (char *)(ptr))
+#define SET_SUCC(bp, ptr)  (SUCC(bp) = (char *)(ptr))
 /* $end mallocmacros */
 
+/* Segregated free lists. Small bins hold blocks of a single size, from
+ * MINBLOCKSIZE up to SMALLBINMAX in DSIZE steps. Large bin k holds blocks
+ * of (SMALLBINMAX << k, SMALLBINMAX << (k+1)], the last one everything
+ * larger, and is kept sorted by size. */
+#define SMALLBINMAX    512
+#define NUM_SMALL_BINS ((SMALLBINMAX - MINBLOCKSIZE) / DSIZE + 1)
+#define NUM_LARGE_BINS 20
+#define NUM_BINS       (NUM_SMALL_BINS + NUM_LARGE_BINS)
+
 int mm_init(void);
 void *mm_malloc(int size);
 void mm_free(void *bp);
 void *mm_realloc(void *ptr, int size);
+void mm_checkheap(int verbose);
 
 #endif /* _MM_MALLOC_H */
@@ -8,7 +8,15 @@
  * They can then spawn threads into these groups with thrgrp_create()
  * When the threads exit (via returning.. NOT thr_exit()), they can be
  * joined on using thrgrp_join(). A call to thrgrp_join() with group tg
- * Will reap any one thread to exit from that group, and then return
+ * Will reap any one thread to exit from that group, and then return.
+ * thrgrp_join_all() reaps every thread of the group.
+ *
+ * Threads of a group are detached, so reaping one never calls thr_join().
+ * An exiting thread pushes itself onto the lock-free completion stack of
+ * its group with cmpxchg, and only touches the group lock if a joiner is
+ * asleep. Joiners take the whole completion stack at once with xchg (so
+ * there is no ABA problem) into a ready list that only joiners touch,
+ * under the group lock.
  */
 
 #include <cond.h>
@@ -34,8 +42,11 @@
  */
 int thrgrp_init_group(thrgrp_group_t *eg){
   int ret;
-  eg->zombie_in=NULL;
-  eg->zombie_out=NULL;
+  eg->done=NULL;
+  eg->ready=NULL;
+  eg->num_threads=0;
+  eg->num_waiters=0;
+  eg->num_exiting=0;
   if((ret=mutex_init(&(eg->lock))))
     return ret; 
   if((ret=cond_init(&(eg->cv)))) {
@@ -60,10 +71,13 @@ int thrgrp_destroy_group(thrgrp_group_t *eg){
   int ret=0;
   mutex_lock(&(eg->lock));
   /* make sure that the queues are empty */
-  if(eg->zombie_in || eg->zombie_out)
+  if(eg->ready || eg->done)
     ret = 1;
   mutex_unlock(&(eg->lock));
   if(ret == 0) {
+    /* a reaped thread may still be leaving thrgrp_bottom() */
+    while(eg->num_exiting > 0)
+      yield(-1);
     mutex_destroy(&(eg->lock)); 
     cond_destroy(&(eg->cv)); 
   }
@@ -83,28 +97,37 @@ static void *thrgrp_bottom(void *in_data){
   void *(*func)(void *) = data->tmp.func;
   void *arg = data->tmp.arg;
   thrgrp_group_t *tg = data->tmp.tg;
+  thrgrp_queue_el_t *head;
   void * ret;
 
-  /* now that we have all of the data out of data, 
-    we'll use it as our queueing element */
-
-  data->qel.next = NULL;
-  data->qel.tid = thr_getid();
+  /* we are reaped through the group, never by thr_join() */
+  thr_detach(thr_getid());
 
   /* runthe code we were asked to run */
   ret = func(arg);
 
-  /* insert ourselves into the zombie queue */
-  mutex_lock(&(tg->lock));
-  if(tg->zombie_in)
-    tg->zombie_in->next = &(data->qel);
-  tg->zombie_in = &(data->qel);
-  if(tg->zombie_out == NULL)
-    tg->zombie_out = &(data->qel);
+  /* now that we have all of the data out of data, 
+    we'll use it as our queueing element */
+  data->qel.tid = thr_getid();
+  data->qel.status = ret;
+
+  /* push ourselves onto the completion stack, data may be freed by a
+    joiner as soon as this succeeds */
+  asm_xadd((int *)&(tg->num_exiting), 1);
+  do {
+    head = tg->done;
+    data->qel.next = head;
+  } while(asm_cmpxchg((int *)&(tg->done), (int)head, (int)&(data->qel)) 
+          != (int)head);
 
-  /* signal a waiter to come clean up our zombie */
-  cond_signal(&(tg->cv));
-  mutex_unlock(&(tg->lock));
+  /* wake waiters to come clean up our zombie, they recheck the stack after
+    announcing themselves in num_waiters, so none can be missed */
+  if(asm_xadd((int *)&(tg->num_waiters), 0) > 0) {
+    mutex_lock(&(tg->lock));
+    cond_broadcast(&(tg->cv));
+    mutex_unlock(&(tg->lock));
+  }
+  asm_xadd((int *)&(tg->num_exiting), -1);
 
   /* if we return with ret, should exit with ret */
   return ret;
@@ -131,11 +154,15 @@ int thrgrp_create(thrgrp_group_t *tg, void *(*func)(void *),void *arg){
   data->tmp.arg = arg;
   data->tmp.tg = tg;
 
+  /* count it before it can possibly be reaped */
+  asm_xadd((int *)&(tg->num_threads), 1);
+
   /* spawn the thread */
   tid = thr_create(thrgrp_bottom, data);
 
   /* tid<0 indicates error */
   if(tid < 0) {
+    asm_xadd((int *)&(tg->num_threads), -1);
     free(data);
     return tid;
   }
@@ -145,6 +172,42 @@ int thrgrp_create(thrgrp_group_t *tg, void *(*func)(void *),void *arg){
   return 0;
 }
 
+/** @brief gets the ready list, refilling it from the completion stack
+ *
+ * @param eg, a thread group whose lock is held
+ * @return the ready list, NULL if no thread has exited
+ */
+static thrgrp_queue_el_t *thrgrp_take(thrgrp_group_t *eg){
+  if(eg->ready == NULL)
+    eg->ready = (thrgrp_queue_el_t *) asm_xchg((int *)&(eg->done), 0);
+  return eg->ready;
+}
+
+/** @brief waits until some thread exits, or no thread is left with all
+ *
+ * Might return spuriously, callers should recheck their condition
+ *
+ * @param eg, a thread group whose lock is held
+ * @param all, non-zero to return when every thread has been reaped
+ */
+static void thrgrp_wait(thrgrp_group_t *eg, int all){
+  asm_xadd((int *)&(eg->num_waiters), 1);
+  /* recheck after announcing ourselves, see thrgrp_bottom() */
+  if(thrgrp_take(eg) == NULL && (!all || eg->num_threads > 0))
+    cond_wait(&(eg->cv), &(eg->lock));
+  asm_xadd((int *)&(eg->num_waiters), -1);
+}
+
+/** @brief accounts for reaped threads
+ *
+ * @param eg, a thread group whose lock is held
+ * @param n, number of threads reaped
+ */
+static void thrgrp_reaped(thrgrp_group_t *eg, int n){
+  /* the last one wakes up thrgrp_join_all() callers */
+  if(asm_xadd((int *)&(eg->num_threads), -n) == n && eg->num_waiters > 0)
+    cond_broadcast(&(eg->cv));
+}
 
 /** @brief joins on any thread which exits in the group
  * 
@@ -157,40 +220,66 @@ int thrgrp_create(thrgrp_group_t *tg, void *(*func)(void *),void *arg){
  * of memory, not thrgrp_queue_el_t of memory
  *
  * @param eg, an initialized thread group to join on threads in
- * @param depared, a pointer to some memory, the TID of the exited
- * thread will be placed here before thrgrp_join returns
  * @param status, a pointer to a void *, where the return status of
  * the thread we join on (I.E. what's returned from that threads first function
- * @return returns the result of thr_join
+ * @return 0
  */
 int thrgrp_join(thrgrp_group_t* eg, void **status){
   thrgrp_queue_el_t *thr_data;
-  int tid;
 
   mutex_lock(&(eg->lock));
   /* check to see if there's someone to join on*/
-  while(eg->zombie_out == NULL){
+  while((thr_data = thrgrp_take(eg)) == NULL){
     /* wait until there is someone to join on */
-	cond_wait(&(eg->cv), &(eg->lock));
-    /* inside of cond_wait, someone can sneek in
-     * I.E. even if condition variables are implemented in order 
-     * we do not have guaranteed in order joins */
+    thrgrp_wait(eg, 0);
   }
   /* get our zombie from the queue */
-  thr_data = eg->zombie_out;
-  if(eg->zombie_out == eg->zombie_in){
-    eg->zombie_in = NULL;
-    eg->zombie_out = NULL;
-  }else{
-    eg->zombie_out = eg->zombie_out->next;
-  }
+  eg->ready = thr_data->next;
+  thrgrp_reaped(eg, 1);
   mutex_unlock(&(eg->lock));
 
-  /* grab the tid out before we free it */
-  tid = thr_data->tid;
+  /* the thread is detached, it has been or will be cleaned up by itself */
+  if(status)
+    *status = thr_data->status;
   /* free the memory from the queue */
   free(thr_data);
-  /* join on the tid, and return the result */
-  return thr_join(tid, status);
+  return 0;
 }
 
+/** @brief joins on every thread in the group
+ *
+ * Exited threads are reaped in batches, the statuses are discarded. Threads
+ * created while this is running are joined as well.
+ *
+ * @param eg, an initialized thread group to join on threads in
+ * @return the number of threads joined
+ */
+int thrgrp_join_all(thrgrp_group_t* eg){
+  thrgrp_queue_el_t *thr_data, *next;
+  int count = 0;
+  int n;
+
+  mutex_lock(&(eg->lock));
+  while(eg->num_threads > 0){
+    if((thr_data = thrgrp_take(eg)) == NULL){
+      thrgrp_wait(eg, 1);
+      continue;
+    }
+    /* take all zombies at once */
+    eg->ready = NULL;
+    for(n = 0, next = thr_data; next; next = next->next)
+      n++;
+    thrgrp_reaped(eg, n);
+    mutex_unlock(&(eg->lock));
+
+    count += n;
+    while(thr_data){
+      next = thr_data->next;
+      free(thr_data);
+      thr_data = next;
+    }
+    mutex_lock(&(eg->lock));
+  }
+  mutex_unlock(&(eg->lock));
+  return count;
+}
@@ -18,6 +18,8 @@ typedef struct thrgrp_queue_el{
   struct thrgrp_queue_el *next;
   /** @brief the tid of the thread to exit */
   int tid;
+  /** @brief what the thread returned */
+  void *status;
 } thrgrp_queue_el_t;
 
 /**
@@ -28,10 +30,17 @@ typedef struct thrgrp_queue_el{
 typedef struct{
   /* @brief a condition variable holding joiners waiting on exiters*/
   cond_t cv;
-  /* @brief a list of zombie threads waiting to be reaped */
-  thrgrp_queue_el_t *zombie_in;
-  thrgrp_queue_el_t *zombie_out;
-  /* @brief a mutex for protecting the rest of this data*/
+  /* @brief a lock-free stack of zombie threads, pushed by exiting threads */
+  thrgrp_queue_el_t * volatile done;
+  /* @brief zombie threads taken from done, waiting to be reaped */
+  thrgrp_queue_el_t *ready;
+  /* @brief number of threads created and not reaped yet */
+  volatile int num_threads;
+  /* @brief number of joiners waiting on cv */
+  volatile int num_waiters;
+  /* @brief number of exiting threads which may still touch the group */
+  volatile int num_exiting;
+  /* @brief a mutex for protecting ready and cv */
   mutex_t lock;
 } thrgrp_group_t;
 
@@ -69,6 +78,8 @@ int thrgrp_create(thrgrp_group_t *tg, void *(*func)(void *), void *args);
 
 int thrgrp_join(thrgrp_group_t *tg, void **status);
 
+int thrgrp_join_all(thrgrp_group_t *tg);
+
 
 
 
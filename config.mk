@@ -62,7 +62,7 @@ UPDATE_METHOD = afs
 # A list of the test programs you want compiled in from the user/progs
 # directory.
 #
-STUDENTTESTS = agility_drill beady_test cvar_test cyclone excellent hello_world io_test join_specific_test juggle largetest mandelbrot multitest mutex_test my_cho my_fork my_new_pages my_wild_test1 my_yield_desc_mkrun paraguay param_check racer rwlock_downgrade_read_test sleep_test small_program startle switched_program switzerland test_fork test_readfile test_swexn test_swexn_helper test_yield thr_exit_join vanish_check my_mkrun_desc
+STUDENTTESTS = agility_drill beady_test cvar_test cyclone excellent hello_world io_test join_specific_test juggle largetest mandelbrot multitest mutex_test my_cho my_fork my_new_pages my_wild_test1 my_yield_desc_mkrun paraguay param_check racer rwlock_downgrade_read_test sleep_test small_program startle switched_program switzerland test_fork test_readfile test_swexn test_swexn_helper test_yield thr_exit_join vanish_check my_mkrun_desc make_runnable_many_test malloc_thread_test malloc_bench barrier_test lfqueue_test tls_test bench_syscall bench_sched bench_proc bench_mem bench_print time_test fork_frame_test
 
 
 ###########################################################################
@@ -84,7 +84,7 @@ STUDENTFILES = foo
 ###########################################################################
 # Object files for your thread library
 ###########################################################################
-THREAD_OBJS = arraytcb.o asm_get_ebp.o asm_get_esp.o asm_thr_exit.o asm_xchg.o cond_var.o hashtable.o malloc.o mutex.o panic.o queue.o rwlock.o sem.o thr_create_kernel.o thr_lib_helper.o thr_lib.o
+THREAD_OBJS = arraytcb.o asm_cmpxchg.o asm_get_ebp.o asm_get_esp.o asm_get_tls.o asm_pause.o asm_thr_exit.o asm_xadd.o asm_xchg.o barrier.o cond_var.o latch.o lfqueue.o malloc.o mutex.o panic.o pool.o rwlock.o sem.o spinlock.o thr_create_kernel.o thr_lib_helper.o thr_lib.o
 
 
 # Thread Group Library Support.
@@ -98,7 +98,7 @@ THREAD_OBJS = arraytcb.o asm_get_ebp.o asm_get_esp.o asm_thr_exit.o asm_xchg.o c
 ###########################################################################
 # Object files for your syscall wrappers
 ###########################################################################
-SYSCALL_OBJS = deschedule.o exec.o fork.o get_cursor_pos.o get_ticks.o gettid.o halt.o make_runnable.o new_pages.o print.o readfile.o readline.o remove_pages.o set_cursor_pos.o set_status.o set_term_color.o sleep.o swexn.o syscall.o vanish.o wait.o yield.o
+SYSCALL_OBJS = deschedule.o exec.o fork.o get_cursor_pos.o get_ticks.o get_time_ns.o gettid.o halt.o make_runnable.o make_runnable_many.o new_pages.o print.o readfile.o readline.o remove_pages.o set_cursor_pos.o set_status.o set_term_color.o set_tls_base.o sleep.o swexn.o syscall.o vanish.o wait.o yield.o
 
 
 ###########################################################################
@@ -116,7 +116,7 @@ AUTOSTACK_OBJS = autostack.o
 #
 # Kernel object files you provide in from kern/
 #
-KERNEL_OBJS = asm_atomic.o asm_context_switch.o asm_helper.o asm_invalidate_tlb.o asm_new_process_iret.o asm_ret_newureg.o asm_ret_swexn_handler.o console_driver.o context_switcher.o control_block.o exception_handler.o handler_wrapper.o hashtable.o init_IDT.o kernel.o keyboard_driver.o loader.o malloc_wrappers.o mutex.o pm.o priority_queue.o scheduler.o seg_tree.o simple_queue.o spinlock.o syscall_consoleio.o syscall_lifecycle.o syscall_memory.o syscall_misc.o syscall_thr_management.o timer_driver.o vm.o ap_kernel.o smp_manager_scheduler.o smp_message.o smp_syscall_lifecycle.o smp_syscall_consoleio.o smp_syscall_thr_management.o smp_syscall_misc.o
+KERNEL_OBJS = asm_atomic.o asm_context_switch.o asm_helper.o asm_invalidate_tlb.o asm_page.o asm_new_process_iret.o asm_ret_newureg.o asm_ret_swexn_handler.o console_driver.o context_switcher.o control_block.o exception_handler.o gdt.o handler_wrapper.o hashtable.o init_IDT.o kernel.o keyboard_driver.o loader.o malloc_wrappers.o mutex.o percpu.o pm.o pt_lock.o scheduler.o seg_tree.o spinlock.o syscall_consoleio.o syscall_lifecycle.o syscall_memory.o syscall_misc.o syscall_thr_management.o timer_driver.o vm.o ap_kernel.o smp_manager_scheduler.o smp_message.o smp_syscall_lifecycle.o smp_syscall_consoleio.o smp_syscall_thr_management.o smp_syscall_misc.o
 
 ###########################################################################
 # WARNING: Do not put **test** programs into the REQPROGS variables.  Your
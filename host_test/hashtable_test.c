@@ -0,0 +1,164 @@
+/** @file hashtable_test.c
+ *  @brief Host property test and benchmark of the generic hash table
+ *
+ *  The hash table is checked against an array indexed by key. Keys are
+ *  small integers cast to pointers, which is how the kernel uses the table
+ *  with tids. A weak hash is tested as well so that long chains are
+ *  covered.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+
+#include "host_test.h"
+#include <hashtable.h>
+
+/** @brief Number of buckets */
+#define TABLE_SIZE 1024
+
+/** @brief Number of distinct keys */
+#define NUM_KEYS 4096
+
+/** @brief Number of random operations in each round */
+#define NUM_OPS 500000
+
+/** @brief Number of operations in each benchmark */
+#define BENCH_OPS 2000000
+
+/** @brief Model of the table, value of each key or NULL if absent */
+static void *model[NUM_KEYS];
+
+/** @brief Hash function spreading keys over every bucket
+ *
+ *  @param key The key
+ *
+ *  @return Bucket index
+ */
+static int hash_mod(void *key) {
+    return (uintptr_t)key % TABLE_SIZE;
+}
+
+/** @brief Hash function putting keys into a few buckets
+ *
+ *  @param key The key
+ *
+ *  @return Bucket index
+ */
+static int hash_weak(void *key) {
+    return (uintptr_t)key % 7;
+}
+
+/** @brief Get a value for a key, never NULL so that it differs from absent
+ *
+ *  @param key The key
+ *
+ *  @return The value
+ */
+static void *make_value(int key) {
+    return (void *)(uintptr_t)((host_rand() << 12) | key | 1);
+}
+
+/** @brief Run random operations on a hash table
+ *
+ *  @param func Hash function of the table
+ *
+ *  @return void
+ */
+static void test_round(int (*func)(void *)) {
+    hashtable_t table;
+    int is_find;
+    int i;
+
+    table.size = TABLE_SIZE;
+    table.func = func;
+    CHECK(hashtable_init(&table) == 0);
+    memset(model, 0, sizeof(model));
+
+    for (i = 0; i < NUM_OPS; i++) {
+        int key = host_rand() % NUM_KEYS;
+        void *value;
+
+        switch (host_rand() % 3) {
+        case 0:
+            // the table allows duplicate keys, the kernel never puts one
+            if (model[key])
+                break;
+            model[key] = make_value(key);
+            CHECK(hashtable_put(&table, (void *)(uintptr_t)key,
+                                model[key]) == 0);
+            break;
+        case 1:
+            value = hashtable_get(&table, (void *)(uintptr_t)key, &is_find);
+            CHECK(is_find == (model[key] != NULL));
+            CHECK(value == model[key]);
+            break;
+        case 2:
+            value = hashtable_remove(&table, (void *)(uintptr_t)key,
+                                     &is_find);
+            CHECK(is_find == (model[key] != NULL));
+            CHECK(value == model[key]);
+            model[key] = NULL;
+            break;
+        }
+    }
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        void *value = hashtable_get(&table, (void *)(uintptr_t)i, &is_find);
+        CHECK(is_find == (model[i] != NULL));
+        CHECK(value == model[i]);
+    }
+    hashtable_destroy(&table);
+}
+
+/** @brief Benchmark get and put/remove on a table of num keys
+ *
+ *  @param num Number of keys in the table
+ *
+ *  @return void
+ */
+static void bench_round(int num) {
+    hashtable_t table;
+    uint64_t start;
+    int is_find;
+    int i;
+
+    table.size = TABLE_SIZE;
+    table.func = hash_mod;
+    CHECK(hashtable_init(&table) == 0);
+    for (i = 0; i < num; i++)
+        CHECK(hashtable_put(&table, (void *)(uintptr_t)i, &table) == 0);
+
+    start = host_time_ns();
+    for (i = 0; i < BENCH_OPS; i++) {
+        hashtable_get(&table, (void *)(uintptr_t)(host_rand() % num),
+                      &is_find);
+    }
+    host_bench_report("hashtable_test", "get", num, BENCH_OPS,
+                      host_time_ns() - start);
+
+    start = host_time_ns();
+    for (i = 0; i < BENCH_OPS; i++) {
+        void *key = (void *)(uintptr_t)(host_rand() % num);
+        hashtable_remove(&table, key, &is_find);
+        hashtable_put(&table, key, &table);
+    }
+    host_bench_report("hashtable_test", "remove_put", num, BENCH_OPS,
+                      host_time_ns() - start);
+
+    hashtable_destroy(&table);
+}
+
+int main(int argc, char **argv) {
+    if (host_is_bench(argc, argv)) {
+        bench_round(TABLE_SIZE / 4);
+        bench_round(TABLE_SIZE);
+        bench_round(TABLE_SIZE * 4);
+        return 0;
+    }
+
+    test_round(hash_mod);
+    test_round(hash_weak);
+    printf("hashtable_test: Success\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+/** @file host_test.h
+ *  @brief Helpers shared by the host tests of kernel data structures
+ *
+ *  Every test program runs its randomized property tests when invoked with
+ *  "test" (or no argument) and its throughput benchmarks with "bench". A
+ *  property test compares the data structure against a simple model after
+ *  every operation. Benchmark results are reported in the same format as
+ *  the bench_* user programs, one line per operation:
+ *     bench: prog=<name> op=<op> arg=<n> iters=<n> ns=<n> ns_per_iter=<n>
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#ifndef _HOST_TEST_H
+#define _HOST_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+/** @brief Seed of the pseudo random number generator, fixed for replay */
+#define HOST_TEST_SEED 410
+
+/** @brief Check a property, report and exit on violation */
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                #cond); \
+        exit(1); \
+    } \
+} while (0)
+
+/** @brief State of the pseudo random number generator */
+static uint32_t host_seed = HOST_TEST_SEED;
+
+/** @brief Get a pseudo random number
+ *
+ *  @return A pseudo random number in [0, 2^31)
+ */
+static inline uint32_t host_rand() {
+    // xorshift32, good enough and identical across hosts
+    host_seed ^= host_seed << 13;
+    host_seed ^= host_seed >> 17;
+    host_seed ^= host_seed << 5;
+    return host_seed >> 1;
+}
+
+/** @brief Get the monotonic time
+ *
+ *  @return Time in nanoseconds
+ */
+static inline uint64_t host_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/** @brief Report a benchmark result
+ *
+ *  @param prog Name of the program
+ *  @param op Operation benchmarked
+ *  @param arg Argument of the operation, e.g. size of the data structure
+ *  @param iters Number of iterations
+ *  @param ns Time taken by all iterations in nanoseconds
+ *
+ *  @return void
+ */
+static inline void host_bench_report(const char *prog, const char *op,
+                                     int arg, int iters, uint64_t ns) {
+    printf("bench: prog=%s op=%s arg=%d iters=%d ns=%llu ns_per_iter=%llu\n",
+           prog, op, arg, iters, (unsigned long long)ns,
+           (unsigned long long)(iters ? ns / iters : 0));
+}
+
+/** @brief Check whether the program is asked to run benchmarks
+ *
+ *  @param argc Number of arguments
+ *  @param argv Arguments
+ *
+ *  @return 1 if the first argument is "bench"; 0 otherwise
+ */
+static inline int host_is_bench(int argc, char **argv) {
+    return argc > 1 && strcmp(argv[1], "bench") == 0;
+}
+
+#endif
@@ -0,0 +1,190 @@
+/** @file lmm_test.c
+ *  @brief Host property test and benchmark of the 410kern lmm allocator
+ *
+ *  Blocks of random sizes and alignments are allocated from a region over
+ *  a static buffer and filled with a pattern. The test checks that every
+ *  block is inside the region, aligned as asked and not overlapping any
+ *  other live block, and that lmm_avail() always equals the region size
+ *  minus the live blocks rounded up to ALIGN_SIZE. After everything is
+ *  freed the region must coalesce back to one free block.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+
+#include "host_test.h"
+#include <lmm/lmm.h>
+#include <lmm/lmm_types.h>
+#include <x86/page.h>
+
+/** @brief Size of the managed region */
+#define REGION_SIZE (4 << 20)
+
+/** @brief Number of slots for live blocks */
+#define NUM_SLOTS 1024
+
+/** @brief Largest block size */
+#define MAX_BLOCK_SIZE 16384
+
+/** @brief Number of random operations */
+#define NUM_OPS 200000
+
+/** @brief Number of operations in each benchmark */
+#define BENCH_OPS 100000
+
+/** @brief Round a size up to the granularity of lmm */
+#define LMM_ROUND(size) (((size) + ALIGN_MASK) & ~(vm_size_t)ALIGN_MASK)
+
+/** @brief Memory managed by lmm */
+static char region_buf[REGION_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+/** @brief Live block in each slot, NULL if the slot is empty */
+static char *blocks[NUM_SLOTS];
+
+/** @brief Size of the block in each slot */
+static vm_size_t sizes[NUM_SLOTS];
+
+/** @brief Initialize an lmm with one region over region_buf
+ *
+ *  @param lmm The lmm
+ *  @param region Region descriptor
+ *
+ *  @return void
+ */
+static void init_lmm(lmm_t *lmm, lmm_region_t *region) {
+    lmm_init(lmm);
+    lmm_add_region(lmm, region, region_buf, REGION_SIZE, 0, 0);
+    lmm_add_free(lmm, region_buf, REGION_SIZE);
+}
+
+/** @brief Check the pattern of a live block
+ *
+ *  @param slot Slot of the block
+ *
+ *  @return void
+ */
+static void check_block(int slot) {
+    vm_size_t i;
+    for (i = 0; i < sizes[slot]; i++)
+        CHECK(blocks[slot][i] == (char)slot);
+}
+
+/** @brief Run random operations on an lmm
+ *
+ *  @return void
+ */
+static void test_lmm() {
+    lmm_t lmm;
+    lmm_region_t region;
+    vm_size_t in_use = 0;
+    vm_offset_t addr;
+    vm_size_t size;
+    lmm_flags_t flags;
+    int i;
+
+    init_lmm(&lmm, &region);
+    CHECK(lmm_avail(&lmm, 0) == REGION_SIZE);
+
+    for (i = 0; i < NUM_OPS; i++) {
+        int slot = host_rand() % NUM_SLOTS;
+
+        if (blocks[slot]) {
+            check_block(slot);
+            lmm_free(&lmm, blocks[slot], sizes[slot]);
+            in_use -= LMM_ROUND(sizes[slot]);
+            blocks[slot] = NULL;
+        } else {
+            int align_bits = 0;
+            char *p;
+
+            size = 1 + host_rand() % MAX_BLOCK_SIZE;
+            if (host_rand() % 4 == 0) {
+                align_bits = PAGE_SHIFT;
+                p = lmm_alloc_aligned(&lmm, size, 0, align_bits, 0);
+            } else if (host_rand() % 8 == 0) {
+                p = lmm_alloc_page(&lmm, 0);
+                size = PAGE_SIZE;
+                align_bits = PAGE_SHIFT;
+            } else {
+                p = lmm_alloc(&lmm, size, 0);
+            }
+            if (!p)
+                continue;
+
+            CHECK(p >= region_buf && p + size <= region_buf + REGION_SIZE);
+            CHECK(((uintptr_t)p & ((1 << align_bits) - 1)) == 0);
+            CHECK(((uintptr_t)p & ALIGN_MASK) == 0);
+            // a block overlapping another one overwrites its pattern, which
+            // is caught when that block is freed
+            memset(p, (char)slot, size);
+            blocks[slot] = p;
+            sizes[slot] = size;
+            in_use += LMM_ROUND(size);
+        }
+        CHECK(lmm_avail(&lmm, 0) == REGION_SIZE - in_use);
+    }
+
+    for (i = 0; i < NUM_SLOTS; i++) {
+        if (blocks[i]) {
+            check_block(i);
+            lmm_free(&lmm, blocks[i], sizes[i]);
+            blocks[i] = NULL;
+        }
+    }
+    CHECK(lmm_avail(&lmm, 0) == REGION_SIZE);
+
+    // every block is back, so the free list must be one block again
+    addr = 0;
+    lmm_find_free(&lmm, &addr, &size, &flags);
+    CHECK(addr == (vm_offset_t)region_buf && size == REGION_SIZE);
+}
+
+/** @brief Benchmark alloc and free of a size on a fragmented region
+ *
+ *  @param size Size of a block
+ *
+ *  @return void
+ */
+static void bench_lmm(vm_size_t size) {
+    lmm_t lmm;
+    lmm_region_t region;
+    uint64_t start;
+    int i;
+
+    init_lmm(&lmm, &region);
+
+    // fragment the free list with every other slot allocated
+    for (i = 0; i < NUM_SLOTS; i++)
+        blocks[i] = lmm_alloc(&lmm, 1 + host_rand() % 512, 0);
+    for (i = 0; i < NUM_SLOTS; i += 2)
+        lmm_free(&lmm, blocks[i], 1);
+
+    start = host_time_ns();
+    for (i = 0; i < BENCH_OPS; i++) {
+        void *p = lmm_alloc(&lmm, size, 0);
+        lmm_free(&lmm, p, size);
+    }
+    host_bench_report("lmm_test", "alloc_free", size, BENCH_OPS,
+                      host_time_ns() - start);
+
+    start = host_time_ns();
+    for (i = 0; i < BENCH_OPS; i++) {
+        void *p = lmm_alloc_page(&lmm, 0);
+        lmm_free_page(&lmm, p);
+    }
+    host_bench_report("lmm_test", "alloc_free_page", PAGE_SIZE, BENCH_OPS,
+                      host_time_ns() - start);
+}
+
+int main(int argc, char **argv) {
+    if (host_is_bench(argc, argv)) {
+        bench_lmm(16);
+        bench_lmm(1024);
+        return 0;
+    }
+
+    test_lmm();
+    printf("lmm_test: Success\n");
+    return 0;
+}
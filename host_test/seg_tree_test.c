@@ -0,0 +1,137 @@
+/** @file seg_tree_test.c
+ *  @brief Host property test and benchmark of the frame allocator
+ *
+ *  The segment tree is checked against an array of frame states. After any
+ *  random sequence of get_next() and put_back(), get_next() must return the
+ *  free frame with the smallest index, or NAN if every frame is allocated.
+ *  Frame counts that are not a power of 2 are tested so that the padding
+ *  leaf is covered. The tree needs at least two leaves, i.e. 64 frames.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+
+#include "host_test.h"
+#include <seg_tree.h>
+
+/** @brief Largest number of frames tested */
+#define MAX_FRAMES 8192
+
+/** @brief Number of random operations in each round */
+#define NUM_OPS 200000
+
+/** @brief Number of operations in each benchmark */
+#define BENCH_OPS 1000000
+
+/** @brief Model of the allocator, 1 if a frame is allocated */
+static char allocated[MAX_FRAMES];
+
+/** @brief Smallest free frame in the model
+ *
+ *  @param num Number of frames
+ *
+ *  @return Index of the smallest free frame; NAN if there is none
+ */
+static uint32_t model_next(int num) {
+    int i;
+    for (i = 0; i < num; i++) {
+        if (!allocated[i])
+            return i;
+    }
+    return NAN;
+}
+
+/** @brief Run random operations on a segment tree of num frames
+ *
+ *  @param num Number of frames
+ *
+ *  @return void
+ */
+static void test_round(int num) {
+    int num_allocated = 0;
+    int i;
+
+    CHECK(init_seg_tree(num) == 0);
+    memset(allocated, 0, sizeof(allocated));
+
+    for (i = 0; i < NUM_OPS; i++) {
+        // bias toward allocation first, then toward freeing, so that both
+        // the empty and the full tree are reached
+        int alloc_bias = (i / (NUM_OPS / 8)) % 2 ? 30 : 70;
+        if ((int)(host_rand() % 100) < alloc_bias) {
+            uint32_t frame = get_next();
+            CHECK(frame == model_next(num));
+            if (frame != NAN) {
+                allocated[frame] = 1;
+                num_allocated++;
+            }
+        } else if (num_allocated > 0) {
+            uint32_t frame;
+            do {
+                frame = host_rand() % num;
+            } while (!allocated[frame]);
+            put_back(frame);
+            allocated[frame] = 0;
+            num_allocated--;
+        }
+    }
+
+    // drain the tree, frames must come out in increasing order
+    while (num_allocated < num) {
+        uint32_t frame = get_next();
+        CHECK(frame == model_next(num));
+        allocated[frame] = 1;
+        num_allocated++;
+    }
+    CHECK(get_next() == NAN);
+}
+
+/** @brief Benchmark get_next() and put_back() on a half full tree
+ *
+ *  @param num Number of frames
+ *
+ *  @return void
+ */
+static void bench_round(int num) {
+    uint32_t frames[MAX_FRAMES];
+    uint64_t start;
+    int i;
+
+    CHECK(init_seg_tree(num) == 0);
+    for (i = 0; i < num / 2; i++)
+        frames[i] = get_next();
+
+    start = host_time_ns();
+    for (i = 0; i < BENCH_OPS; i++) {
+        uint32_t frame = get_next();
+        put_back(frame);
+    }
+    host_bench_report("seg_tree_test", "get_put", num, BENCH_OPS,
+                      host_time_ns() - start);
+
+    start = host_time_ns();
+    for (i = 0; i < BENCH_OPS; i++) {
+        int j = host_rand() % (num / 2);
+        put_back(frames[j]);
+        frames[j] = get_next();
+    }
+    host_bench_report("seg_tree_test", "put_get_random", num, BENCH_OPS,
+                      host_time_ns() - start);
+}
+
+int main(int argc, char **argv) {
+    int nums[] = { 64, 1000, 4096, 5000, MAX_FRAMES };
+    int num_nums = sizeof(nums) / sizeof(nums[0]);
+    int i;
+
+    for (i = 0; i < num_nums; i++) {
+        if (host_is_bench(argc, argv))
+            bench_round(nums[i]);
+        else
+            test_round(nums[i]);
+    }
+    if (!host_is_bench(argc, argv))
+        printf("seg_tree_test: Success\n");
+    return 0;
+}
@@ -0,0 +1,16 @@
+/** @file asm_helper.h
+ *  @brief Host shim of the kernel assembly helpers used by data structures
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#ifndef _HOST_ASM_HELPER_H
+#define _HOST_ASM_HELPER_H
+
+#include <stdint.h>
+
+/** @brief Index of the least significant set bit, value must not be 0 */
+#define asm_bsf(value) __builtin_ctz(value)
+
+#endif
@@ -0,0 +1,13 @@
+/** @file malloc.h
+ *  @brief Host shim of the kernel malloc interface, the libc one is used
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#ifndef _HOST_MALLOC_H
+#define _HOST_MALLOC_H
+
+#include <stdlib.h>
+
+#endif
@@ -0,0 +1,7 @@
+/** @file mptable.h
+ *  @brief Host shim of the MP table interface, nothing is needed
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
@@ -0,0 +1,16 @@
+/** @file percpu.h
+ *  @brief Host shim of the per core data area, the host test is single-core
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#ifndef _PERCPU_H_
+#define _PERCPU_H_
+
+#include <smp.h>
+
+/** @brief Get the index of the current core, always cpu0 on the host */
+#define percpu_get_cpu() 0
+
+#endif
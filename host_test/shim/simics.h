@@ -0,0 +1,19 @@
+/** @file simics.h
+ *  @brief Host shim of the simulator interface, log to stderr
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#ifndef _HOST_SIMICS_H
+#define _HOST_SIMICS_H
+
+#include <stdio.h>
+
+/** @brief Print a line to the log */
+#define lprintf(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+    fputc('\n', stderr); \
+} while (0)
+
+#endif
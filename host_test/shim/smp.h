@@ -0,0 +1,14 @@
+/** @file smp.h
+ *  @brief Host shim of the SMP interface
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#ifndef _SMP_H
+#define _SMP_H
+
+/** @brief Maximum number of CPUs */
+#define MAX_CPUS 16
+
+#endif
@@ -0,0 +1,8 @@
+/** @file stdio.h
+ *  @brief Host shim of 410kern stdio/stdio.h, the libc one is used
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#include <stdio.h>
@@ -0,0 +1,17 @@
+/** @file types.h
+ *  @brief Host shim of 410kern types.h, sized for the host pointers
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#ifndef _HOST_TYPES_H
+#define _HOST_TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uintptr_t vm_offset_t;
+typedef uintptr_t vm_size_t;
+
+#endif
@@ -0,0 +1,14 @@
+/** @file page.h
+ *  @brief Host shim of 410kern x86/page.h
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#ifndef _HOST_PAGE_H
+#define _HOST_PAGE_H
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+
+#endif
@@ -0,0 +1,196 @@
+/** @file variable_queue_test.c
+ *  @brief Host property test and benchmark of the variable queue macros
+ *
+ *  Random insertions and removals are applied to a queue and to an array
+ *  model of it. After every operation the queue is walked in both
+ *  directions and compared with the model.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+
+#include "host_test.h"
+#include <variable_queue.h>
+
+/** @brief Number of elements */
+#define NUM_ELEMS 256
+
+/** @brief Number of random operations */
+#define NUM_OPS 200000
+
+/** @brief Number of operations in each benchmark */
+#define BENCH_OPS 10000000
+
+/** @brief Element of the queue */
+typedef struct elem {
+    /** @brief Link of the queue */
+    Q_NEW_LINK(elem) link;
+    /** @brief Index of the element */
+    int id;
+    /** @brief 1 if the element is in the queue */
+    int in_queue;
+} elem_t;
+
+Q_NEW_HEAD(list_t, elem);
+
+/** @brief Elements */
+static elem_t elems[NUM_ELEMS];
+
+/** @brief Model of the queue, ids from front to tail */
+static int model[NUM_ELEMS];
+
+/** @brief Number of elements in the model */
+static int model_len;
+
+/** @brief Insert an id into the model
+ *
+ *  @param pos Position to insert at
+ *  @param id The id
+ *
+ *  @return void
+ */
+static void model_insert(int pos, int id) {
+    memmove(&model[pos + 1], &model[pos], (model_len - pos) * sizeof(int));
+    model[pos] = id;
+    model_len++;
+}
+
+/** @brief Remove the id at a position from the model
+ *
+ *  @param pos The position
+ *
+ *  @return void
+ */
+static void model_remove(int pos) {
+    model_len--;
+    memmove(&model[pos], &model[pos + 1], (model_len - pos) * sizeof(int));
+}
+
+/** @brief Check the queue against the model in both directions
+ *
+ *  @param list The queue
+ *
+ *  @return void
+ */
+static void check_list(list_t *list) {
+    elem_t *cur;
+    int i = 0;
+
+    Q_FOREACH(cur, list, link) {
+        CHECK(i < model_len && cur->id == model[i]);
+        i++;
+    }
+    CHECK(i == model_len);
+
+    for (cur = Q_GET_TAIL(list); cur; cur = Q_GET_PREV(cur, link)) {
+        i--;
+        CHECK(i >= 0 && cur->id == model[i]);
+    }
+    CHECK(i == 0);
+}
+
+/** @brief Run random operations on a queue
+ *
+ *  @return void
+ */
+static void test_queue() {
+    list_t list;
+    int i;
+
+    Q_INIT_HEAD(&list);
+    for (i = 0; i < NUM_ELEMS; i++) {
+        Q_INIT_ELEM(&elems[i], link);
+        elems[i].id = i;
+        elems[i].in_queue = 0;
+    }
+
+    for (i = 0; i < NUM_OPS; i++) {
+        elem_t *e = &elems[host_rand() % NUM_ELEMS];
+        int pos;
+
+        if (e->in_queue) {
+            for (pos = 0; model[pos] != e->id; pos++)
+                continue;
+            Q_REMOVE(&list, e, link);
+            model_remove(pos);
+            e->in_queue = 0;
+        } else {
+            elem_t *at;
+            int op = host_rand() % 4;
+            if (model_len == 0)
+                op %= 2;
+            pos = model_len ? host_rand() % model_len : 0;
+            at = &elems[model[pos]];
+
+            switch (op) {
+            case 0:
+                Q_INSERT_FRONT(&list, e, link);
+                model_insert(0, e->id);
+                break;
+            case 1:
+                Q_INSERT_TAIL(&list, e, link);
+                model_insert(model_len, e->id);
+                break;
+            case 2:
+                Q_INSERT_AFTER(&list, at, e, link);
+                model_insert(pos + 1, e->id);
+                break;
+            case 3:
+                Q_INSERT_BEFORE(&list, at, e, link);
+                model_insert(pos, e->id);
+                break;
+            }
+            e->in_queue = 1;
+        }
+        check_list(&list);
+    }
+}
+
+/** @brief Benchmark rotating a queue, the way the scheduler uses it
+ *
+ *  @param num Number of elements in the queue
+ *
+ *  @return void
+ */
+static void bench_queue(int num) {
+    list_t list;
+    uint64_t start;
+    int i;
+
+    Q_INIT_HEAD(&list);
+    for (i = 0; i < num; i++) {
+        Q_INIT_ELEM(&elems[i], link);
+        Q_INSERT_TAIL(&list, &elems[i], link);
+    }
+
+    start = host_time_ns();
+    for (i = 0; i < BENCH_OPS; i++) {
+        elem_t *e = Q_GET_FRONT(&list);
+        Q_REMOVE(&list, e, link);
+        Q_INSERT_TAIL(&list, e, link);
+    }
+    host_bench_report("variable_queue_test", "rotate", num, BENCH_OPS,
+                      host_time_ns() - start);
+
+    start = host_time_ns();
+    for (i = 0; i < BENCH_OPS; i++) {
+        elem_t *e = &elems[host_rand() % num];
+        Q_REMOVE(&list, e, link);
+        Q_INSERT_FRONT(&list, e, link);
+    }
+    host_bench_report("variable_queue_test", "remove_random", num,
+                      BENCH_OPS, host_time_ns() - start);
+}
+
+int main(int argc, char **argv) {
+    if (host_is_bench(argc, argv)) {
+        bench_queue(4);
+        bench_queue(NUM_ELEMS);
+        return 0;
+    }
+
+    test_queue();
+    printf("variable_queue_test: Success\n");
+    return 0;
+}
@@ -24,6 +24,7 @@
 #include <syscall_inter.h>
 #include <context_switcher.h>
 #include <pm.h>
+#include <gdt.h>
 
 #include <mptable.h>
 #include <smp.h>
@@ -36,6 +37,10 @@
  */
 static void ap_kernel_init(int cpu_id) {
 
+    // Set up the per core area first, percpu_get_cpu() is used everywhere
+    if (gdt_init(cpu_id) < 0)
+        panic("Initialize GDT at cpu%d failed!", cpu_id);
+
     adopt_init_pd(cpu_id);
 
     if (malloc_init(cpu_id) < 0)
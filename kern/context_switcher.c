@@ -63,34 +63,76 @@
 #include <syscall_inter.h>
 #include <asm_atomic.h>
 #include <syscall_errors.h>
-#include <simple_queue.h>
+#include <thr_queue.h>
 #include <context_switcher.h>
 #include <smp.h>
+#include <percpu.h>
+#include <gdt.h>
+#include <string.h>
+#include <eflags.h>
 
 /** @brief The assembly part (the most important part) of context switch.
  *         Please refer to asm_context_switch.S for more details. */
 extern void asm_context_switch(int op, uint32_t arg, tcb_t *this_thr);
 
-static tcb_t* internal_thread_fork(tcb_t* this_thr);
-
-static void* get_last_ebp(void* ebp);
+/** @brief Where a thread forked by fork() or thread_fork() starts. Please 
+ *         refer to asm_context_switch.S for more details. */
+extern void asm_fork_child_return();
+
+/** @brief Where the thread forked by the idle thread starts. Please refer to
+ *         asm_context_switch.S for more details. */
+extern void asm_idle_fork_child_return();
+
+/** @brief Number of words of the iret frame pushed by a trap from user mode:
+ *         %ss, %esp, EFLAGS, %cs and %eip */
+#define IRET_FRAME_WORDS 5
+
+/** @brief Number of words that a syscall wrapper of fork() or thread_fork() 
+ *         leaves on top of the kernel stack before calling its handler */
+#define SYSCALL_FRAME_WORDS \
+            (IRET_FRAME_WORDS + ASM_PUSH_GENERIC_WORDS + ASM_PUSH_SS_WORDS)
+
+/** @brief The stack frame that asm_context_switch() leaves on the kernel 
+ *         stack of a thread that is switched out, from low to high address */
+typedef struct {
+    /** @brief Space reserved for node of queue of scheduler */
+    uint32_t reserved[3];
+    /** @brief Pushed this_thr->k_stack_esp */
+    void *k_stack_esp;
+    /** @brief Pushed %cr2 */
+    uint32_t cr2;
+    /** @brief Pushed EFLAGS */
+    uint32_t eflags;
+    /** @brief Generic registers pushed by pusha */
+    uint32_t regs[8];
+    /** @brief Pushed %ebp */
+    uint32_t ebp;
+    /** @brief Return address of asm_context_switch() */
+    void *ret_addr;
+    /** @brief The op of context_switch(), seen as the argument of ret_addr */
+    int op;
+} switch_frame_t;
+
+/** @brief Template of the first frame on the kernel stack of a forked thread.
+ *         It resumes with interrupts enabled, all other fields are 0 or 
+ *         filled in by internal_thread_fork() */
+static const switch_frame_t fork_frame_template = {
+    .eflags = EFL_RESV1 | EFL_IF
+};
+
+static tcb_t* internal_thread_fork(tcb_t* this_thr, int op);
+
+void context_switch_finish(int op);
+
+int context_switch_fork_child(int op);
 
 extern mutex_t *get_malloc_lib_lock();
 
-/** @brief Spinlock to be used to protect queue of scheduler. We can not use
- *         mutex to protext queue of sheduler. Mutex may block the thread that
- *         can not get the lock, which will result in a context switch and 
- *         another operation of queue of scheduler... */
-static spinlock_t* spinlocks[MAX_CPUS];
 
 /** @brief The idle thread(task), this will be scheduled by scheduler when 
  *         there is no other thread to run */
 extern tcb_t* idle_thr[MAX_CPUS];
 
-/** @brief Stores the current running thread on each core. Note that it is
- *         an array of tcb_t** so that each core will malloc a tcb_t* using
- *         its own heap to avoid false sharing. */
-static tcb_t** cur_running_thr[MAX_CPUS];
 
 /** @brief Context switch from a thread to another thread. 
  *
@@ -108,10 +150,28 @@ void context_switch(int op, uint32_t arg) {
     if (this_thr == NULL)
         return;
 
+    // the deepest kernel paths all end up here, check them on every switch
+    // rather than only when the timer happens to interrupt them
+    if (PERCPU_READ(cur_running_thr) != NULL && 
+        tcb_is_stack_overflow((void*)asm_get_esp()))
+        panic("thread %d's kernel stack overflow!", this_thr->tid);
+
     asm_context_switch(op, arg, this_thr);
 
-    this_thr = tcb_get_entry((void*)asm_get_esp());
+    context_switch_finish(op);
+}
 
+/** @brief Finish a context switch on the thread that is switched in
+ *
+ *  It restores cr3, esp0 and the TLS base of the thread, finishes the rest
+ *  part of fork() for a forked child and tries to free a zombie thread.
+ *
+ *  @param op The operation for context_switch() of the thread
+ *
+ *  @return void
+ */
+void context_switch_finish(int op) {
+    tcb_t *this_thr = tcb_get_entry((void*)asm_get_esp());
 
     /* for child process of fork(), finish the rest part of fork(), including
      * create pcb, clone page table and clone swexn. */ 
@@ -127,7 +187,7 @@ void context_switch(int op, uint32_t arg) {
 
             // construct FORK_RESPONSE message
             this_thr->my_msg->req_thr = this_thr;
-            this_thr->my_msg->req_cpu = smp_get_cpu();
+            this_thr->my_msg->req_cpu = percpu_get_cpu();
             this_thr->my_msg->data.fork_response_data.result = rv;
 
             // send FORK_RESPONSE message back to the manager core, so the 
@@ -147,6 +207,9 @@ void context_switch(int op, uint32_t arg) {
     // reset esp0
     set_esp0((uint32_t)tcb_get_high_addr(this_thr->k_stack_esp-1));
 
+    // %gs of this thread will be restored with its own TLS base
+    gdt_set_tls_base(this_thr->tls_base);
+
     
     /* ====== The following code is used to free any zombie thread ======= */
 
@@ -171,20 +234,19 @@ void context_switch(int op, uint32_t arg) {
                 return;
             } else {
                 // get two locks!
-                simple_node_t *node;
-                if((node = get_next_zombie()) != NULL) {
+                tcb_t* zombie_thr;
+                if((zombie_thr = get_next_zombie()) != NULL) {
                     // After putting self to zombie list, and on the way to
                     // get next thread to run, timer interrupt is likely to 
                     // happen, so zombie thread is likely to have a chance
                     // to execute the following code, must let other thread
                     // to free its resource.
-                    tcb_t* zombie_thr = (tcb_t*)(node->thr);
                     if(this_thr->tid == zombie_thr->tid || 
                         // if the state of zombie_thr is not BLOCKED, it means
                         // the zombie_thr is not really blocked yet
                         zombie_thr->state != BLOCKED) {
                         // Put it back
-                        put_next_zombie(node);
+                        put_next_zombie(zombie_thr);
                     } else {
                         // Zombie thread is ready to be freed
                         tcb_vanish_thread(zombie_thr);
@@ -198,6 +260,21 @@ void context_switch(int op, uint32_t arg) {
     }
 }
 
+/** @brief Finish context switch for a thread forked by fork() or thread_fork()
+ *
+ *  A forked thread doesn't return from context_switch() like its parent, 
+ *  it starts at asm_fork_child_return() which calls this function and then 
+ *  returns to user space by the registers that the syscall wrapper saved.
+ *
+ *  @param op The operation for context_switch(), OP_FORK or OP_THREAD_FORK
+ *
+ *  @return The return value of fork() or thread_fork() in the new thread
+ */
+int context_switch_fork_child(int op) {
+    context_switch_finish(op);
+    return tcb_get_entry((void*)asm_get_esp())->result;
+}
+
 /** @brief Get the next thread to context switch to
  *  
  *  The next thread might be:
@@ -228,9 +305,9 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
         case OP_CONTEXT_SWITCH: // normal context switch 
         case OP_YIELD:  // yield -1 or yield to a specific thread
             // let sheduler choose the next thread to run
-            spinlock_lock(spinlocks[smp_get_cpu()], 1);
+            spinlock_lock(&percpu_self()->switch_lock, 1);
             new_thr = scheduler_get_next((int)arg);
-            spinlock_unlock(spinlocks[smp_get_cpu()], 1);
+            spinlock_unlock(&percpu_self()->switch_lock, 1);
             if (new_thr == NULL) {
                 if ((int)arg == -1)
                     // no other thread to yield to, just return this thread
@@ -245,13 +322,13 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
 
             // will unlock in asm_context_switch() --> after context switch to 
             // the next thread successfully
-            spinlock_lock(spinlocks[smp_get_cpu()], 1);
+            spinlock_lock(&percpu_self()->switch_lock, 1);
             // decide to enqueue this thread, should not be interrupted until 
             // context switch to the next thread successfully
-            if (this_thr != idle_thr[smp_get_cpu()])
+            if (this_thr != idle_thr[percpu_get_cpu()])
                 scheduler_make_runnable(this_thr);
 
-            *cur_running_thr[smp_get_cpu()] = new_thr;
+            PERCPU_WRITE(cur_running_thr, new_thr);
             return new_thr;
         
         case OP_FORK:    // fork and context switch to new thread
@@ -263,7 +340,7 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
             }
 
             // first execute thread fork (locally on the same core)
-            new_thr = internal_thread_fork(this_thr);
+            new_thr = internal_thread_fork(this_thr, op);
 
             if (new_thr == NULL) {
                 // internal_thread_fork() error (out of memory)
@@ -279,10 +356,10 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
             /* If it is not the idle thread that invoking fork(), should 
              * send message to the manager core and ask another core to do the 
              * rest of fork() */
-            if (this_thr != idle_thr[smp_get_cpu()]) {
+            if (this_thr != idle_thr[percpu_get_cpu()]) {
                 // construct message
                 this_thr->my_msg->req_thr = this_thr;
-                this_thr->my_msg->req_cpu = smp_get_cpu();
+                this_thr->my_msg->req_cpu = percpu_get_cpu();
                 this_thr->my_msg->type = FORK;
                 this_thr->my_msg->data.fork_data.new_thr = new_thr;
                 this_thr->my_msg->data.fork_data.retry_times = 0;
@@ -319,21 +396,21 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
             // fork success
             this_thr->result = new_thr->tid;
 
-            if (this_thr == idle_thr[smp_get_cpu()]) {
+            if (this_thr == idle_thr[percpu_get_cpu()]) {
                 // will unlock in asm_context_switch() --> after context switch
                 // to the next thread successfully
-                spinlock_lock(spinlocks[smp_get_cpu()], 1);
+                spinlock_lock(&percpu_self()->switch_lock, 1);
                 // decide to enqueue this thread, should not be interrupted 
                 // until context switch to the next thread successfully
                 scheduler_make_runnable(this_thr);
-                *cur_running_thr[smp_get_cpu()] = new_thr;
+                PERCPU_WRITE(cur_running_thr, new_thr);
                 return new_thr;
             } else
                 return this_thr;
             
 
         case OP_THREAD_FORK:    // thread_fork and context switch to new thread
-            new_thr = internal_thread_fork(this_thr);
+            new_thr = internal_thread_fork(this_thr, op);
 
             if (new_thr != NULL) {
                 // thread fork success
@@ -348,18 +425,18 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
 
             // will unlock in asm_context_switch() --> after context switch to 
             // the next thread successfully
-            spinlock_lock(spinlocks[smp_get_cpu()], 1);
+            spinlock_lock(&percpu_self()->switch_lock, 1);
             // decide to enqueue this thread, should not be interrupted until 
             // context switch to the next thread successfully
             scheduler_make_runnable(this_thr);
 
-            *cur_running_thr[smp_get_cpu()] = new_thr;
+            PERCPU_WRITE(cur_running_thr, new_thr);
             return new_thr;
 
         case OP_BLOCK: // block itself
             // will unlock in asm_context_switch() --> after context switch to 
             // the next thread successfully
-            spinlock_lock(spinlocks[smp_get_cpu()], 1);
+            spinlock_lock(&percpu_self()->switch_lock, 1);
             if (this_thr->state == WAKEUP || this_thr->state == MADE_RUNNABLE) {
                 // already be wakened up or made runnable, should not block
                 this_thr->state = NORMAL;
@@ -378,19 +455,19 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
                 // let sheduler to choose the next thread to run
                 new_thr = scheduler_block();
                 if (new_thr == NULL) {
-                    if (this_thr == idle_thr[smp_get_cpu()])
+                    if (this_thr == idle_thr[percpu_get_cpu()])
                         panic("idle thread try to block itself, something \
                                                                 goes wrong!");
-                    else if (idle_thr[smp_get_cpu()] == NULL)
+                    else if (idle_thr[percpu_get_cpu()] == NULL)
                         panic("no other process is running, %d can not \
                                                     be blocked", this_thr->tid);
                     else {
-                        *cur_running_thr[smp_get_cpu()] = 
-                                                        idle_thr[smp_get_cpu()];
-                        return idle_thr[smp_get_cpu()];
+                        PERCPU_WRITE(cur_running_thr, 
+                                     idle_thr[percpu_get_cpu()]);
+                        return idle_thr[percpu_get_cpu()];
                     }
                 } else {
-                    *cur_running_thr[smp_get_cpu()] = new_thr; 
+                    PERCPU_WRITE(cur_running_thr, new_thr);
                     return new_thr;
                 }
             }    
@@ -402,7 +479,7 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
 
             // will unlock in asm_context_switch() --> after context switch to 
             // the next thread successfully
-            spinlock_lock(spinlocks[smp_get_cpu()], 1);
+            spinlock_lock(&percpu_self()->switch_lock, 1);
             if (new_thr->state == BLOCKED) {
                 // the thread has already blocked, put it to the queue of 
                 // scheduler
@@ -422,7 +499,7 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
             
             // will unlock in asm_context_switch() --> after context switch to 
             // the next thread successfully
-            spinlock_lock(spinlocks[smp_get_cpu()], 1);
+            spinlock_lock(&percpu_self()->switch_lock, 1);
             scheduler_make_runnable(this_thr);
 
             if (new_thr->state == BLOCKED)
@@ -435,29 +512,30 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
                 panic("strange state in context_switch(OP_RESUME,thr)");
             }
 
-            *cur_running_thr[smp_get_cpu()] = new_thr;
+            PERCPU_WRITE(cur_running_thr, new_thr);
             return new_thr;
 
         case OP_SEND_MSG: // send message to manager core
-            spinlock_lock(spinlocks[smp_get_cpu()], 1);
+            spinlock_lock(&percpu_self()->switch_lock, 1);
             worker_send_msg(this_thr->my_msg);
 
             // let sheduler to choose the next thread to run
             new_thr = scheduler_block();
             if (new_thr == NULL) {
 
-                if (this_thr == idle_thr[smp_get_cpu()])
+                if (this_thr == idle_thr[percpu_get_cpu()])
                     panic("idle thread try to block itself, something \
                                                             goes wrong!");
-                else if (idle_thr[smp_get_cpu()] == NULL)
+                else if (idle_thr[percpu_get_cpu()] == NULL)
                     panic("no other process is running, %d can not \
                                                 be blocked", this_thr->tid);
                 else {
-                    *cur_running_thr[smp_get_cpu()] = idle_thr[smp_get_cpu()];
-                    return idle_thr[smp_get_cpu()];
+                    PERCPU_WRITE(cur_running_thr, 
+                                 idle_thr[percpu_get_cpu()]);
+                    return idle_thr[percpu_get_cpu()];
                 }
             } else { 
-                *cur_running_thr[smp_get_cpu()] = new_thr;
+                PERCPU_WRITE(cur_running_thr, new_thr);
                 return new_thr;
             }
 
@@ -468,76 +546,62 @@ tcb_t* context_switch_get_next(int op, uint32_t arg, tcb_t* this_thr) {
 
 /** @brief Implement the kernel part of thread_fork()
  *  
- *  Create a new thread and copy the entire kernel stack of this thread
- *  (from very top to this_thr->k_stack_esp) to the kernel stack of the 
- *  newly created thread. Beacuse all kernel stack is cloned for the new 
- *  thread, when it returns from context_switch_get_next() it should behave
- *  exactly the same as the original thread. 
+ *  Create a new thread whose kernel stack looks as if it had been switched 
+ *  out by asm_context_switch(). Instead of cloning the entire kernel stack of
+ *  this thread, only the registers that the syscall wrapper saved on the very
+ *  top of it are copied. Below them is a frame built from fork_frame_template
+ *  which returns to asm_fork_child_return(), so the new thread goes back to 
+ *  user space as if it called fork() or thread_fork() itself. 
+ *
+ *  The idle thread forks in kernel mode and has nothing to copy, its child 
+ *  starts at asm_idle_fork_child_return() to exec init instead.
  *
  *  @param this_thr The thread that will be forked
+ *  @param op The operation for context_switch(), OP_FORK or OP_THREAD_FORK
  *
  *  @return On success a new thread that is the result of thread_fork() 
  *          of this_thr. On error return NULL (because of out of memory)       
  */
-tcb_t* internal_thread_fork(tcb_t* this_thr) {
+tcb_t* internal_thread_fork(tcb_t* this_thr, int op) {
     tcb_t* new_thr = tcb_create_thread_only(this_thr->pcb, NORMAL);
     if (new_thr == NULL)
         return NULL;
 
-    void* high_addr = tcb_get_high_addr(this_thr->k_stack_esp);
-    int len = (uint32_t)high_addr - (uint32_t)this_thr->k_stack_esp;
-
-    // set k_stack_esp value
     void* init_k_esp = new_thr->k_stack_esp;
-    new_thr->k_stack_esp = (void*)((uint32_t)new_thr->k_stack_esp - len);
-
-    // copy kernel stack
-    memcpy(new_thr->k_stack_esp, this_thr->k_stack_esp, len);
+    uint32_t* esp = init_k_esp;
+    void* ret_addr = asm_idle_fork_child_return;
+
+    if (this_thr != idle_thr[percpu_get_cpu()]) {
+        // copy registers saved by the syscall wrapper
+        uint32_t* high_addr = tcb_get_high_addr(this_thr->k_stack_esp);
+        esp -= SYSCALL_FRAME_WORDS;
+        memcpy(esp, high_addr - SYSCALL_FRAME_WORDS, 
+                                            SYSCALL_FRAME_WORDS * 4);
+        ret_addr = asm_fork_child_return;
+    }
 
-    // modify pushed k_esp value
-    void *k_esp = (void*)((unsigned int)new_thr->k_stack_esp + 12);
-    memcpy(k_esp, &init_k_esp, 4);
+    // build the frame that asm_context_switch() will switch to
+    switch_frame_t* frame = (switch_frame_t*)esp - 1;
+    *frame = fork_frame_template;
+    frame->k_stack_esp = init_k_esp;
+    frame->ret_addr = ret_addr;
+    frame->op = op;
 
-    // modify all %ebp values in the new thread's kernel stack so that all %ebp
-    // values point to the new stack instead of the original stack
-    uint32_t diff = 
-              (uint32_t)new_thr->k_stack_esp - (uint32_t)this_thr->k_stack_esp;
-    void* ebp = (void*)((uint32_t)new_thr->k_stack_esp + 56);
-    *((uint32_t*) ebp) = *((uint32_t*) ebp) + diff;
-    ebp = get_last_ebp(ebp);
-    *((uint32_t*) ebp) = *((uint32_t*) ebp) + diff;
+    new_thr->k_stack_esp = frame;
 
     return new_thr;
 }
 
-
-/** @brief Get old %ebp value based on current %ebp
- *
- *  @param ebp Value of current %ebp
- *
- *  @return Value of old %ebp
- */
-void* get_last_ebp(void* ebp) {
-    uint32_t last_ebp = *((uint32_t*) ebp);
-    return (void*) last_ebp;
-}
-
 /** @brief Initialize data structure for context switcher
  *
  *  @return On success return 0, on error return -1
  */
 int context_switcher_init() {
-    int cur_cpu = smp_get_cpu();
+    percpu_t *percpu = percpu_self();
 
-    cur_running_thr[cur_cpu] = malloc(sizeof(tcb_t*));
-    if (cur_running_thr[cur_cpu] == NULL)
-        return -1;
-
-    spinlocks[cur_cpu] = malloc(sizeof(spinlock_t));
-    if (spinlocks[cur_cpu] == NULL)
-        return -1;
+    percpu->cur_running_thr = NULL;
 
-    if (spinlock_init(spinlocks[cur_cpu]) < 0)
+    if (spinlock_init(&percpu->switch_lock) < 0)
         return -1;
 
     return 0;
@@ -545,15 +609,15 @@ int context_switcher_init() {
 
 /** @brief Unlock spinlock of context switcher */
 void context_switch_unlock() {
-    spinlock_unlock(spinlocks[smp_get_cpu()], 1);
+    spinlock_unlock(&percpu_self()->switch_lock, 1);
 }
 
 /** @brief Lock spinlock of context switcher */
 void context_switch_lock() {
-    spinlock_lock(spinlocks[smp_get_cpu()], 1);
+    spinlock_lock(&percpu_self()->switch_lock, 1);
 }
 
 /** @brief Get the current running thread */
 tcb_t* get_current_running_thr() {
-    return *cur_running_thr[smp_get_cpu()];
+    return PERCPU_READ(cur_running_thr);
 }
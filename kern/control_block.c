@@ -40,13 +40,14 @@
 #include <syscall_inter.h>
 #include <stdio.h>
 #include <smp.h>
+#include <percpu.h>
 
 /** @brief Get the index in tcb_table array based on kernel stack address */
 #define GET_K_STACK_INDEX(x)    (((unsigned int)(x)) >> K_STACK_BITS)
 
 /** @brief The limit that a kernel stack can grow. The stack is considered
  *         overflow if it exceeds this limit and should be killed */
-#define STACK_OVERFLOW_LIMIT    0x1C00
+#define STACK_OVERFLOW_LIMIT    (K_STACK_SIZE - (K_STACK_SIZE >> 3))
 
 /** @brief Counter that will be used for assigning tid and pid */
 static int id_count = -1;
@@ -83,17 +84,9 @@ pcb_t* tcb_create_process_only(tcb_t* thread, tcb_t* pthr,
     process->cur_thr_num = 1;    
 
     // Init page table lock
-    int i;
-    for(i = 0; i < NUM_PT_LOCKS_PER_PD; i++) {
-        if(mutex_init(&process->pt_locks[i]) < 0) {
-            int j;
-            for(j = 0; j < i - 1; j++) {
-                mutex_destroy(&process->pt_locks[j]);
-            }
-           
-            free(process);
-            return NULL;
-        }
+    if(pt_lock_init(&process->pt_lock) < 0) {
+        free(process);
+        return NULL;
     }
 
     // must be last step
@@ -119,15 +112,18 @@ tcb_t* tcb_create_thread_only(pcb_t* process, thread_state_t state) {
         return NULL;
         
     tcb_t *thread = (tcb_t*)tcb_get_entry(k_stack_esp);
+#if K_STACK_DEBUG
+    *(uint32_t *)k_stack_esp = K_STACK_CANARY;
+#endif
 
-    thread->my_msg = malloc(sizeof(msg_t));
-    if (thread->my_msg == NULL) {
-        sfree(k_stack_esp, K_STACK_SIZE);
-        return NULL;
-    }
-    thread->my_msg->node.thr = (void*)(thread->my_msg);
+    // the message lives in the tcb, so it goes away with the kernel stack
+    thread->my_msg = &thread->msg;
+    Q_INIT_ELEM(thread->my_msg, link);
+    thread->my_msg->type = NONE;
 
     thread->k_stack_esp = tcb_get_high_addr(k_stack_esp);
+    Q_INIT_ELEM(thread, runq_link);
+    Q_INIT_ELEM(thread, wait_link);
     thread->tid = atomic_add(&id_count, 1);
     thread->pcb = process;
     thread->state = state;
@@ -135,7 +131,10 @@ tcb_t* tcb_create_thread_only(pcb_t* process, thread_state_t state) {
     // Initially no swexn handler registered
     thread->swexn_struct = NULL;
 
-    thread->ori_cpu = smp_get_cpu();
+    // Initially no TLS
+    thread->tls_base = 0;
+
+    thread->ori_cpu = percpu_get_cpu();
 
     return thread;
 }
@@ -169,11 +168,8 @@ tcb_t* tcb_create_idle_process(thread_state_t state,
 
 
     // Init page table lock
-    int i;
-    for(i = 0; i < NUM_PT_LOCKS_PER_PD; i++) {
-        if(mutex_init(&process->pt_locks[i]) < 0) {
-            return NULL;
-        }
+    if(pt_lock_init(&process->pt_lock) < 0) {
+        return NULL;
     }
 
     thread->pcb = process;
@@ -242,10 +238,7 @@ void tcb_vanish_thread(tcb_t *thr) {
 void tcb_free_process(pcb_t *process) {
 
     // destroy page table lock
-    int i;
-    for(i = 0; i < NUM_PT_LOCKS_PER_PD; i++) {
-        mutex_destroy(&process->pt_locks[i]);
-    }
+    pt_lock_destroy(&process->pt_lock);
 
     free(process);
 }
@@ -286,12 +279,18 @@ void* tcb_get_low_addr(void *addr) {
  *  Note that the thread might not really stack overflow. It just exceeds the
  *  stack growth limit. But the kernel will think this is a dangerous sign and
  *  will kill the thread as soon as possible before it really stack overflow and
- *  overwrite data of other thread.
+ *  overwrite data of other thread. With K_STACK_DEBUG, the canary at the 
+ *  bottom of the stack also catches a thread that went deeper than the limit
+ *  between two checks.
  *
  *  @param esp The current esp of a thread stack
  *
  *  @return Return 1 if it is considered as stack overflow, return 0 otherwise. 
  */
 int tcb_is_stack_overflow(void *esp) {
+#if K_STACK_DEBUG
+    if (*(uint32_t *)tcb_get_low_addr(esp) != K_STACK_CANARY)
+        return 1;
+#endif
     return ((tcb_get_high_addr(esp) - esp) > STACK_OVERFLOW_LIMIT);
 }
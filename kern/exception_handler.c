@@ -21,6 +21,8 @@
 #include <control_block.h>
 #include <loader.h>
 #include <syscall_inter.h>
+#include <gdt.h>
+#include <malloc.h>
 
 /** @brief Max buffer size for printing, 512 is enough since the possible 
   * length of the content to print is known beforehand by the kernel.
@@ -81,7 +83,10 @@ static void get_ureg(ureg_t *ureg, uint32_t *ebp, int has_error_code) {
  */
 static void dump_register(int tid, ureg_t *ureg) {
 
-    char buf[MAX_BUF_SIZE];
+    // too large for a kernel stack, skip the dump if out of memory
+    char *buf = malloc(MAX_BUF_SIZE);
+    if (buf == NULL)
+        return;
 
     sprintf(buf, "\nRegister dump for thread tid %d:\n"
                 "cause: 0x%x, cr2: 0x%x, ds: 0x%x\n"
@@ -102,6 +107,7 @@ static void dump_register(int tid, ureg_t *ureg) {
 
     lprintf(buf);
     print_syscall_handler(strlen(buf), buf, 1);
+    free(buf);
 
 }
 
@@ -118,7 +124,11 @@ static void dump_register(int tid, ureg_t *ureg) {
 static void exception_interpret(int exception_type, uint32_t fault_va, 
         uint32_t error_code) {
 
-    char buf[MAX_BUF_SIZE];
+    // too large for a kernel stack, skip the message if out of memory
+    char *buf = malloc(MAX_BUF_SIZE);
+    if (buf == NULL)
+        return;
+
     switch(exception_type) {
         case IDT_DE: 
             print_syscall_handler(strlen("Division Error"), 
@@ -224,6 +234,7 @@ static void exception_interpret(int exception_type, uint32_t fault_va,
             break;
     }
 
+    free(buf);
 }
 
 /** @brief Generic exception handler
@@ -323,14 +334,17 @@ void exception_handler(int exception_type) {
 
     // Set up kernel exception handler's stack before returning to user space
     // to run swexn hanlder
-    // asm_ret_swexn_handler(eip, cs, eflags, esp, ss);
+    // asm_ret_swexn_handler(eip, cs, eflags, esp, ss, gs);
     // where eip is the swexn handler's address, cs is the user cs, eflags
     // is the default initial eflags when the first task loads, esp points
     // to the return address of the swexn handler (which is a bad address),
-    // ss is the user ss.
+    // ss is the user ss, gs selects the TLS of the thread if it has one so
+    // that the handler can find its thread library state through %gs:0.
+    uint32_t gs = (this_thr->tls_base != 0) ? SEGSEL_USER_TLS : 
+                                              SEGSEL_USER_DS;
     asm_ret_swexn_handler(eip, SEGSEL_USER_CS, 
             get_init_eflags(), actual_ureg_pos - 3 * sizeof(uint32_t), 
-            SEGSEL_USER_DS);
+            SEGSEL_USER_DS, gs);
 
     panic("Why did user space swexn handler return to kernel space "
             "exception handler?!");
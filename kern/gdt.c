@@ -0,0 +1,95 @@
+/** @file gdt.c
+ *  @brief This file contains the per core GDT
+ *
+ *  The GDT set up by the boot code only has room for the segments in
+ *  x86/seg.h. gdt_init() copies the GDT a core is running on (which has the
+ *  TSS of that core) to a larger one of its own and loads it, so that the
+ *  kernel can add segments whose descriptors differ from core to core.
+ *
+ *  The user TLS segment is a copy of the user data segment with a different
+ *  base. Its descriptor is rewritten with the TLS base of the thread on each
+ *  context switch, and a thread loads it into %gs via set_tls_base(). %gs
+ *  is saved and restored by every kernel entry, and the descriptor is read
+ *  again when %gs is restored, so each thread sees its own base.
+ *
+ *  The kernel per core segment is a copy of the kernel data segment whose
+ *  base is the per core data area of the core. The kernel loads it into
+ *  %fs, see percpu.h.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+
+#include <gdt.h>
+#include <smp.h>
+#include <string.h>
+#include <x86/asm.h>
+#include <asm_helper.h>
+#include <percpu.h>
+
+/** @brief Bits of a segment descriptor that hold the base address */
+#define SEG_DESC_BASE_MASK      0xff0000ffffff0000ull
+
+/** @brief The GDT of each core */
+static uint64_t cpu_gdt[MAX_CPUS][GDT_SEGS_ALL];
+
+/** @brief Build a segment descriptor from another one with a new base
+ *
+ *  @param desc The descriptor to copy the limit and attributes from
+ *  @param base The new base address
+ *
+ *  @return The new descriptor
+ */
+static uint64_t seg_desc_set_base(uint64_t desc, uint32_t base) {
+    desc &= ~SEG_DESC_BASE_MASK;
+    desc |= (uint64_t)(base & 0x00ffffff) << 16;
+    desc |= (uint64_t)(base & 0xff000000) << 32;
+    return desc;
+}
+
+/** @brief Set up and load the GDT of a core
+ *
+ *  Must be called by every core before anything calls percpu_get_cpu() on
+ *  it. It loads %fs with the per core segment.
+ *
+ *  @param cpu_id The id of the core calling it
+ *
+ *  @return 0 on success
+ */
+int gdt_init(int cpu_id) {
+    uint64_t *gdt = cpu_gdt[cpu_id];
+
+    // keep the TSS of this core, which is only in the GDT it is using
+    memcpy(gdt, asm_get_gdt_base(), GDT_SEGS * sizeof(uint64_t));
+
+    gdt[SEGSEL_USER_TLS_IDX] = gdt[SEGSEL_USER_DS_IDX];
+    gdt[SEGSEL_KERNEL_PERCPU_IDX] = 
+        seg_desc_set_base(gdt[SEGSEL_KERNEL_DS_IDX], 
+                          (uint32_t)percpu_init(cpu_id));
+
+    lgdt(gdt, sizeof(cpu_gdt[cpu_id]) - 1);
+
+    // reload the data segments, %fs now points to the per core area
+    asm_set_ss();
+
+    return 0;
+}
+
+/** @brief Set the base of the user TLS segment of the current core
+ *
+ *  It is called with the TLS base of the current thread after each context
+ *  switch. If it is interrupted by a context switch, the descriptor will be
+ *  rewritten with the same base before it resumes, so it is never left with 
+ *  half of another thread's base.
+ *
+ *  @param base The TLS base of the current thread
+ *
+ *  @return void
+ */
+void gdt_set_tls_base(uint32_t base) {
+    uint64_t *gdt = cpu_gdt[percpu_get_cpu()];
+
+    gdt[SEGSEL_USER_TLS_IDX] = seg_desc_set_base(gdt[SEGSEL_USER_DS_IDX], 
+                                                 base);
+}
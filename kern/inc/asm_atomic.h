@@ -1,6 +1,6 @@
 /** @file asm_atomic.h
  *
- *  @brief This file contains interfaces of two atomic operations.
+ *  @brief This file contains interfaces of three atomic operations.
  *
  *  @author Ke Wu (kewu)
  *
@@ -10,6 +10,8 @@
 #ifndef _ASM_ATOMIC_H_
 #define _ASM_ATOMIC_H_
 
+#include <stdint.h>
+
 /** @brief Atomically execute addition
  *  
  *  This function using instruction cmpxchg (CAS) to implement atomic addition
@@ -33,4 +35,18 @@ int atomic_add(int* num, int val);
  */
 int asm_xchg(int *lock_available, int val);
 
+/** @brief Atomically compare and exchange a 64-bit value
+ *  
+ *  This function using instruction cmpxchg8b to set *addr to val if *addr 
+ *  equals expected. asm_cmpxchg64(addr, 0, 0) atomically reads *addr.
+ *
+ *  @param addr Pointer points to the value to be compared and exchanged
+ *  @param expected The value *addr is expected to be
+ *  @param val The value to replace *addr if *addr equals expected
+ *
+ *  @return The original value of *addr, the exchange happened iff it equals
+ *          expected
+ */
+uint64_t asm_cmpxchg64(uint64_t *addr, uint64_t expected, uint64_t val);
+
 #endif
\ No newline at end of file
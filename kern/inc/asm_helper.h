@@ -10,6 +10,16 @@
 #ifndef _ASM_HELPER_H_
 #define _ASM_HELPER_H_
 
+/** @brief Words of stack that asm_push_generic() costs: 6 generic registers
+ *         and the slot of its own return address */
+#define ASM_PUSH_GENERIC_WORDS  7
+
+/** @brief Words of stack that asm_push_ss() costs: 4 data segment selectors
+ *         and the slot of its own return address */
+#define ASM_PUSH_SS_WORDS       5
+
+#ifndef ASSEMBLER
+
 #include <stdint.h>
 
 /** @brief Get the current value of %esp
@@ -27,6 +37,11 @@ uint32_t asm_get_ebp();
  */
 uint32_t asm_get_cs();
 
+/** @brief Get the base address of the GDT the current core is using
+ *  @return The base address of the GDT
+ */
+void *asm_get_gdt_base();
+
 /** @brief Pop all generic registers except %esp and %eax from current stack
  *  
  *  Note that although only 6 values are poped from the stack, it actually pops
@@ -63,7 +78,8 @@ void asm_pop_ss();
  */
 void asm_push_ss();
 
-/** @brief Set all data segment selectors to SEGSEL_KERNEL_DS */
+/** @brief Set all data segment selectors to SEGSEL_KERNEL_DS, except %fs,
+ *         which is set to SEGSEL_KERNEL_PERCPU */
 void asm_set_ss();
 
 /** @brief Using bsf instruction to search the parameter for the least 
@@ -77,4 +93,6 @@ void asm_set_ss();
  */
 int asm_bsf(uint32_t value);
 
+#endif /* ASSEMBLER */
+
 #endif
@@ -0,0 +1,58 @@
+/** @file asm_page.h
+ *
+ *  @brief This file contains interfaces of assembly functions that copy and
+ *  clear whole pages
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _ASM_PAGE_H_
+#define _ASM_PAGE_H_
+
+#include <stdint.h>
+
+/** @brief CPUID leaf 1 %edx bit of SSE2, which provides movnti */
+#define CPUID_EDX_SSE2 (1 << 26)
+
+/** @brief Copy a page with rep movsl
+ *
+ *  @param dst Page aligned destination
+ *  @param src Page aligned source
+ *
+ *  @return Void
+ */
+void asm_copy_page(void *dst, const void *src);
+
+/** @brief Copy a page with non-temporal stores
+ *
+ *  The destination is written around the cache, so copying a page that will
+ *  not be touched soon doesn't evict useful lines. Only call it if the CPU
+ *  has SSE2.
+ *
+ *  @param dst Page aligned destination
+ *  @param src Page aligned source
+ *
+ *  @return Void
+ */
+void asm_copy_page_nt(void *dst, const void *src);
+
+/** @brief Clear a page with rep stosl
+ *
+ *  @param dst Page aligned destination
+ *
+ *  @return Void
+ */
+void asm_zero_page(void *dst);
+
+/** @brief Get the feature flags CPUID reports in %edx
+ *
+ *  @param leaf The CPUID leaf
+ *
+ *  @return %edx of the leaf
+ */
+uint32_t asm_get_cpuid_edx(uint32_t leaf);
+
+#endif
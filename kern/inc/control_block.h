@@ -20,9 +20,10 @@
 #define _CONTROL_BLOCK_H_
 
 #include <stdint.h>
-#include <simple_queue.h>
+#include <thr_queue.h>
 #include <ureg.h>
 #include <mutex.h>
+#include <pt_lock.h>
 #include <vm.h>
 #include <smp_message.h>
 
@@ -32,6 +33,16 @@
 /** @brief Kernel stack size for each thread is 8192 bytes */
 #define K_STACK_SIZE    (1<<K_STACK_BITS) 
 
+/** @brief Set to 1 to put a canary in the lowest word of every kernel stack 
+ *         and check it together with the stack depth. It is a debugging aid
+ *         only: it finds an overflow after the memory below the stack has 
+ *         been overwritten */
+#define K_STACK_DEBUG   0
+
+/** @brief Value of the lowest word of every kernel stack if K_STACK_DEBUG is
+ *         set. A thread that overwrites it has overflowed its stack */
+#define K_STACK_CANARY  0x410CA7A5
+
 /** @brief The state of a thread can be normal (running or runnable), blocked
  *         (due to OP_BLOCK), MADE_RUNNABLE (due to OP_MAKE_RUNNABLE) or 
  *          WAKEUP (due to OP_RESUME)  */
@@ -60,8 +71,9 @@ typedef struct pcb_t {
       *        report task exit status and free task resources */
     int cur_thr_num;
 
-    /** @brief The locks for page table */
-    mutex_t pt_locks[NUM_PT_LOCKS_PER_PD];
+    /** @brief The range lock for page tables, one bit per NUM_PT_PER_LOCK 
+      *        page tables */
+    pt_lock_t pt_lock;
 
 } pcb_t;
 
@@ -83,6 +95,16 @@ typedef struct swexn_t {
 typedef struct tcb_t {
     /** @brief Kernel stack position for this thread */
     void *k_stack_esp;
+    /** @brief Link in the queue of scheduler */
+    Q_NEW_LINK(tcb_t) runq_link;
+    /** @brief Link in the queue that the thread is blocked on (queue of 
+     *         mutex, sleep, deschedule or zombie list). A thread can be in 
+     *         one of them and in the queue of scheduler at the same time, 
+     *         e.g. a timer interrupt comes after it enqueues itself in the 
+     *         queue of mutex but before it blocks */
+    Q_NEW_LINK(tcb_t) wait_link;
+    /** @brief For sleep(), the time (in ticks) to wake up */
+    unsigned int wakeup_ticks;
     /** @brief Thread id */
     int tid;
     /** @brief thread's task's pcb */
@@ -94,11 +116,17 @@ typedef struct tcb_t {
     /** @brief The parameters for registered swexn handler */
     swexn_t *swexn_struct;
 
-    /** @brief The message that associated with this thread */
+    /** @brief The message that associated with this thread, points to msg */
     msg_t* my_msg;
+    /** @brief Storage of the message. A thread sends at most one message at
+     *         a time and is blocked until it is answered */
+    msg_t msg;
 
     /** @brief Stores which cpu malloc() the kernel stack for this thread */
     int ori_cpu;
+
+    /** @brief Base of the user TLS segment, set by set_tls_base() */
+    uint32_t tls_base;
 } tcb_t;
 
 
@@ -53,11 +53,13 @@
   *  @param  eflags The default initial eflags when the first task loads
   *  @param  esp The return address of the swexn handler
   *  @param  ss The user ss: SEGSEL_USER_DS
+  *  @param  gs The user gs: SEGSEL_USER_TLS if the thread has set a TLS 
+  *             base, otherwise SEGSEL_USER_DS
   *
   *  @return No return
   */
 void asm_ret_swexn_handler(swexn_handler_t eip, uint32_t cs, uint32_t eflags, 
-        uint32_t esp, uint32_t ss);
+        uint32_t esp, uint32_t ss, uint32_t gs);
 
 /** @brief Adopt register values in newureg and change to user mode.
   *
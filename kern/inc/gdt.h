@@ -0,0 +1,44 @@
+/** @file gdt.h
+ *  @brief Segment selectors and function prototypes for gdt.c
+ *
+ *  Every core runs on its own copy of the GDT, which has the GDT_SEGS 
+ *  segments of x86/seg.h followed by the segments defined here.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#ifndef _GDT_H_
+#define _GDT_H_
+
+#include <seg.h>
+
+/** @brief GDT index of the user TLS segment, whose base is the TLS base of
+ *         the thread running on the core */
+#define SEGSEL_USER_TLS_IDX     GDT_SEGS
+
+/** @brief GDT index of the kernel per core segment, whose base is the
+ *         per core data area of the core (see percpu.h) */
+#define SEGSEL_KERNEL_PERCPU_IDX    (GDT_SEGS + 1)
+
+/** @brief Number of segments in the GDT of each core */
+#define GDT_SEGS_ALL            (GDT_SEGS + 2)
+
+/** @brief User TLS segment selector, RPL 3 */
+#define SEGSEL_USER_TLS         ((SEGSEL_USER_TLS_IDX << 3) | 3)
+
+/** @brief Kernel per core segment selector, RPL 0, the kernel keeps it in
+ *         %fs */
+#define SEGSEL_KERNEL_PERCPU    (SEGSEL_KERNEL_PERCPU_IDX << 3)
+
+#ifndef ASSEMBLER
+
+#include <stdint.h>
+
+int gdt_init(int cpu_id);
+
+void gdt_set_tls_base(uint32_t base);
+
+#endif /* ASSEMBLER */
+
+#endif
@@ -163,6 +163,24 @@ void deschedule_wrapper();
  */
 void make_runnable_wrapper();
 
+/** @brief Make_runnable_many syscall handler wrapper
+ *
+ *  @return Void
+ */
+void make_runnable_many_wrapper();
+
+/** @brief Set_tls_base syscall handler wrapper
+ *
+ *  @return Void
+ */
+void set_tls_base_wrapper();
+
+/** @brief Get_time_ns syscall handler wrapper
+ *
+ *  @return Void
+ */
+void get_time_ns_wrapper();
+
 /** @brief Readfile syscall handler wrapper
  *
  *  @return Void
@@ -28,4 +28,6 @@ void load_kernel_stack(void* k_stack_esp, void* u_stack_esp, void* program,
 
 void loadMailboxTask();
 
+void idle_fork_child();
+
 #endif /* _LOADER_H */
@@ -11,7 +11,7 @@
 #define _MUTEX_H_
 
 #include <spinlock.h>
-#include <simple_queue.h>
+#include <thr_queue.h>
 
 /** @brief Mutex type */
 typedef struct mutex {
@@ -20,9 +20,9 @@ typedef struct mutex {
     int lock_holder;
     /** @brief A spinlock to protect critical section of mutex code */
     spinlock_t inner_lock;
-    /** @brief A double-ended queue to store the threads that are blocking on
-     *         the mutex */
-    simple_queue_t deque;
+    /** @brief A FIFO queue to store the threads that are blocking on the 
+     *         mutex, linked through their wait_link */
+    thr_queue_t deque;
 } mutex_t;
 
 
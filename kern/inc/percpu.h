@@ -0,0 +1,118 @@
+/** @file percpu.h
+ *  @brief The per core data area and its accessors
+ *
+ *  Each core has one cache line aligned percpu_t. gdt_init() gives each
+ *  core a segment whose base is its own area, and the kernel keeps that
+ *  segment in %fs (asm_set_ss() reloads it on every kernel entry). The
+ *  selector is the same on every core, only the descriptor in the GDT of
+ *  the core differs, so reading a field is one %fs relative load, with no
+ *  LAPIC access and no indexing by core.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+#ifndef _PERCPU_H_
+#define _PERCPU_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <smp.h>
+#include <spinlock.h>
+#include <mutex.h>
+#include <thr_queue.h>
+
+/** @brief Size of a cache line, the alignment of each per core area */
+#define CACHE_LINE_SIZE 64
+
+struct tcb_t;
+
+/** @brief The per core data area */
+typedef struct percpu_t {
+    /** @brief Address of this area, to get a pointer with one load */
+    struct percpu_t *self;
+    /** @brief Index of the core */
+    int cpu_id;
+    /** @brief The thread running on the core */
+    struct tcb_t *cur_running_thr;
+    /** @brief Spinlock protecting the queue of the scheduler of the core. 
+     *         It can't be a mutex, which may block the thread and cause 
+     *         another context switch while the queue is being changed */
+    spinlock_t switch_lock;
+    /** @brief The queue of the scheduler of the core, threads are linked 
+     *         through their runq_link */
+    thr_queue_t run_queue;
+    /** @brief Mutex that protects the malloc library on the core */
+    mutex_t malloc_lock;
+    /** @brief Mutex that protects frame allocation of the core */
+    mutex_t pm_lock;
+    /** @brief Number of free frames currently available to the core */
+    int num_free_frames_left;
+    /** @brief The zombie threads to be freed, linked through their 
+     *         wait_link */
+    thr_queue_t zombie_list;
+    /** @brief Mutex that protects zombie_list */
+    mutex_t zombie_list_lock;
+    /** @brief The queue of threads blocked on sleep(), sorted by their time 
+     *         to wake up, the one to wake up first at the head */
+    thr_queue_t sleep_queue;
+    /** @brief Spinlock that keeps the timer interrupt away while sleep_queue 
+     *         is being changed */
+    spinlock_t sleep_lock;
+    /** @brief The queue of threads blocked on deschedule(), make_runnable() 
+     *         looks for its thread in this queue */
+    thr_queue_t deschedule_queue;
+    /** @brief Mutex that protects deschedule_queue */
+    mutex_t deschedule_mutex;
+} __attribute__((aligned(CACHE_LINE_SIZE))) percpu_t;
+
+/** @brief Read a 32-bit field of the area of the current core
+ *
+ *  @param field The field
+ *
+ *  @return Value of the field
+ */
+#define PERCPU_READ(field) ({                                               \
+    typeof(((percpu_t *)0)->field) _val;                                    \
+    asm volatile ("movl %%fs:%c1, %0"                                       \
+                  : "=r" (_val)                                             \
+                  : "i" (offsetof(percpu_t, field))                         \
+                  : "memory");                                              \
+    _val;                                                                   \
+})
+
+/** @brief Write a 32-bit field of the area of the current core
+ *
+ *  @param field The field
+ *  @param val The new value
+ */
+#define PERCPU_WRITE(field, val) do {                                       \
+    typeof(((percpu_t *)0)->field) _val = (val);                            \
+    asm volatile ("movl %0, %%fs:%c1"                                       \
+                  :                                                         \
+                  : "r" (_val), "i" (offsetof(percpu_t, field))             \
+                  : "memory");                                              \
+} while (0)
+
+/** @brief Get the index of the current core
+ *
+ *  It replaces smp_get_cpu(), which reads the LAPIC id through MMIO. It is
+ *  volatile so that it is read again after a context switch.
+ *
+ *  @return Index of the current core
+ */
+static inline int percpu_get_cpu() {
+    return PERCPU_READ(cpu_id);
+}
+
+/** @brief Get the area of the current core
+ *
+ *  @return Address of the area
+ */
+static inline percpu_t *percpu_self() {
+    return PERCPU_READ(self);
+}
+
+percpu_t *percpu_init(int cpu_id);
+
+#endif
@@ -0,0 +1,46 @@
+/** @file pt_lock.h
+ *  @brief This file defines the interface for page table range locks.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs
+ */
+
+#ifndef _PT_LOCK_H_
+#define _PT_LOCK_H_
+
+#include <stdint.h>
+#include <spinlock.h>
+#include <variable_queue.h>
+
+struct pt_lock_waiter;
+
+/** @brief Queue of threads that are waiting for some stripes */
+Q_NEW_HEAD(pt_lock_waiter_queue_t, pt_lock_waiter);
+
+/** @brief Page table range lock type
+ *
+ *  One lock per page directory. Every NUM_PT_PER_LOCK consecutive page tables
+ *  form a stripe, and a stripe is represented by a single bit of held_stripes
+ *  instead of a full mutex.
+ */
+typedef struct pt_lock {
+    /** @brief Bitmap of stripes that are currently locked, bit i is set if
+     *         stripe i is held by some thread */
+    uint64_t held_stripes;
+    /** @brief A spinlock to protect critical section of pt_lock code */
+    spinlock_t inner_lock;
+    /** @brief A FIFO queue to store the threads that are blocking on some
+     *         stripes of the lock */
+    pt_lock_waiter_queue_t waiters;
+} pt_lock_t;
+
+int pt_lock_init(pt_lock_t *lock);
+void pt_lock_destroy(pt_lock_t *lock);
+void pt_lock_lock(pt_lock_t *lock, uint32_t lowest_pd_index,
+                                                uint32_t highest_pd_index);
+void pt_lock_unlock(pt_lock_t *lock, uint32_t lowest_pd_index,
+                                                uint32_t highest_pd_index);
+
+#endif /* _PT_LOCK_H_ */
@@ -1,7 +1,7 @@
 #ifndef _SMP_MESSAGE_H_
 #define _SMP_MESSAGE_H_
 
-#include <simple_queue.h>
+#include <variable_queue.h>
 
 /* Request data */
 
@@ -128,9 +128,9 @@ typedef enum {
 } msg_type_t;
 
 /** @brief Message type */
-typedef struct {
-    /** @brief A node to enable this message be put in a queue somewhere */
-    simple_node_t node;  // 12 bytes
+typedef struct msg_t {
+    /** @brief A link to enable this message be put in a queue somewhere */
+    Q_NEW_LINK(msg_t) link;  // 8 bytes
     /** @brief The tcb of the thread that issues a interprocessor syscall */
     void* req_thr;  // 4 bytes
     /** @brief The index of the core where the requesting thread resides */
@@ -161,9 +161,14 @@ typedef struct {
     } data; // 16 bytes
 } msg_t;
 
+/** @brief Queue of messages */
+Q_NEW_HEAD(msg_queue_t, msg_t);
+
 
 int msg_init();
 
+msg_t* dequeue_msg(msg_queue_t* queue);
+
 int init_ap_msg();
 
 void msg_synchronize();
@@ -30,9 +30,9 @@ void* timer_callback(unsigned int ticks);
 
 int has_read_waiting_thr();
 
-simple_node_t* get_next_zombie();
+tcb_t* get_next_zombie();
 
-int put_next_zombie(simple_node_t* node);
+void put_next_zombie(tcb_t* thr);
 
 mutex_t *get_zombie_list_lock();
 
@@ -0,0 +1,24 @@
+/** @file thr_queue.h
+ *  @brief This file defines the queue type for threads.
+ *
+ *  A thread is linked into a thr_queue_t through one of the links embedded 
+ *  in its tcb (see control_block.h), so that enqueueing a thread never needs
+ *  a separate node and a known thread can be removed in O(1).
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs
+ */
+
+#ifndef _THR_QUEUE_H_
+#define _THR_QUEUE_H_
+
+#include <variable_queue.h>
+
+struct tcb_t;
+
+/** @brief Queue of threads */
+Q_NEW_HEAD(thr_queue_t, tcb_t);
+
+#endif /* _THR_QUEUE_H_ */
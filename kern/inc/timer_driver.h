@@ -6,6 +6,8 @@
 #ifndef _TIMER_DRIVER_H_
 #define _TIMER_DRIVER_H_
 
+#include <stdint.h>
+
 /** @brief IDT slot for APIC timer */
 #define APIC_TIMER_IDT_ENTRY 0x22
 
@@ -15,4 +17,6 @@ void init_lapic_timer_driver();
 
 unsigned int timer_get_ticks();
 
+uint64_t timer_get_time_ns();
+
 #endif
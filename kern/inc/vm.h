@@ -102,7 +102,8 @@
 #define NUM_PT_PER_LOCK 16
 /** @brief Num of locks per page directory, if NUM_PT_PER_LOCK is 8, and since
   * there are 1024 entries in a page table, then there're 128 locks for
-  * a page directory.
+  * a page directory. Each lock is one bit of pt_lock_t, so it can not
+  * exceed 64.
   */
 #define NUM_PT_LOCKS_PER_PD (PAGE_SIZE/ENTRY_SIZE/NUM_PT_PER_LOCK)
 
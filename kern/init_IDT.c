@@ -261,6 +261,18 @@ int init_IDT() {
     install_IDT_entry(MAKE_RUNNABLE_INT, make_runnable_wrapper, 
                                                         SEGSEL_KERNEL_CS, 3, 0);
 
+    // install make_runnable_many() syscall handler
+    install_IDT_entry(MAKE_RUNNABLE_MANY_INT, make_runnable_many_wrapper, 
+                                                        SEGSEL_KERNEL_CS, 3, 0);
+
+    // install set_tls_base() syscall handler
+    install_IDT_entry(SET_TLS_BASE_INT, set_tls_base_wrapper, 
+                                                        SEGSEL_KERNEL_CS, 3, 0);
+
+    // install get_time_ns() syscall handler
+    install_IDT_entry(GET_TIME_NS_INT, get_time_ns_wrapper, 
+                                                        SEGSEL_KERNEL_CS, 3, 0);
+
     // install readfile() syscall handler
     install_IDT_entry(READFILE_INT, readfile_wrapper, SEGSEL_KERNEL_CS, 3, 0);
 
@@ -23,6 +23,7 @@
 #include <console.h>
 #include <syscall_inter.h>
 #include <context_switcher.h>
+#include <gdt.h>
 
 #include <mptable.h>
 
@@ -46,6 +47,10 @@ static void kernel_init();
 int kernel_main(mbinfo_t *mbinfo, int argc, char **argv, char **envp)
 {
 
+    // Set up the per core area first, percpu_get_cpu() is used everywhere
+    if (gdt_init(0) < 0)
+        panic("Initialize GDT at cpu0 failed!");
+
     if(smp_init(mbinfo) < 0) {
         panic("smp_init failed");
     }
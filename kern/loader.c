@@ -34,6 +34,7 @@
 #include <syscall_errors.h>
 
 #include <smp.h>
+#include <percpu.h>
 #include <timer_driver.h>
 
 /** @brief The maximum address space supported by the kernel */
@@ -167,7 +168,7 @@ void loadFirstTask(const char *filename) {
     // create the idle process
     tcb_t *thread = tcb_create_idle_process(NORMAL, get_cr3());
     if (thread == NULL)
-        panic("Load first task failed for cpu%d", smp_get_cpu());
+        panic("Load first task failed for cpu%d", percpu_get_cpu());
 
     asm_idle_process_load(thread->k_stack_esp, filename);
 }
@@ -185,7 +186,7 @@ void load_idle_process(const char *filename) {
     // Init lapic timer
     init_lapic_timer_driver();
 
-    lprintf("Lapic timer inited for cpu%d", smp_get_cpu());
+    lprintf("Lapic timer inited for cpu%d", percpu_get_cpu());
 
 
     void *my_program, *usr_esp;
@@ -193,10 +194,10 @@ void load_idle_process(const char *filename) {
 
     const char *argv[1] = {filename};
     if ((rv = loadTask(filename, 1, argv, &usr_esp, &my_program)) < 0)
-        panic("Load first task failed for cpu%d", smp_get_cpu());
+        panic("Load first task failed for cpu%d", percpu_get_cpu());
 
     // set idle thread
-    idle_thr[smp_get_cpu()] = thread;
+    idle_thr[percpu_get_cpu()] = thread;
 
     load_kernel_stack(thread->k_stack_esp, usr_esp, my_program, 
                                                 strcmp(filename, "idle") == 0);
@@ -382,57 +383,62 @@ void* push_to_stack(void *esp, uint32_t value) {
  *  @return Void
  */
 void idle_process_init() {
-    lprintf("Initializing idle process for cpu%d", smp_get_cpu());
+    lprintf("Initializing idle process for cpu%d", percpu_get_cpu());
 
     // let cpu1 to fork init
-    if (smp_get_cpu() != 1)
+    if (percpu_get_cpu() != 1)
         return;
     
-    // fork
+    // fork, the child starts at idle_fork_child() and the parent (idle) 
+    // returns here
     context_switch(OP_FORK, 0);
-    if (tcb_get_entry((void*)asm_get_esp())->result == 0) {  
-
-        // child process, exec(init)
-        char my_execname[] = "init";
-        char *argv[] = {my_execname, 0};
+}
 
-        uint32_t old_pd = get_cr3();
+/** @brief Exec init in the child process of idle task
+ *
+ *  The child process forked by idle_process_init() starts here once the 
+ *  context switch to it finishes.
+ *
+ *  @return Should never return
+ */
+void idle_fork_child() {
+    // child process, exec(init)
+    char my_execname[] = "init";
+    char *argv[] = {my_execname, 0};
 
-        // create new page table
-        uint32_t new_pd = create_pd();
-        if(new_pd == ERROR_MALLOC_LIB) {
-            panic("create_pd() in idle_process_init() failed");
-        }
-        tcb_t *this_thr = tcb_get_entry((void*)asm_get_esp());
-        this_thr->pcb->page_table_base = new_pd;
-        set_cr3(new_pd);
-        
-        // load task
-        void *my_program, *usr_esp;
-        int rv;
-        if ((rv = loadTask(my_execname, 1, (const char**)argv, &usr_esp, 
-                                                            &my_program)) < 0) {
-            panic("load init task failed");
-        }
+    uint32_t old_pd = get_cr3();
 
-        int need_unreserve_frames = 1;
-        free_entire_space(old_pd, need_unreserve_frames);
+    // create new page table
+    uint32_t new_pd = create_pd();
+    if(new_pd == ERROR_MALLOC_LIB) {
+        panic("create_pd() in idle_fork_child() failed");
+    }
+    tcb_t *this_thr = tcb_get_entry((void*)asm_get_esp());
+    this_thr->pcb->page_table_base = new_pd;
+    set_cr3(new_pd);
+    
+    // load task
+    void *my_program, *usr_esp;
+    int rv;
+    if ((rv = loadTask(my_execname, 1, (const char**)argv, &usr_esp, 
+                                                        &my_program)) < 0) {
+        panic("load init task failed");
+    }
 
-        // modify tcb
-        this_thr->k_stack_esp = tcb_get_high_addr((void*)asm_get_esp());
+    int need_unreserve_frames = 1;
+    free_entire_space(old_pd, need_unreserve_frames);
 
-        // set init_pcb (who-to-reap-orphan-process) 
-        if (set_init_pcb(this_thr->pcb) < 0) {
-            panic("set_init_pcb() failed");
-        }
+    // modify tcb
+    this_thr->k_stack_esp = tcb_get_high_addr((void*)asm_get_esp());
 
-        lprintf("Ready to load init process");
-        // load kernel stack, jump to new program
-        load_kernel_stack(this_thr->k_stack_esp, usr_esp, my_program, 0);
-    } else {
-        // parent process(idle)
-        return;
+    // set init_pcb (who-to-reap-orphan-process) 
+    if (set_init_pcb(this_thr->pcb) < 0) {
+        panic("set_init_pcb() failed");
     }
+
+    lprintf("Ready to load init process");
+    // load kernel stack, jump to new program
+    load_kernel_stack(this_thr->k_stack_esp, usr_esp, my_program, 0);
 }
 
 
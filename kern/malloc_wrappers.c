@@ -13,9 +13,7 @@
 #include <mutex.h>
 #include <simics.h>
 #include <asm_atomic.h>
-
-/** @brief Locks that protect mutex library */
-static mutex_t* lock[MAX_CPUS];
+#include <percpu.h>
 
 /** @brief Init malloc library 
  *
@@ -23,13 +21,9 @@ static mutex_t* lock[MAX_CPUS];
  *
  */
 int malloc_init(int cpu_id) {
-    
-    // let each cpu malloc its own mutex to avoid false sharing problem
-    lock[cpu_id] = _malloc(sizeof(mutex_t));
-    if (lock[cpu_id] == NULL)
-        return -1;
 
-    if(mutex_init(lock[cpu_id]) < 0)
+    // the lock lives in the cache line aligned per core area of the core
+    if(mutex_init(&percpu_self()->malloc_lock) < 0)
         return -1;
 
     return 0;
@@ -44,12 +38,12 @@ int malloc_init(int cpu_id) {
  */
 void *malloc(size_t size)
 {
-    int cur_cpu = smp_get_cpu();
+    mutex_t *lock = &percpu_self()->malloc_lock;
 
     void* rv;
-    mutex_lock(lock[cur_cpu]);
+    mutex_lock(lock);
     rv = _malloc(size);
-    mutex_unlock(lock[cur_cpu]);
+    mutex_unlock(lock);
     return rv;
 }
 
@@ -62,12 +56,12 @@ void *malloc(size_t size)
  */
 void *memalign(size_t alignment, size_t size)
 {
-    int cur_cpu = smp_get_cpu();
+    mutex_t *lock = &percpu_self()->malloc_lock;
 
     void* rv;
-    mutex_lock(lock[cur_cpu]);
+    mutex_lock(lock);
     rv = _memalign(alignment, size);
-    mutex_unlock(lock[cur_cpu]);
+    mutex_unlock(lock);
     return rv;
 }
 
@@ -81,12 +75,12 @@ void *memalign(size_t alignment, size_t size)
 void *calloc(size_t nelt, size_t eltsize)
 {
 
-    int cur_cpu = smp_get_cpu();
+    mutex_t *lock = &percpu_self()->malloc_lock;
 
     void* rv;
-    mutex_lock(lock[cur_cpu]);
+    mutex_lock(lock);
     rv = _calloc(nelt, eltsize);
-    mutex_unlock(lock[cur_cpu]);
+    mutex_unlock(lock);
     return rv;
 }
 
@@ -99,12 +93,12 @@ void *calloc(size_t nelt, size_t eltsize)
  */
 void *realloc(void *buf, size_t new_size)
 {
-    int cur_cpu = smp_get_cpu();
+    mutex_t *lock = &percpu_self()->malloc_lock;
 
     void* rv;
-    mutex_lock(lock[cur_cpu]);
+    mutex_lock(lock);
     rv = _realloc(buf, new_size);
-    mutex_unlock(lock[cur_cpu]);
+    mutex_unlock(lock);
     return rv;
 }
 
@@ -116,11 +110,11 @@ void *realloc(void *buf, size_t new_size)
  */
 void free(void *buf)
 {
-    int cur_cpu = smp_get_cpu();
+    mutex_t *lock = &percpu_self()->malloc_lock;
 
-    mutex_lock(lock[cur_cpu]);
+    mutex_lock(lock);
     _free(buf);
-    mutex_unlock(lock[cur_cpu]);
+    mutex_unlock(lock);
 }
 
 /** @brief Thread-safe version of _smalloc
@@ -131,12 +125,12 @@ void free(void *buf)
  */
 void *smalloc(size_t size)
 {
-    int cur_cpu = smp_get_cpu();
+    mutex_t *lock = &percpu_self()->malloc_lock;
 
     void* rv;
-    mutex_lock(lock[cur_cpu]);
+    mutex_lock(lock);
     rv = _smalloc(size);
-    mutex_unlock(lock[cur_cpu]);
+    mutex_unlock(lock);
     return rv;
 }
 
@@ -149,12 +143,12 @@ void *smalloc(size_t size)
  */
 void *smemalign(size_t alignment, size_t size)
 {
-    int cur_cpu = smp_get_cpu();
+    mutex_t *lock = &percpu_self()->malloc_lock;
 
     void* rv;
-    mutex_lock(lock[cur_cpu]);
+    mutex_lock(lock);
     rv = _smemalign(alignment, size);
-    mutex_unlock(lock[cur_cpu]);
+    mutex_unlock(lock);
     return rv;
 }
 
@@ -167,11 +161,11 @@ void *smemalign(size_t alignment, size_t size)
  */
 void sfree(void *buf, size_t size)
 {
-    int cur_cpu = smp_get_cpu();
+    mutex_t *lock = &percpu_self()->malloc_lock;
 
-    mutex_lock(lock[cur_cpu]);
+    mutex_lock(lock);
     _sfree(buf, size);
-    mutex_unlock(lock[cur_cpu]);
+    mutex_unlock(lock);
 }
 
 /** @brief Get malloc library's lock
@@ -180,8 +174,8 @@ void sfree(void *buf, size_t size)
  *
  */
 mutex_t *get_malloc_lib_lock() {
-    int cur_cpu = smp_get_cpu();
+    mutex_t *lock = &percpu_self()->malloc_lock;
 
-    return lock[cur_cpu];
+    return lock;
 }
 
@@ -7,9 +7,8 @@
  *        non-negative number means mutex is locked by someone, the number is 
  *        the tid of the thread that holding the mutex.
  *     2. inner_lock: a spinlock to protect critical section of mutex code.
- *     3. deque: a double-ended queue to store the threads that are blocking on
- *        the mutex. The queue is FIFO so first blocked thread will get the 
- *        mutex first. 
+ *     3. deque: a queue to store the threads that are blocking on the mutex.
+ *        The queue is FIFO so first blocked thread will get the mutex first. 
  *
  *  To achieve bounded waiting, a spinlock and a queue are used. Although 
  *  spinlock itself doesn't satisfy bounded waitting, the critical section 
@@ -22,9 +21,8 @@
  *  approximate bounded waiting.
  *
  *  Note that to avoid using malloc() (which will be protected by mutex after 
- *  mutex is implemented...), the stack space of blocked threads is used to 
- *  construct node for queue. Because the stack of the procedure call will not 
- *  be destroied until the blocked thread get the mutex, so it is safe.
+ *  mutex is implemented...), blocked threads are linked in the queue through 
+ *  the wait_link embedded in their tcb, so no queue node is needed.
  *
  *  A thread that can not get the mutex immediately when calling mutex_lock() 
  *  will be blocked on the mutex and will not be scheduled by scheduler until 
@@ -54,7 +52,7 @@
 int mutex_init(mutex_t *mp) {
     mp->lock_holder = -1; 
     int is_error = spinlock_init(&mp->inner_lock);
-    is_error |= simple_queue_init(&mp->deque);
+    Q_INIT_HEAD(&mp->deque);
     return is_error ? -1 : 0;
 }
 
@@ -73,8 +71,7 @@ void mutex_destroy(mutex_t *mp) {
     }
 
     
-    if  (mp->lock_holder != -1 || 
-        simple_queue_destroy(&mp->deque) < 0) {
+    if  (mp->lock_holder != -1 || Q_GET_FRONT(&mp->deque) != NULL) {
         // illegal, mutex is locked or some threads are waiting for the mutex
         // this is impossible in our implementation of kernel
         panic("Destroy mutex %p failed", mp);
@@ -110,13 +107,8 @@ void mutex_lock(mutex_t *mp) {
         mp->lock_holder = thr->tid;
         spinlock_unlock(&mp->inner_lock, 1);
     } else {
-        simple_node_t node;
-        node.thr = thr;
-
-        // mutex is locked, enter the tail of queue to wait, note that stack
-        // memory is used for queue_node. Because the stack of mutex_lock()
-        // will not be destroied until this thread get the mutex, so it is safe
-        simple_queue_enqueue(&mp->deque, &node);
+        // mutex is locked, enter the tail of queue to wait
+        Q_INSERT_TAIL(&mp->deque, thr, wait_link);
 
         spinlock_unlock(&mp->inner_lock, 1);
 
@@ -186,22 +178,23 @@ void mutex_unlock(mutex_t *mp) {
         panic("try to unlock an unlocked mutex %p", mp);
     }
 
-    simple_node_t* node = simple_queue_dequeue(&mp->deque);
+    tcb_t* thr = Q_GET_FRONT(&mp->deque);
 
-    if (node == NULL) {
+    if (thr == NULL) {
         // no thread is waiting on the mutex, set mutex as available 
         mp->lock_holder = -1;
     } else {
         // some threads are waiting the mutex, hand over the lock to the thread
         // in the head of queue
-        mp->lock_holder = ((tcb_t *)(node->thr))->tid;
+        Q_REMOVE(&mp->deque, thr, wait_link);
+        mp->lock_holder = thr->tid;
     }
 
     spinlock_unlock(&mp->inner_lock, 1);
 
-    if (node != NULL) {
+    if (thr != NULL) {
         // Make runnable the blocked thread in the head of queue (and now it is
         // the holder of the mutex, so it can make progress when it is running)
-        context_switch(OP_MAKE_RUNNABLE, (uint32_t)node->thr);
+        context_switch(OP_MAKE_RUNNABLE, (uint32_t)thr);
     }
 }
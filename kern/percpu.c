@@ -0,0 +1,35 @@
+/** @file percpu.c
+ *  @brief The per core data areas
+ *
+ *  The areas are statically allocated, so that a core can set its area up
+ *  before malloc() or paging works on it.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+
+#include <percpu.h>
+#include <string.h>
+
+/** @brief The per core data areas */
+static percpu_t percpu_area[MAX_CPUS];
+
+/** @brief Initialize the area of a core
+ *
+ *  It is called by gdt_init() of each core, which points the per core
+ *  segment to the area it returns.
+ *
+ *  @param cpu_id The id of the core calling it
+ *
+ *  @return The area of the core
+ */
+percpu_t *percpu_init(int cpu_id) {
+    percpu_t *area = &percpu_area[cpu_id];
+
+    memset(area, 0, sizeof(percpu_t));
+    area->self = area;
+    area->cpu_id = cpu_id;
+
+    return area;
+}
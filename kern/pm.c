@@ -12,6 +12,7 @@
 #include <asm_atomic.h>
 #include <mutex.h>
 #include <smp.h>
+#include <percpu.h>
 #include <mptable.h>
 
 /** @brief Number of cores */
@@ -20,15 +21,9 @@ static int num_cpus;
 /** @brief Number of free frames per core initially */
 static int num_free_frames_per_core;
 
-/** @brief Number of free frames currently available in physical memory */
-static int *num_free_frames_left[MAX_CPUS];
-
 /** @brief The lapic base frame that shouldn't be allocated */
 static uint32_t lapic_base;
 
-/** @brief Mutex that protects frame allocation */
-static mutex_t *lock[MAX_CPUS];
-
 /**
  * @brief Get a free frame
  * 
@@ -39,11 +34,12 @@ static mutex_t *lock[MAX_CPUS];
  */
 uint32_t get_frames_raw() {
 
-    int cur_cpu = smp_get_cpu();
+    percpu_t *percpu = percpu_self();
+    int cur_cpu = percpu->cpu_id;
 
-    mutex_lock(lock[cur_cpu]);
+    mutex_lock(&percpu->pm_lock);
     uint32_t index = get_next();
-    mutex_unlock(lock[cur_cpu]);
+    mutex_unlock(&percpu->pm_lock);
 
     if((int)index == NAN) {
         return ERROR_NOT_ENOUGH_MEM;
@@ -69,14 +65,15 @@ uint32_t get_frames_raw() {
  */
 void free_frames_raw(uint32_t base) {
 
-    int cur_cpu = smp_get_cpu();
+    percpu_t *percpu = percpu_self();
+    int cur_cpu = percpu->cpu_id;
 
     int index = (base - cur_cpu * num_free_frames_per_core * PAGE_SIZE - 
             USER_MEM_START) / PAGE_SIZE;
 
-    mutex_lock(lock[cur_cpu]);
+    mutex_lock(&percpu->pm_lock);
     put_back(index);
-    mutex_unlock(lock[cur_cpu]);
+    mutex_unlock(&percpu->pm_lock);
 
 }
 
@@ -88,7 +85,7 @@ void free_frames_raw(uint32_t base) {
  */
 int init_pm() {
 
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
 
     lprintf("Init pm for cpu %d", cur_cpu);
 
@@ -107,13 +104,9 @@ int init_pm() {
         lapic_base = (uint32_t)smp_lapic_base();
     }
 
-    // Malloc on each core to avoid false sharing
-    num_free_frames_left[cur_cpu] = malloc(sizeof(int));
-    if(num_free_frames_left[cur_cpu] == NULL) {
-        return -1; 
-    }
-
-    *num_free_frames_left[cur_cpu] = num_free_frames_per_core;
+    // The counter and the lock live in the per core area of the core
+    percpu_t *percpu = percpu_self();
+    percpu->num_free_frames_left = num_free_frames_per_core;
     lprintf("add user memory %d frames for cpu %d succeeded",
             num_free_frames_per_core, cur_cpu);
 
@@ -122,12 +115,7 @@ int init_pm() {
         return -1;
     }
 
-    lock[cur_cpu] = malloc(sizeof(mutex_t));
-    if(lock[cur_cpu] == NULL) {
-        return -1;
-    }
-
-    if (mutex_init(lock[cur_cpu]) < 0) {
+    if (mutex_init(&percpu->pm_lock) < 0) {
         lprintf("mutex_init() failed when init_pm()");
         return -1;
     }
@@ -148,12 +136,11 @@ int init_pm() {
  */
 int reserve_frames(int count) {
 
-    int cur_cpu = smp_get_cpu();
+    int *num_free_frames_left = &percpu_self()->num_free_frames_left;
 
-    *num_free_frames_left[cur_cpu] = 
-        atomic_add(num_free_frames_left[cur_cpu], -count);
-    if(*num_free_frames_left[cur_cpu] < 0) {
-        atomic_add(num_free_frames_left[cur_cpu], count);
+    *num_free_frames_left = atomic_add(num_free_frames_left, -count);
+    if(*num_free_frames_left < 0) {
+        atomic_add(num_free_frames_left, count);
         return -1;
     }
 
@@ -170,7 +157,6 @@ int reserve_frames(int count) {
  */
 void unreserve_frames(int count) {
 
-    int cur_cpu = smp_get_cpu();
-    atomic_add(num_free_frames_left[cur_cpu], count); 
+    atomic_add(&percpu_self()->num_free_frames_left, count); 
 }
 
@@ -0,0 +1,196 @@
+/** @file pt_lock.c
+ *  @brief Implementation of page table range lock
+ *
+ *  In P3 every pcb embedded NUM_PT_LOCKS_PER_PD full mutexes, one for every
+ *  NUM_PT_PER_LOCK consecutive page tables (a "stripe"). That costs several
+ *  KB per task and all of them had to be initialized on every fork(), while
+ *  most tasks only touch two or three stripes (text/data low, stack high).
+ *
+ *  pt_lock_t instead keeps one bit per stripe in held_stripes, together with
+ *  a single spinlock and a single waiting queue for the whole page directory.
+ *  A thread locks a contiguous range of stripes at once:
+ *     1. If none of the stripes in its range is held, and no earlier waiter
+ *        wants any of them, it sets the bits and goes on.
+ *     2. Otherwise it enqueues a pt_lock_waiter_t (allocated on its own
+ *        stack, just like mutex_lock() does) and blocks.
+ *  When a range is unlocked, the waiting queue is scanned in FIFO order and
+ *  every waiter whose range becomes free is handed its stripes directly and
+ *  made runnable. A waiter that can not be granted yet "shadows" its stripes
+ *  so that later waiters on overlapping stripes can not overtake it, which
+ *  keeps the bounded waiting property of the old per-stripe mutexes.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <pt_lock.h>
+#include <vm.h>
+#include <asm_helper.h>
+#include <control_block.h>
+#include <context_switcher.h>
+
+#if NUM_PT_LOCKS_PER_PD > 64
+#error "pt_lock_t can not represent more than 64 stripes"
+#endif
+
+/** @brief The structure that a blocked thread puts in the waiting queue */
+typedef struct pt_lock_waiter {
+    /** @brief Link in the waiting queue */
+    Q_NEW_LINK(pt_lock_waiter) link;
+    /** @brief The thread that is waiting */
+    tcb_t *thr;
+    /** @brief The stripes that the thread is waiting for */
+    uint64_t stripes;
+    /** @brief Set by the unlocking thread once stripes are handed over */
+    int is_granted;
+} pt_lock_waiter_t;
+
+/** @brief Get the bitmap of the stripes that cover a range of page tables
+ *
+ *  @param lowest_pd_index The lowest page directory index of the range
+ *  @param highest_pd_index The highest page directory index of the range
+ *
+ *  @return Bitmap whose bits are set for all stripes that cover the range
+ */
+static uint64_t get_stripes(uint32_t lowest_pd_index,
+                                                uint32_t highest_pd_index) {
+    int lowest = lowest_pd_index / NUM_PT_PER_LOCK;
+    int highest = highest_pd_index / NUM_PT_PER_LOCK;
+    int num = highest - lowest + 1;
+
+    if (num >= NUM_PT_LOCKS_PER_PD)
+        return ~0ULL;
+    return ((1ULL << num) - 1) << lowest;
+}
+
+/** @brief Initialize page table range lock
+ *
+ *  @param lock The lock to initialize
+ *
+ *  @return 0 on success; -1 on error
+ */
+int pt_lock_init(pt_lock_t *lock) {
+    lock->held_stripes = 0;
+    Q_INIT_HEAD(&lock->waiters);
+    return spinlock_init(&lock->inner_lock);
+}
+
+/** @brief Destroy page table range lock
+ *
+ *  @param lock The lock to destroy
+ *
+ *  @return void
+ */
+void pt_lock_destroy(pt_lock_t *lock) {
+    spinlock_lock(&lock->inner_lock, 1);
+
+    if (lock->held_stripes != 0 || Q_GET_FRONT(&lock->waiters) != NULL) {
+        // illegal, some stripes are locked or some threads are waiting
+        panic("Destroy page table lock %p failed", lock);
+    }
+
+    spinlock_unlock(&lock->inner_lock, 1);
+}
+
+/** @brief Lock the stripes that cover a range of page tables
+ *
+ *  @param lock The page table lock of the task
+ *  @param lowest_pd_index The lowest page directory index of the range
+ *  @param highest_pd_index The highest page directory index of the range
+ *
+ *  @return void
+ */
+void pt_lock_lock(pt_lock_t *lock, uint32_t lowest_pd_index,
+                                                uint32_t highest_pd_index) {
+    uint64_t stripes = get_stripes(lowest_pd_index, highest_pd_index);
+
+    spinlock_lock(&lock->inner_lock, 1);
+
+    // stripes that are held or that earlier waiters are waiting for
+    uint64_t busy = lock->held_stripes;
+    pt_lock_waiter_t *cur;
+    Q_FOREACH(cur, &lock->waiters, link) {
+        busy |= cur->stripes;
+    }
+
+    if ((busy & stripes) == 0) {
+        // all stripes are available, get them directly
+        lock->held_stripes |= stripes;
+        spinlock_unlock(&lock->inner_lock, 1);
+        return;
+    }
+
+    // stack memory is used for the waiter. Because the stack of pt_lock_lock()
+    // will not be destroied until this thread get the stripes, so it is safe
+    pt_lock_waiter_t waiter;
+    waiter.thr = tcb_get_entry((void*)asm_get_esp());
+    waiter.stripes = stripes;
+    waiter.is_granted = 0;
+    Q_INSERT_TAIL(&lock->waiters, &waiter, link);
+
+    spinlock_unlock(&lock->inner_lock, 1);
+
+    // while this thread doesn't get the stripes, block itself
+    // in our implementation, this while loop should only loop once
+    while (!waiter.is_granted) {
+        context_switch(OP_BLOCK, 0);
+    }
+}
+
+/** @brief Unlock the stripes that cover a range of page tables
+ *
+ *  The range must be the same as the one passed to pt_lock_lock().
+ *
+ *  @param lock The page table lock of the task
+ *  @param lowest_pd_index The lowest page directory index of the range
+ *  @param highest_pd_index The highest page directory index of the range
+ *
+ *  @return void
+ */
+void pt_lock_unlock(pt_lock_t *lock, uint32_t lowest_pd_index,
+                                                uint32_t highest_pd_index) {
+    uint64_t stripes = get_stripes(lowest_pd_index, highest_pd_index);
+
+    // waiters that are granted stripes by this unlock, they are linked
+    // through their link after being removed from the waiting queue
+    pt_lock_waiter_queue_t granted;
+    Q_INIT_HEAD(&granted);
+
+    spinlock_lock(&lock->inner_lock, 1);
+
+    if ((lock->held_stripes & stripes) != stripes) {
+        panic("try to unlock unlocked stripes of page table lock %p", lock);
+    }
+
+    lock->held_stripes &= ~stripes;
+
+    // hand over stripes to waiters in FIFO order, stripes of a waiter that
+    // still can not be granted are shadowed to prevent later waiters
+    // from overtaking it
+    uint64_t shadowed = 0;
+    pt_lock_waiter_t *waiter = Q_GET_FRONT(&lock->waiters);
+    while (waiter != NULL) {
+        pt_lock_waiter_t *next = Q_GET_NEXT(waiter, link);
+        if (((lock->held_stripes | shadowed) & waiter->stripes) == 0) {
+            lock->held_stripes |= waiter->stripes;
+            Q_REMOVE(&lock->waiters, waiter, link);
+            Q_INSERT_TAIL(&granted, waiter, link);
+        } else {
+            shadowed |= waiter->stripes;
+        }
+        waiter = next;
+    }
+
+    spinlock_unlock(&lock->inner_lock, 1);
+
+    // Make runnable the granted threads. The waiter lives on the stack of the
+    // blocked thread, so read everything needed before setting is_granted
+    while ((waiter = Q_GET_FRONT(&granted)) != NULL) {
+        Q_REMOVE(&granted, waiter, link);
+        tcb_t *thr = waiter->thr;
+        waiter->is_granted = 1;
+        context_switch(OP_MAKE_RUNNABLE, (uint32_t)thr);
+    }
+}
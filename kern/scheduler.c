@@ -6,10 +6,11 @@
  *  @bug None known
  */
 
-#include <simple_queue.h>
+#include <thr_queue.h>
 #include <control_block.h>
 #include <simics.h>
 #include <smp.h>
+#include <percpu.h>
 
 extern void context_switch_unlock();
 
@@ -17,22 +18,28 @@ extern void context_switch_lock();
 
 extern tcb_t* get_current_running_thr();
 
-/** @brief The scheduler queue */
-static simple_queue_t* queues[MAX_CPUS];
+/** @brief Find a thread in the queue of scheduler by its tid
+ *
+ *  @param queue The queue of scheduler to look in
+ *  @param tid The tid of the thread to look for
+ *
+ *  @return The tcb of the thread if it is in the queue; NULL otherwise
+ */
+static tcb_t* scheduler_find_tid(thr_queue_t *queue, int tid) {
+    tcb_t* thr;
+    Q_FOREACH(thr, queue, runq_link) {
+        if (thr->tid == tid)
+            return thr;
+    }
+    return NULL;
+}
 
 /** @brief Init scheduler
  *
  *  @return 0 on success; -1 on error
  */
 int scheduler_init() {
-    int cur_cpu = smp_get_cpu();
-
-    queues[cur_cpu] = malloc(sizeof(simple_queue_t));
-    if (queues[cur_cpu] == NULL)
-        return -1;
-
-    if (simple_queue_init(queues[cur_cpu]) < 0)
-        return -1;
+    Q_INIT_HEAD(&percpu_self()->run_queue);
 
     return 0;
 }
@@ -46,7 +53,8 @@ int scheduler_init() {
  *  queue is empty.
  */
 tcb_t* scheduler_get_next(int mode) {
-    simple_node_t* node;
+    thr_queue_t* queue = &percpu_self()->run_queue;
+    tcb_t* thr;
 
     if (mode == -1) {
         // before get the next thread from queue of scheduler, check the recv
@@ -56,16 +64,16 @@ tcb_t* scheduler_get_next(int mode) {
         if (rv)
             return rv;
 
-        node = simple_queue_dequeue(queues[smp_get_cpu()]);
+        thr = Q_GET_FRONT(queue);
     } else {
         // yield to a specific thread
-        node = simple_queue_remove_tid(queues[smp_get_cpu()], mode);
+        thr = scheduler_find_tid(queue, mode);
     }
 
-    if (node == NULL)
-        return NULL;
-    else 
-        return node->thr;
+    if (thr != NULL)
+        Q_REMOVE(queue, thr, runq_link);
+
+    return thr;
 }
 
 
@@ -75,12 +83,13 @@ tcb_t* scheduler_get_next(int mode) {
  *  queue is empty.
  */
 tcb_t* scheduler_block() {
-    simple_node_t* node = simple_queue_dequeue(queues[smp_get_cpu()]);
+    thr_queue_t* queue = &percpu_self()->run_queue;
+    tcb_t* thr = Q_GET_FRONT(queue);
 
-    if (node == NULL)
-        return NULL;
-    else 
-        return node->thr;
+    if (thr != NULL)
+        Q_REMOVE(queue, thr, runq_link);
+
+    return thr;
 }
 
 
@@ -93,13 +102,7 @@ tcb_t* scheduler_block() {
  *  @return void
  */
 void scheduler_make_runnable(tcb_t *thread) {
-    // using the kernel stack space of thread to store its queue node
-    // it is safe because the stack memory will not be reclaimed until 
-    // the next time context switch 
-    simple_node_t* node = (simple_node_t*)thread->k_stack_esp;
-    
-    node->thr = thread;
-    simple_queue_enqueue(queues[smp_get_cpu()], node);
+    Q_INSERT_TAIL(&percpu_self()->run_queue, thread, runq_link);
 }
 
 /** @brief Check if a thread is running or runnable on this core. 
@@ -112,7 +115,7 @@ void scheduler_make_runnable(tcb_t *thread) {
  */
 int scheduler_is_exist_or_running(int tid) {
     context_switch_lock();
-    int rv = simple_queue_is_exist_tid(queues[smp_get_cpu()], tid);
+    int rv = (scheduler_find_tid(&percpu_self()->run_queue, tid) != NULL);
     context_switch_unlock();
 
     if (tid == get_current_running_thr()->tid)
@@ -30,6 +30,7 @@
 #include <asm_helper.h>
 #include <seg_tree.h>
 #include <smp.h>
+#include <percpu.h>
 #include <mptable.h>
 
 /** @brief Check if a given node index is a leaf node */
@@ -83,7 +84,7 @@ static uint32_t get_next_pow2(uint32_t value) {
  */
 static uint32_t init_recursive(uint32_t index) {
 
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
 
     if (!IS_VALID(index))
         return NAN;
@@ -127,7 +128,7 @@ static uint32_t init_recursive(uint32_t index) {
  */
 int init_seg_tree(int num) {
 
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
 
     if(cur_cpu == 0) {
         max_num = num;
@@ -155,7 +156,7 @@ int init_seg_tree(int num) {
  */
 static void update_tree(uint32_t index) {
 
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
 
     // updating tree unitl the root
     while (index != 0) {
@@ -191,7 +192,7 @@ static void update_tree(uint32_t index) {
  */
 uint32_t get_next() {
 
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
 
     // the free physical frame with the smallest index is the value of root
     uint32_t rv = seg_tree[cur_cpu][1];
@@ -217,7 +218,7 @@ uint32_t get_next() {
  */
 void put_back(uint32_t frame_index) {
 
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
 
     // mark the corresponding bit as freed
     uint32_t index = (frame_index >> 5) + size;
@@ -7,16 +7,16 @@
  */
 
 #include <smp_message.h>
-#include <simple_queue.h>
 #include <spinlock.h>
 #include <smp.h>
+#include <percpu.h>
 #include <malloc.h>
 #include <mptable.h>
 #include <control_block.h>
 #include <simics.h>
 
 /** @brief The message queues */
-simple_queue_t** msg_queues;
+msg_queue_t** msg_queues;
 
 /** @brief The locks that protects message queues */
 spinlock_t** msg_spinlocks;
@@ -54,7 +54,7 @@ int msg_init() {
 
     num_worker_cores = num_cpus - 1;
 
-    msg_queues = calloc(2*num_worker_cores, sizeof(simple_queue_t*));
+    msg_queues = calloc(2*num_worker_cores, sizeof(msg_queue_t*));
     if (msg_queues == NULL)
         return -1;
 
@@ -72,16 +72,17 @@ int msg_init() {
   */
 int init_ap_msg() {
 
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
 
     // Inq and outq
-    simple_queue_t *inq = malloc(sizeof(simple_queue_t));
+    msg_queue_t *inq = malloc(sizeof(msg_queue_t));
     if(inq == NULL) return -1;
 
-    simple_queue_t *outq = malloc(sizeof(simple_queue_t));
+    msg_queue_t *outq = malloc(sizeof(msg_queue_t));
     if(outq == NULL) return -1;
 
-    if(simple_queue_init(inq) < 0 || simple_queue_init(outq) < 0) return -1;
+    Q_INIT_HEAD(inq);
+    Q_INIT_HEAD(outq);
 
     // Locks
     spinlock_t *inq_lock = malloc(sizeof(spinlock_t));
@@ -116,6 +117,19 @@ void msg_synchronize() {
     }
 }
 
+/** @brief Dequeue the message at the head of a message queue
+ *
+ *  @param queue The message queue
+ *
+ *  @return The message at the head of the queue; NULL if the queue is empty
+ */
+msg_t* dequeue_msg(msg_queue_t* queue) {
+    msg_t* msg = Q_GET_FRONT(queue);
+    if (msg != NULL)
+        Q_REMOVE(queue, msg, link);
+    return msg;
+}
+
 /** @brief Send message for a worker core
  *
  *  @msg The message to send
@@ -124,12 +138,12 @@ void msg_synchronize() {
  */
 void worker_send_msg(msg_t* msg) {
 
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
 
     int id = (cur_cpu - 1) * 2;
 
     spinlock_lock(msg_spinlocks[id], 0);
-    simple_queue_enqueue(msg_queues[id], &(msg->node));
+    Q_INSERT_TAIL(msg_queues[id], msg, link);
     spinlock_unlock(msg_spinlocks[id], 0);
 
 }
@@ -141,17 +155,13 @@ void worker_send_msg(msg_t* msg) {
  */
 msg_t* worker_recv_msg() {
 
-    int id = (smp_get_cpu() - 1) * 2 + 1;
+    int id = (percpu_get_cpu() - 1) * 2 + 1;
 
     spinlock_lock(msg_spinlocks[id], 0);
-    simple_node_t*  msg_node = simple_queue_dequeue(msg_queues[id]);
+    msg_t* msg = dequeue_msg(msg_queues[id]);
     spinlock_unlock(msg_spinlocks[id], 0);
 
-    if (msg_node == NULL)
-        return NULL;
-    else {
-        return (msg_t*)(msg_node->thr);
-    }
+    return msg;
 }
 
 /** @brief Send a message for the manager core
@@ -165,7 +175,7 @@ void manager_send_msg(msg_t* msg, int dest_cpu) {
 
     int id = (dest_cpu - 1) * 2 + 1;
     spinlock_lock(msg_spinlocks[id], 0);
-    simple_queue_enqueue(msg_queues[id], &(msg->node));
+    Q_INSERT_TAIL(msg_queues[id], msg, link);
     spinlock_unlock(msg_spinlocks[id], 0);
 }
 
@@ -176,20 +186,20 @@ void manager_send_msg(msg_t* msg, int dest_cpu) {
  */
 msg_t* manager_recv_msg() {
     int i = 0;
-    simple_node_t* msg_node = NULL;
+    msg_t* msg = NULL;
 
     while (1) {
         spinlock_lock(msg_spinlocks[i], 0);
-        msg_node = simple_queue_dequeue(msg_queues[i]);
+        msg = dequeue_msg(msg_queues[i]);
         spinlock_unlock(msg_spinlocks[i], 0);
 
-        if (msg_node != NULL)
+        if (msg != NULL)
             break;
 
         i = (i + 2) % (2*num_worker_cores);
     }
 
-    return msg_node->thr;
+    return msg;
 }
 
 /** @brief Get the thread corresponding to the message
@@ -201,7 +211,7 @@ msg_t* manager_recv_msg() {
  *  @return The thread to schedule if message isn't NULL; NULL otherwise
  */
 void* get_thr_from_msg_queue() {
-    if (smp_get_cpu() == 0)
+    if (percpu_get_cpu() == 0)
         return NULL;
 
     msg_t* msg = worker_recv_msg();
@@ -223,7 +233,7 @@ void* get_thr_from_msg_queue() {
             // the same as the idle_task of the core is visiting to avoid memory
             // copying of page tables accross cores
             new_thr = (tcb_t*)msg->req_thr;
-            new_thr->pcb = idle_thr[smp_get_cpu()]->pcb;
+            new_thr->pcb = idle_thr[percpu_get_cpu()]->pcb;
             return new_thr;
         case HALT:
             // the manager core sends HALT message, should halt...
@@ -53,7 +53,7 @@ static char *reading_buf;
 static spinlock_t reading_lock;
 
 /** @brief A queue for threads requesting readline() */
-static simple_queue_t readline_queue;
+static msg_queue_t readline_queue;
 
 /** @brief Initialize data structure for print() syscall */
 int smp_syscall_print_init() {
@@ -70,8 +70,7 @@ int smp_syscall_read_init() {
     if (spinlock_init(&reading_lock) < 0)
         return -1;
 
-    if(simple_queue_init(&readline_queue) < 0)
-        return -1;
+    Q_INIT_HEAD(&readline_queue);
 
     return 0;   
 }
@@ -102,7 +101,7 @@ void smp_syscall_readline(msg_t *msg) {
     // keyboard interrupt during checking
     spinlock_lock(&reading_lock, 1);
     if(has_read_waiting_thr()) {
-        simple_queue_enqueue(&readline_queue, &(msg->node));
+        Q_INSERT_TAIL(&readline_queue, msg, link);
         spinlock_unlock(&reading_lock, 1);
         return;
     }
@@ -186,10 +185,8 @@ void* resume_reading_thr(char ch) {
         tcb_t* rv = read_waiting_thr;
 
         // Serve next readline request if any
-        simple_node_t *readline_node = 
-                simple_queue_dequeue(&readline_queue);
-        if(readline_node != NULL) {
-            msg_t* next_msg = (msg_t *)(readline_node->thr);
+        msg_t* next_msg = dequeue_msg(&readline_queue);
+        if(next_msg != NULL) {
             int len = next_msg->data.readline_data.len;
             char *kernel_buf = next_msg->data.readline_data.kernel_buf;
             reading_count = 0;
@@ -19,13 +19,18 @@
 #include <syscall_errors.h>
 
 /** @brief The struct to store exit status for a task */
-typedef struct {
+typedef struct exit_status_t {
+    /** @brief Link in the parent's child_exit_status_list */
+    Q_NEW_LINK(exit_status_t) link;
     /** @brief The vanished task's pid */
     int pid;
     /** @brief The vanished task's exit status */
     int status;
 } exit_status_t;
 
+/** @brief Queue of exit status */
+Q_NEW_HEAD(exit_status_queue_t, exit_status_t);
+
 /** @brief Data structure for wait() syscall. Each task (pcb) has one if 
  *        this struct */
 typedef struct {
@@ -33,8 +38,11 @@ typedef struct {
     int num_alive;
     /** @brief The number of zombie child tasks */
     int num_zombie;
-    /** @brief A queue for threads that invoke wait() to block on */
-    simple_queue_t wait_queue;
+    /** @brief A queue for messages of threads that invoke wait() to block 
+     *         on */
+    msg_queue_t wait_queue;
+    /** @brief The number of messages in wait_queue */
+    int num_waiting;
     /** @brief Pcb level Lock */
     mutex_t lock;
 } task_wait_t;
@@ -43,15 +51,12 @@ typedef struct {
  *         should have a such of data structure on the manager core */
 typedef struct {
     /** @brief Child tasks exit status list. When a child task dies, it will
-     *  put its exit_status_node to the parent's child_exit_status_list */
-    simple_queue_t child_exit_status_list;
-
-    /** @brief Exit status of the task */
-    exit_status_t *exit_status;
+     *  put its exit_status to the parent's child_exit_status_list */
+    exit_status_queue_t child_exit_status_list;
 
-    /** @brief Exit status node that will be inserted to parent task's
+    /** @brief Exit status of the task, it will be inserted to parent task's
      *         child_exit_status_list when the task dies */
-    simple_node_t *exit_status_node;
+    exit_status_t *exit_status;
 
     /** @brief Data structure for wait() syscall */
     task_wait_t task_wait_struct;
@@ -67,6 +72,10 @@ static int create_pcb_vanish_wait_struct(int pid);
 
 static void free_pcb_vanish_wait_struct(pcb_vanish_wait_t* pcb);
 
+static exit_status_t *dequeue_exit_status(exit_status_queue_t *queue);
+
+static void send_wait_response(msg_t *wait_msg, exit_status_t *es);
+
 
 /** @brief The initial size of hash table to stroe pid to pcb map,
  *         pick a prime number */
@@ -305,30 +314,22 @@ void smp_syscall_vanish(msg_t* msg) {
 
     // Put exit_status into parent's child exit status list 
     this_task->exit_status->status = msg->data.vanish_data.status;
-    simple_queue_enqueue(&parent_task->child_exit_status_list, 
-                                               this_task->exit_status_node);
+    Q_INSERT_TAIL(&parent_task->child_exit_status_list, 
+                                            this_task->exit_status, link);
 
     task_wait->num_zombie++;
     task_wait->num_alive--;
 
     // Make runnable a parent task's thread that is blocked on wait() if any
-    simple_node_t* wait_node = simple_queue_dequeue(&task_wait->wait_queue);
-    if(wait_node != NULL) {
+    msg_t* wait_msg = dequeue_msg(&task_wait->wait_queue);
+    if(wait_msg != NULL) {
+        task_wait->num_waiting--;
         task_wait->num_zombie--;
-        simple_node_t *exit_status_node = 
-            simple_queue_dequeue(&parent_task->child_exit_status_list);
+        exit_status_t *es = 
+            dequeue_exit_status(&parent_task->child_exit_status_list);
         mutex_unlock(&task_wait->lock);
 
-        exit_status_t *es = (exit_status_t*)(exit_status_node->thr);
-
-        msg_t* wait_msg = (msg_t *)(wait_node->thr);
-        wait_msg->type = WAIT_RESPONSE;
-        wait_msg->data.wait_response_data.pid = es->pid;
-        wait_msg->data.wait_response_data.status = es->status;
-        free(es);
-        free(exit_status_node);
-
-        manager_send_msg(wait_msg, wait_msg->req_cpu);
+        send_wait_response(wait_msg, es);
 
     } else {
         mutex_unlock(&task_wait->lock);
@@ -359,34 +360,25 @@ void smp_syscall_vanish(msg_t* msg) {
 
     // Put children tasks' exit_status into init task's child exit status 
     // list
-    simple_node_t* node;
+    exit_status_t *es;
     int has_unreaped_child = 0;
-    while((node = simple_queue_dequeue(
+    while((es = dequeue_exit_status(
                     &this_task->child_exit_status_list)) != NULL) {
         has_unreaped_child = 1;
-        simple_queue_enqueue(&init_task->child_exit_status_list, node);
+        Q_INSERT_TAIL(&init_task->child_exit_status_list, es, link);
         init_task_wait->num_zombie++;
     }
 
     if (has_unreaped_child) {
         // Make runnable init task
-        wait_node = simple_queue_dequeue(&init_task_wait->wait_queue);
-        if(wait_node != NULL) {
+        wait_msg = dequeue_msg(&init_task_wait->wait_queue);
+        if(wait_msg != NULL) {
+            init_task_wait->num_waiting--;
             init_task_wait->num_zombie--;
-            simple_node_t *exit_status_node = 
-                simple_queue_dequeue(&init_task->child_exit_status_list);
+            es = dequeue_exit_status(&init_task->child_exit_status_list);
             mutex_unlock(&init_task_wait->lock);
 
-            exit_status_t *es = (exit_status_t*)(exit_status_node->thr);
-
-            msg_t* wait_msg = (msg_t *)(wait_node->thr);
-            wait_msg->type = WAIT_RESPONSE;
-            wait_msg->data.wait_response_data.pid = es->pid;
-            wait_msg->data.wait_response_data.status = es->status;
-            free(es);
-            free(exit_status_node);
-
-            manager_send_msg(wait_msg, wait_msg->req_cpu);
+            send_wait_response(wait_msg, es);
         } else
             mutex_unlock(&init_task_wait->lock);
     } else
@@ -422,7 +414,7 @@ void smp_syscall_wait(msg_t* msg) {
     mutex_lock(&wait->lock);
     // check if can reap
     if (wait->num_zombie == 0 && 
-            (wait->num_alive == simple_queue_size(&wait->wait_queue))) {
+            (wait->num_alive == wait->num_waiting)) {
         // impossible to reap, return error
         mutex_unlock(&wait->lock);
 
@@ -432,28 +424,53 @@ void smp_syscall_wait(msg_t* msg) {
     } else if (wait->num_zombie == 0) {
         // have alive task (potential zombie), need to block. Enqueue the
         // message to the tail of queue to wait
-        simple_queue_enqueue(&wait->wait_queue, &msg->node);
+        Q_INSERT_TAIL(&wait->wait_queue, msg, link);
+        wait->num_waiting++;
         mutex_unlock(&wait->lock);
     } else {
         // have zombie task, can reap directly
         wait->num_zombie--;
-        simple_node_t *exit_status_node = 
-            simple_queue_dequeue(&pcb->child_exit_status_list);
+        exit_status_t *es = dequeue_exit_status(&pcb->child_exit_status_list);
         mutex_unlock(&wait->lock);
 
-        exit_status_t *es = (exit_status_t*)(exit_status_node->thr);
-
-        msg->type = WAIT_RESPONSE;
-        msg->data.wait_response_data.pid = es->pid;
-        msg->data.wait_response_data.status = es->status;
-        free(es);
-        free(exit_status_node);
-
-        manager_send_msg(msg, msg->req_cpu);
+        send_wait_response(msg, es);
     }
     
 }
 
+/** @brief Dequeue the exit status at the head of a child exit status list
+  *
+  * @param queue The child exit status list
+  *
+  * @return The exit status at the head of the list; NULL if it is empty
+  *
+  */
+static exit_status_t *dequeue_exit_status(exit_status_queue_t *queue) {
+    exit_status_t *es = Q_GET_FRONT(queue);
+    if (es != NULL)
+        Q_REMOVE(queue, es, link);
+    return es;
+}
+
+/** @brief Reply a wait() request with a reaped exit status
+  *
+  * The exit status is freed after its content is copied to the message.
+  *
+  * @param wait_msg The message of the thread that invokes wait()
+  * @param es The exit status of the reaped child task
+  *
+  * @return void
+  *
+  */
+static void send_wait_response(msg_t *wait_msg, exit_status_t *es) {
+    wait_msg->type = WAIT_RESPONSE;
+    wait_msg->data.wait_response_data.pid = es->pid;
+    wait_msg->data.wait_response_data.status = es->status;
+    free(es);
+
+    manager_send_msg(wait_msg, wait_msg->req_cpu);
+}
+
 
 /** @brief Create the vanish wait struct for a task
   *
@@ -485,38 +502,13 @@ static int create_pcb_vanish_wait_struct(int pid) {
     // Initially exit status is 0
     process->exit_status->status = 0;
 
-    process->exit_status_node = malloc(sizeof(simple_node_t));
-    if (process->exit_status_node == NULL) {
-        // out of memory
-        ht_remove_task(pid);
-        free(process->exit_status);
-        free(process);
-        return -1;
-    }
-    process->exit_status_node->thr = (void*)process->exit_status;
-
-    if(simple_queue_init(&process->child_exit_status_list) < 0) {
-        free(process->exit_status_node);
-        ht_remove_task(pid);
-        free(process->exit_status);
-        free(process);
-        return -1;
-    }
+    Q_INIT_HEAD(&process->child_exit_status_list);
 
     // Initialize task wait struct
     task_wait_t *task_wait = &process->task_wait_struct;
-    if(simple_queue_init(&task_wait->wait_queue) < 0) {
-        simple_queue_destroy(&process->child_exit_status_list);
-        free(process->exit_status_node);
-        ht_remove_task(pid);
-        free(process->exit_status);
-        free(process);
-        return -1;
-    }
+    Q_INIT_HEAD(&task_wait->wait_queue);
+    task_wait->num_waiting = 0;
     if(mutex_init(&task_wait->lock) < 0) {
-        simple_queue_destroy(&task_wait->wait_queue);
-        simple_queue_destroy(&process->child_exit_status_list);
-        free(process->exit_status_node);
         ht_remove_task(pid);
         free(process->exit_status);
         free(process);
@@ -539,7 +531,5 @@ static int create_pcb_vanish_wait_struct(int pid) {
   */
 static void free_pcb_vanish_wait_struct(pcb_vanish_wait_t* pcb) {
     mutex_destroy(&pcb->task_wait_struct.lock);
-    simple_queue_destroy(&pcb->task_wait_struct.wait_queue);
-    simple_queue_destroy(&pcb->child_exit_status_list);
     free(pcb);
 }
\ No newline at end of file
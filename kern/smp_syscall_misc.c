@@ -8,6 +8,7 @@
 
 #include <malloc.h>
 #include <smp_message.h>
+#include <smp.h>
 #include <simics.h>
 
 /** @brief Number of worker cores */
@@ -30,7 +31,8 @@ extern void asm_hlt(void);
   */
 void smp_syscall_halt(msg_t *msg) {
     
-    msg_t msgs[num_worker_cores];
+    // halt happens once, keep the messages off the kernel stack
+    static msg_t msgs[MAX_CPUS];
 
     // broadcast HALT to all cores
     int i = 0;
@@ -38,7 +40,6 @@ void smp_syscall_halt(msg_t *msg) {
         msgs[i].req_thr = msg->req_thr;
         msgs[i].req_cpu = msg->req_cpu;
         msgs[i].type = HALT;
-        msgs[i].node.thr = &msgs[i];
         manager_send_msg(&msgs[i], i+1);
     }
 
@@ -32,6 +32,7 @@
 #include <asm.h>
 #include <asm_atomic.h>
 #include <smp.h>
+#include <percpu.h>
 
 /** @brief Init spin lock
  *  
@@ -55,7 +56,7 @@ void spinlock_lock(spinlock_t* lock, int is_disable_interrupt) {
     if (is_disable_interrupt)
         disable_interrupts();
 
-    int cpu_id = (smp_get_cpu() == 0) ? 0 : 1;
+    int cpu_id = (percpu_get_cpu() == 0) ? 0 : 1;
 
     lock->waiting[cpu_id] = 1;
 
@@ -72,7 +73,7 @@ void spinlock_lock(spinlock_t* lock, int is_disable_interrupt) {
  *  @return void
  */
 void spinlock_unlock(spinlock_t* lock, int is_enable_interrupt) {
-    int cpu_id = (smp_get_cpu() == 0) ? 0 : 1;
+    int cpu_id = (percpu_get_cpu() == 0) ? 0 : 1;
 
     if (lock->waiting[1-cpu_id])
         lock->waiting[1-cpu_id] = 0;
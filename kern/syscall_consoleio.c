@@ -20,10 +20,10 @@
 #include <syscall_errors.h>
 
 #include <smp.h>
+#include <percpu.h>
 
-/** @brief At most half of the kernel stack can be used as buffer for 
- *         readline() */
-#define MAX_READLINE_BUF (K_STACK_SIZE>>1)
+/** @brief Maximum size of the buffer of readline() */
+#define MAX_READLINE_BUF 4096
 
 
 /** @brief System call handler for print()
@@ -69,7 +69,7 @@ int print_syscall_handler(int len, char *buf, int is_kernel_call) {
 
     // Construct message
     this_thr->my_msg->req_thr = this_thr;
-    this_thr->my_msg->req_cpu = smp_get_cpu();
+    this_thr->my_msg->req_cpu = percpu_get_cpu();
     this_thr->my_msg->type = PRINT;
     this_thr->my_msg->data.print_data.len = len;
     this_thr->my_msg->data.print_data.buf = kernel_buf;
@@ -134,7 +134,7 @@ int readline_syscall_handler(int len, char *buf) {
 
     // Construct message
     this_thr->my_msg->req_thr = this_thr;
-    this_thr->my_msg->req_cpu = smp_get_cpu();
+    this_thr->my_msg->req_cpu = percpu_get_cpu();
     this_thr->my_msg->type = READLINE;
     this_thr->my_msg->data.readline_data.kernel_buf = kernel_buf;
     this_thr->my_msg->data.readline_data.len = len;
@@ -164,7 +164,7 @@ int set_term_color_syscall_handler(int color) {
 
     // Construct message
     this_thr->my_msg->req_thr = this_thr;
-    this_thr->my_msg->req_cpu = smp_get_cpu();
+    this_thr->my_msg->req_cpu = percpu_get_cpu();
     this_thr->my_msg->type = SET_TERM_COLOR;
     this_thr->my_msg->data.set_term_color_data.color = color;
 
@@ -189,7 +189,7 @@ int set_cursor_pos_syscall_handler(int row, int col) {
 
     // Construct message
     this_thr->my_msg->req_thr = this_thr;
-    this_thr->my_msg->req_cpu = smp_get_cpu();
+    this_thr->my_msg->req_cpu = percpu_get_cpu();
     this_thr->my_msg->type = SET_CURSOR_POS;
     this_thr->my_msg->data.set_cursor_pos_data.row = row;
     this_thr->my_msg->data.set_cursor_pos_data.col = col;
@@ -225,7 +225,7 @@ int get_cursor_pos_syscall_handler(int *row, int *col) {
 
     // Construct message
     this_thr->my_msg->req_thr = this_thr;
-    this_thr->my_msg->req_cpu = smp_get_cpu();
+    this_thr->my_msg->req_cpu = percpu_get_cpu();
     this_thr->my_msg->type = GET_CURSOR_POS;
 
     context_switch(OP_SEND_MSG, 0);
@@ -26,9 +26,12 @@
 #include <syscall_errors.h>
 #include <stdio.h>
 #include <smp.h>
+#include <percpu.h>
+#include <gdt.h>
 
-/** @brief At most half of the kernel stack to be used as buffer of exec() */
-#define MAX_EXEC_BUF (K_STACK_SIZE>>1)
+/** @brief Size of the buffer that arguments of exec() are copied to. It is
+ *         allocated from the kernel heap, the kernel stack is too small */
+#define MAX_EXEC_BUF 4096
 
 /** @brief At most 128 bytes per argument of exec() */
 #define EXEC_MAX_ARG_SIZE   128
@@ -36,12 +39,6 @@
 /** @brief The maxinum number of arguments of exec() */
 #define EXEC_MAX_ARGC (MAX_EXEC_BUF/EXEC_MAX_ARG_SIZE-1)
 
-/** @brief A list that stores the zombie thread to be freed  */
-static simple_queue_t* zombie_lists[MAX_CPUS];
-
-/** @brief The lock for the zombie list */
-static mutex_t* zombie_list_locks[MAX_CPUS];
-
 
 /** @brief System call handler for fork()
  *
@@ -102,6 +99,9 @@ int fork_create_process(tcb_t* new_thr, tcb_t* old_thr) {
                 sizeof(swexn_t));
     }
     
+    // the only thread of the new task has the same TLS as the old thread
+    new_thr->tls_base = old_thr->tls_base;
+
     // create new process
     if (tcb_create_process_only(new_thr, old_thr, 
                                         new_page_table_base) == NULL) {
@@ -248,9 +248,12 @@ int exec_syscall_handler(char* execname, char **argvec) {
     // copy argv to kernel memory
     char *argv[argc];
 
-    char tmp_argv[argc][EXEC_MAX_ARG_SIZE];
+    char *tmp_argv = malloc(argc * EXEC_MAX_ARG_SIZE);
+    if(tmp_argv == NULL) {
+        return ENOMEM;
+    }
     for(i = 0; i < argc; i++) {
-        argv[i] = tmp_argv[i];
+        argv[i] = tmp_argv + i * EXEC_MAX_ARG_SIZE;
         memcpy(argv[i], argvec[i], strlen(argvec[i])+1);
     }
     // Finish copying
@@ -264,6 +267,7 @@ int exec_syscall_handler(char* execname, char **argvec) {
     // we can recover to old address space
     uint32_t new_pd = create_pd();
     if(new_pd == ERROR_MALLOC_LIB) {
+        free(tmp_argv);
         return ENOMEM;
     }
     this_thr->pcb->page_table_base = new_pd;
@@ -271,9 +275,13 @@ int exec_syscall_handler(char* execname, char **argvec) {
 
     // load task
     void *my_program, *usr_esp;
-    int rv;
-    if ((rv = loadTask(my_execname, argc, (const char**)argv, &usr_esp, 
-                    &my_program)) < 0) {
+    int rv = loadTask(my_execname, argc, (const char**)argv, &usr_esp, 
+                      &my_program);
+
+    // the arguments are on the new user stack now
+    free(tmp_argv);
+
+    if (rv < 0) {
 
         // load task failed, reset to old page table, free new page table
         this_thr->pcb->page_table_base = old_pd;
@@ -298,6 +306,10 @@ int exec_syscall_handler(char* execname, char **argvec) {
         this_thr->swexn_struct = NULL;
     }
 
+    // Clear TLS, the new program loads %gs with SEGSEL_USER_DS anyway
+    this_thr->tls_base = 0;
+    gdt_set_tls_base(0);
+
     // load kernel stack, jump to new program
     load_kernel_stack(this_thr->k_stack_esp, usr_esp, my_program, 0);
 
@@ -337,7 +349,7 @@ int set_init_pcb(pcb_t *init_pcb) {
     // construct message
     tcb_t *this_thr = tcb_get_entry((void*)asm_get_esp());
     this_thr->my_msg->req_thr = this_thr;
-    this_thr->my_msg->req_cpu = smp_get_cpu();
+    this_thr->my_msg->req_cpu = percpu_get_cpu();
     this_thr->my_msg->type = SET_INIT_PCB;
     this_thr->my_msg->data.set_init_pcb_data.pid = init_pcb->pid;
     context_switch(OP_SEND_MSG, 0);
@@ -352,9 +364,12 @@ int set_init_pcb(pcb_t *init_pcb) {
  *
  *  @return On success, return the next zombie thread, on error return NULL
  */
-simple_node_t* get_next_zombie() {
-    simple_node_t* node = simple_queue_dequeue(zombie_lists[smp_get_cpu()]);
-    return node;
+tcb_t* get_next_zombie() {
+    thr_queue_t* list = &percpu_self()->zombie_list;
+    tcb_t* thr = Q_GET_FRONT(list);
+    if (thr != NULL)
+        Q_REMOVE(list, thr, wait_link);
+    return thr;
 }
 
 /** @brief Get the lock for the zombie list
@@ -362,19 +377,18 @@ simple_node_t* get_next_zombie() {
  *  @return Lock for the zombie list
  */
 mutex_t *get_zombie_list_lock() {
-    return zombie_list_locks[smp_get_cpu()];
+    return &percpu_self()->zombie_list_lock;
 }
 
 /** @brief Put next zombie in the thread zombie list
  *
- * @param node The node describing the zombie thread
+ * @param thr The zombie thread
  *
- * @return 0 on success; -1 on error
+ * @return void
  *
  */
-int put_next_zombie(simple_node_t* node) {
-    int rv = simple_queue_enqueue(zombie_lists[smp_get_cpu()], node);
-    return rv;
+void put_next_zombie(tcb_t* thr) {
+    Q_INSERT_TAIL(&percpu_self()->zombie_list, thr, wait_link);
 }
 
 /** @brief Initialize vanish syscall
@@ -383,22 +397,13 @@ int put_next_zombie(simple_node_t* node) {
  *
  */
 int syscall_vanish_init() {
-    zombie_lists[smp_get_cpu()] = malloc(sizeof(simple_queue_t));
-    if (zombie_lists[smp_get_cpu()] == NULL)
-        return -1;
+    percpu_t *percpu = percpu_self();
 
-    zombie_list_locks[smp_get_cpu()] = malloc(sizeof(mutex_t));
-    if (zombie_list_locks[smp_get_cpu()] == NULL)
-        return -1;
+    Q_INIT_HEAD(&percpu->zombie_list);
 
-    if(simple_queue_init(zombie_lists[smp_get_cpu()]) < 0)
+    if (mutex_init(&percpu->zombie_list_lock) < 0)
         return -1;
 
-
-    if (mutex_init(zombie_list_locks[smp_get_cpu()]) < 0)
-        return -1;
-
-
     return 0;
 }
 
@@ -452,7 +457,7 @@ void vanish_syscall_handler(int is_kernel_kill) {
 
         // construct message
         this_thr->my_msg->req_thr = this_thr;
-        this_thr->my_msg->req_cpu = smp_get_cpu();
+        this_thr->my_msg->req_cpu = percpu_get_cpu();
         this_thr->my_msg->type = VANISH;
         this_thr->my_msg->data.vanish_data.pid = this_task->pid;
         this_thr->my_msg->data.vanish_data.ppid = this_task->ppid;
@@ -473,22 +478,18 @@ void vanish_syscall_handler(int is_kernel_kill) {
 
     // send this thread back to the cpu who malloc() it
     this_thr->my_msg->req_thr = this_thr;
-    this_thr->my_msg->req_cpu = smp_get_cpu();
+    this_thr->my_msg->req_cpu = percpu_get_cpu();
     this_thr->my_msg->type = VANISH_BACK;
     this_thr->my_msg->data.vanish_back_data.ori_cpu = this_thr->ori_cpu;
     context_switch(OP_SEND_MSG, 0);
 
     // now this thread is running on the cpu who malloc() it
 
-    // Add self to system wide zombie list. Note that stack space of 
-    // vanish_syscall_handler() is used for simple_node. Because this stack 
-    // will not be destroied until this thread is freed by other threads. 
-    simple_node_t node;
-    node.thr = this_thr;
-
-    mutex_lock(zombie_list_locks[smp_get_cpu()]);
-    put_next_zombie(&node);
-    mutex_unlock(zombie_list_locks[smp_get_cpu()]);
+    // Add self to zombie list of this core. The tcb will not be destroied
+    // until this thread is freed by other threads. 
+    mutex_lock(&percpu_self()->zombie_list_lock);
+    put_next_zombie(this_thr);
+    mutex_unlock(&percpu_self()->zombie_list_lock);
 
     context_switch(OP_BLOCK, 0);
 
@@ -538,7 +539,7 @@ int wait_syscall_handler(int *status_ptr) {
 
     // construct message
     this_thr->my_msg->req_thr = this_thr;
-    this_thr->my_msg->req_cpu = smp_get_cpu();
+    this_thr->my_msg->req_cpu = percpu_get_cpu();
     this_thr->my_msg->type = WAIT;
     this_thr->my_msg->data.wait_data.pid = this_thr->pcb->pid;
 
@@ -16,6 +16,7 @@
 #include <control_block.h>
 #include <asm_helper.h>
 #include <smp.h>
+#include <percpu.h>
 
 /** @brief The "." file that contains a list of the files that readfile()
   * can access.
@@ -45,7 +46,7 @@ void halt_syscall_handler() {
     tcb_t *this_thr = tcb_get_entry((void*)asm_get_esp());
     msg_t* msg = this_thr->my_msg;
     msg->req_thr = this_thr;
-    msg->req_cpu = smp_get_cpu();
+    msg->req_cpu = percpu_get_cpu();
     msg->type = HALT;
 
     context_switch(OP_SEND_MSG, 0);
@@ -12,7 +12,7 @@
 #include <control_block.h>
 #include <asm_helper.h>
 #include <simics.h>
-#include <priority_queue.h>
+#include <thr_queue.h>
 #include <spinlock.h>
 #include <timer_driver.h>
 #include <context_switcher.h>
@@ -20,43 +20,15 @@
 #include <vm.h>
 #include <exception_handler.h>
 #include <syscall_errors.h>
+#include <syscall_int.h>
+#include <string.h>
 
 #include <smp.h>
+#include <percpu.h>
+#include <gdt.h>
+#include <common_kern.h>
 #include <scheduler.h>
 
- static int sleep_queue_compare(void* this, void* that);
-
-/** @brief For sleep() syscall.
- *         The data field for node of sleep priority queue */
-typedef struct {
-    /** @brief Num of ticks */
-    unsigned int ticks;
-    /** @brief Thread tcb */
-    tcb_t *thr;
-} sleep_queue_data_t;
-
-/** @brief For sleep() syscall.
- *         The priority queue for sleep(). All threads that are blocked on
- *         sleep() will be stored in this queue. They are ordered by their
- *         time to wake up. The thread that should be wakened up in the 
- *         clostest future is at the head of the priority queue */
-static pri_queue *sleep_queue[MAX_CPUS];
-
-/** @brief For sleep() syscall.
- *         A spinlock to avoid timer interrupt when manipulating data structure
- *         of sleep() */
-static spinlock_t *sleep_lock[MAX_CPUS];
-
-/** @brief For deschedule() and make_runnable() syscalls.
- *         All threads that are blocked because of deschedule() will be stored 
- *         in this queue. make_runnable() will try to find the thread to be 
- *         made runable in this queue */
-static simple_queue_t *deschedule_queues[MAX_CPUS];
-
-/** @brief For deschedule() and make_runnable() syscalls.
- *         Mutex lock to protect deschedule_queue */
-static mutex_t *deschedule_mutexs[MAX_CPUS];
-
 /** @brief Initialize data structure for sleep() syscall 
  *
  *  @return 0 on success; -1 on error
@@ -64,19 +36,11 @@ static mutex_t *deschedule_mutexs[MAX_CPUS];
  */
 int syscall_sleep_init() {
 
-    int cur_cpu = smp_get_cpu();
-
-    sleep_queue[cur_cpu] = malloc(sizeof(pri_queue));
-    if(sleep_queue[cur_cpu] == NULL)
-        return -1;
+    percpu_t *percpu = percpu_self();
 
-    if(pri_queue_init(sleep_queue[cur_cpu], sleep_queue_compare) < 0)
-        return -1;
+    Q_INIT_HEAD(&percpu->sleep_queue);
 
-    sleep_lock[cur_cpu] = malloc(sizeof(spinlock_t));
-    if(sleep_lock[cur_cpu] == NULL) 
-        return -1;
-    if(spinlock_init(sleep_lock[cur_cpu])) 
+    if(spinlock_init(&percpu->sleep_lock)) 
         return -1;
 
     return 0;
@@ -88,20 +52,11 @@ int syscall_sleep_init() {
  *  @return 0 on success; -1 on error
  */
 int syscall_deschedule_init() {
-    int cur_cpu = smp_get_cpu();
-
-    deschedule_queues[cur_cpu] = malloc(sizeof(simple_queue_t));
-    if (deschedule_queues[cur_cpu] == NULL)
-        return -1;
-
-    deschedule_mutexs[cur_cpu] = malloc(sizeof(mutex_t));
-    if (deschedule_mutexs[cur_cpu] == NULL)
-        return -1;
+    percpu_t *percpu = percpu_self();
 
-    if (simple_queue_init(deschedule_queues[cur_cpu]) < 0)
-        return -1;
+    Q_INIT_HEAD(&percpu->deschedule_queue);
 
-    if (mutex_init(deschedule_mutexs[cur_cpu]) < 0)
+    if (mutex_init(&percpu->deschedule_mutex) < 0)
         return -1;
 
     return 0;
@@ -128,6 +83,27 @@ unsigned int get_ticks_syscall_handler() {
     return timer_get_ticks();
 }
 
+/** @brief System call handler for get_time_ns()
+ *
+ *  This function will be invoked by get_time_ns_wrapper().
+ *
+ *  @param ns Where to store the number of nanoseconds since system boot, 
+ *            which never goes backwards, on any core
+ *
+ *  @return 0 on success; an integer error code less than zero if ns is not
+ *          a valid writable address
+ */
+int get_time_ns_syscall_handler(uint64_t *ns) {
+    int is_check_null = 0;
+    int need_writable = 1;
+    if (check_mem_validness((char *)ns, sizeof(uint64_t), is_check_null, 
+                need_writable) < 0)
+        return EINVAL;
+
+    *ns = timer_get_time_ns();
+    return 0;
+}
+
 /** @brief System call handler for sleep()
  *
  *  This function will be invoked by sleep_wrapper().
@@ -146,73 +122,57 @@ int sleep_syscall_handler(int ticks) {
     else if (ticks == 0)
         return 0;
 
-    int cur_cpu = smp_get_cpu();
+    percpu_t *percpu = percpu_self();
+
+    tcb_t *this_thr = tcb_get_entry((void*)asm_get_esp());
 
     // lock the spinlock to avoid timer interrupt when manipulating 
-    // priority queue of sleep()
-    spinlock_lock(sleep_lock[cur_cpu], 1);
+    // queue of sleep()
+    spinlock_lock(&percpu->sleep_lock, 1);
 
-    sleep_queue_data_t my_data;
     // calculate its time to wake up
-    my_data.ticks = (unsigned int)ticks + timer_get_ticks();
-    my_data.thr = tcb_get_entry((void*)asm_get_esp());
-
-    // here stack space is used for node of queue. Because the stack of this 
-    // function will not be destroied before this thread wake up from sleep()
-    // and return, it is safe
-    pri_node_t my_node;
-    my_node.data = &my_data;
-    pri_queue_enqueue(sleep_queue[cur_cpu], &my_node);
+    this_thr->wakeup_ticks = (unsigned int)ticks + timer_get_ticks();
+
+    // keep the queue sorted by time to wake up, search from the tail because
+    // a newly sleeping thread is likely to wake up later than others. Threads
+    // with the same time to wake up are kept in FIFO order
+    thr_queue_t *queue = &percpu->sleep_queue;
+    tcb_t *prev = Q_GET_TAIL(queue);
+    while (prev != NULL && prev->wakeup_ticks > this_thr->wakeup_ticks)
+        prev = Q_GET_PREV(prev, wait_link);
+
+    if (prev == NULL)
+        Q_INSERT_FRONT(queue, this_thr, wait_link);
+    else
+        Q_INSERT_AFTER(queue, prev, this_thr, wait_link);
 
-    spinlock_unlock(sleep_lock[cur_cpu], 1);
+    spinlock_unlock(&percpu->sleep_lock, 1);
 
     context_switch(OP_BLOCK, 0);
 
     return 0;
 }
 
-/** @brief Comparision function for priority queue of sleep()
- *
- *  This function will compare two operands based on their time to wake up
- *
- *  @param this The first operand to compare
- *  @param that The second operand to compare
- *
- *  @return The comparision result
- */
-static int sleep_queue_compare(void* this, void* that) {
-    unsigned int t1 = ((sleep_queue_data_t*)this)->ticks;
-    unsigned int t2 = ((sleep_queue_data_t*)that)->ticks;
-
-    if (t1 > t2)
-        return 1;
-    else if (t1 < t2)
-        return -1;
-    else
-        return 0;
-}
-
 /** @brief Callback function that will be invoked by timer interrupt handler
  *
- *  This function will check if the thread at the head of the priority queue
+ *  This function will check if the thread at the head of the sorted queue
  *  of sleep() should be wakened up. This function is invoked by timer interrupt
  *  handler, so this function call will not be interrupted. It can manipulate 
- *  priority queue of sleep() safely.
+ *  queue of sleep() safely.
  *
  *  @param ticks The number of ticks passed to callback of timer
  *
- *  @return If the thread at the head of the priority queue should be wakened
+ *  @return If the thread at the head of the queue should be wakened
  *          up, return the thread. Otherwise return NULL. 
  */
 void* timer_callback(unsigned int ticks) {   
 
-    int cur_cpu = smp_get_cpu();
+    thr_queue_t *queue = &percpu_self()->sleep_queue;
 
-    pri_node_t* node = pri_queue_get_first(sleep_queue[cur_cpu]);
-    if (node && ((sleep_queue_data_t*)node->data)->ticks 
-            <= timer_get_ticks()) {
-        pri_queue_dequeue(sleep_queue[cur_cpu]);
-        return (void*)((sleep_queue_data_t*)node->data)->thr; 
+    tcb_t* thr = Q_GET_FRONT(queue);
+    if (thr && thr->wakeup_ticks <= timer_get_ticks()) {
+        Q_REMOVE(queue, thr, wait_link);
+        return (void*)thr;
     } else
         return NULL;
 }
@@ -250,11 +210,11 @@ int yield_syscall_handler(int tid) {
         // Construct message
         msg_t* msg = this_thr->my_msg;
         msg->req_thr = this_thr;
-        msg->req_cpu = smp_get_cpu();
+        msg->req_cpu = percpu_get_cpu();
         msg->type = YIELD;
         msg->data.yield_data.tid = tid;
         msg->data.yield_data.result = -1;
-        msg->data.yield_data.next_core = smp_get_cpu();
+        msg->data.yield_data.next_core = percpu_get_cpu();
 
         do {
             if (scheduler_is_exist_or_running(msg->data.yield_data.tid)) {
@@ -265,7 +225,7 @@ int yield_syscall_handler(int tid) {
             context_switch(OP_SEND_MSG, 0);
 
         } while (msg->data.yield_data.result < 0 && 
-                  smp_get_cpu() != msg->req_cpu);
+                  percpu_get_cpu() != msg->req_cpu);
 
         // set page table base back to its own
         this_thr->pcb = pcb;
@@ -288,9 +248,10 @@ int yield_syscall_handler(int tid) {
  */
 static int is_newureg_valid(ureg_t *ureg) {
 
-    // Check segment registers
+    // Check segment registers, %gs may also be the TLS segment
     if(ureg->ds != SEGSEL_USER_DS || ureg->es != SEGSEL_USER_DS 
-            || ureg->fs != SEGSEL_USER_DS || ureg->gs != SEGSEL_USER_DS
+            || ureg->fs != SEGSEL_USER_DS 
+            || (ureg->gs != SEGSEL_USER_DS && ureg->gs != SEGSEL_USER_TLS)
             || ureg->ss != SEGSEL_USER_DS || ureg->cs != SEGSEL_USER_CS) {
         return 0;
     }
@@ -442,20 +403,16 @@ int deschedule_syscall_handler(int *reject) {
     // using mutex to protect deschedule_queue, it also make sure examine the 
     // value of *reject and block the thread (at here it is done by put the 
     // thread in the deschedule_queue) is atomic with respect to make runnable()
-    mutex_lock(deschedule_mutexs[smp_get_cpu()]);
+    mutex_lock(&percpu_self()->deschedule_mutex);
     if (*reject) {
-        mutex_unlock(deschedule_mutexs[smp_get_cpu()]);
+        mutex_unlock(&percpu_self()->deschedule_mutex);
         return 0;
     }
-    simple_node_t node;
-    node.thr = tcb_get_entry((void*)asm_get_esp());
+    tcb_t *this_thr = tcb_get_entry((void*)asm_get_esp());
 
-    // enter the tail of deschedule_queue to wait, note that stack
-    // memory is used for node of queue. Because the stack of 
-    // deschedule_syscall_handler() will not be destroied until this 
-    // function return, so it is safe
-    simple_queue_enqueue(deschedule_queues[smp_get_cpu()], &node);
-    mutex_unlock(deschedule_mutexs[smp_get_cpu()]);
+    // enter the tail of deschedule_queue to wait
+    Q_INSERT_TAIL(&percpu_self()->deschedule_queue, this_thr, wait_link);
+    mutex_unlock(&percpu_self()->deschedule_mutex);
 
     context_switch(OP_BLOCK, 0);
     return 0;
@@ -484,20 +441,28 @@ int make_runnable_syscall_handler(int tid) {
     // Construct message
     msg_t* msg = this_thr->my_msg;
     msg->req_thr = this_thr;
-    msg->req_cpu = smp_get_cpu();
+    msg->req_cpu = percpu_get_cpu();
     msg->type = MAKE_RUNNABLE;
     msg->data.make_runnable_data.tid = tid;
     msg->data.make_runnable_data.result = -1;
-    msg->data.make_runnable_data.next_core = smp_get_cpu();
+    msg->data.make_runnable_data.next_core = percpu_get_cpu();
 
     do {
-        mutex_lock(deschedule_mutexs[smp_get_cpu()]);
-        simple_node_t* node = simple_queue_remove_tid(deschedule_queues[smp_get_cpu()], tid);
-        mutex_unlock(deschedule_mutexs[smp_get_cpu()]);
+        thr_queue_t *queue = &percpu_self()->deschedule_queue;
+        tcb_t *thr;
+
+        mutex_lock(&percpu_self()->deschedule_mutex);
+        Q_FOREACH(thr, queue, wait_link) {
+            if (thr->tid == tid) {
+                Q_REMOVE(queue, thr, wait_link);
+                break;
+            }
+        }
+        mutex_unlock(&percpu_self()->deschedule_mutex);
 
-        if (node != NULL) {
+        if (thr != NULL) {
             // find the descheduled thread, make it runnable
-            context_switch(OP_MAKE_RUNNABLE, (uint32_t)node->thr);
+            context_switch(OP_MAKE_RUNNABLE, (uint32_t)thr);
             msg->data.make_runnable_data.result = 0;
         }
 
@@ -505,7 +470,7 @@ int make_runnable_syscall_handler(int tid) {
         context_switch(OP_SEND_MSG, 0);
 
     } while (msg->data.make_runnable_data.result < 0 &&
-             smp_get_cpu() != msg->req_cpu);
+             percpu_get_cpu() != msg->req_cpu);
 
     
     // set page table base back to its own
@@ -519,3 +484,160 @@ int make_runnable_syscall_handler(int tid) {
 
 }
 
+/** @brief Make runnable the descheduled threads on this core whose tids are 
+ *         wanted and not made runnable yet
+ *
+ *  The deschedule queue of this core is scanned only once for all tids.
+ *
+ *  @param tids The tids of the threads to make runnable
+ *  @param results results[i] is negative if tids[i] has not been made 
+ *                 runnable, it is set to 0 if tids[i] is made runnable
+ *  @param n The number of tids
+ *
+ *  @return The number of threads made runnable
+ */
+static int make_runnable_local(int *tids, int *results, int n) {
+    thr_queue_t *queue = &percpu_self()->deschedule_queue;
+    thr_queue_t found;
+    Q_INIT_HEAD(&found);
+    int count = 0;
+
+    mutex_lock(&percpu_self()->deschedule_mutex);
+    tcb_t *thr = Q_GET_FRONT(queue);
+    while (thr != NULL) {
+        tcb_t *next = Q_GET_NEXT(thr, wait_link);
+        int i;
+        for (i = 0; i < n; i++) {
+            if (results[i] < 0 && tids[i] == thr->tid) {
+                results[i] = 0;
+                Q_REMOVE(queue, thr, wait_link);
+                Q_INSERT_TAIL(&found, thr, wait_link);
+                count++;
+                break;
+            }
+        }
+        thr = next;
+    }
+    mutex_unlock(&percpu_self()->deschedule_mutex);
+
+    // make them runnable after the deschedule queue is unlocked
+    while ((thr = Q_GET_FRONT(&found)) != NULL) {
+        Q_REMOVE(&found, thr, wait_link);
+        context_switch(OP_MAKE_RUNNABLE, (uint32_t)thr);
+    }
+
+    return count;
+}
+
+/** @brief System call handler for make_runnable_many()
+ *
+ *  This function will be invoked by make_runnable_many_wrapper().
+ *
+ *  Makes the deschedule()d threads with ID tids[0..n-1] runnable by the 
+ *  scheduler. Unlike calling make_runnable() n times, which may visit the 
+ *  deschedule queues of all cores n times, the deschedule queue of this core
+ *  (where descheduled threads of the same task are) is searched first for 
+ *  all tids at once, and the remaining tids are searched in a single round 
+ *  of visiting the other cores, one message per core.
+ *
+ *  @param tids The tids of the threads that will be made runnable. On return
+ *              tids[i] is replaced by the result for it, which is zero if 
+ *              the thread is made runnable, or an integer error code less 
+ *              than zero if it is not a thread that exists and is currently 
+ *              non-runnable due to a call to deschedule()
+ *  @param n The number of tids, at most MAKE_RUNNABLE_MANY_MAX
+ *
+ *  @return The number of threads made runnable on success; an integer error 
+ *          code less than zero if n is out of range or tids is not valid
+ */
+int make_runnable_many_syscall_handler(int *tids, int n) {
+    if (n <= 0 || n > MAKE_RUNNABLE_MANY_MAX)
+        return EINVAL;
+
+    // Check parameter
+    int is_check_null = 0;
+    int need_writable = 1;
+    if(check_mem_validness((char*)tids, n * sizeof(int), is_check_null,
+                need_writable) < 0) {
+        return EFAULT;
+    }
+    // Finish parameter check
+
+    // user memory is not accessible on other cores, so work on a copy. It is
+    // on the heap because it is too large for a kernel stack
+    int *ktids = malloc(2 * n * sizeof(int));
+    if (ktids == NULL)
+        return ENOMEM;
+    int *results = ktids + n;
+    memcpy(ktids, tids, n * sizeof(int));
+    int i;
+    for (i = 0; i < n; i++)
+        results[i] = ETHREAD;
+
+    int count = make_runnable_local(ktids, results, n);
+
+    if (count < n) {
+        // Hand over to manager core to visit other cores
+        tcb_t *this_thr = tcb_get_entry((void*)asm_get_esp());
+        pcb_t* pcb = this_thr->pcb;
+
+        // Construct message
+        msg_t* msg = this_thr->my_msg;
+        msg->req_thr = this_thr;
+        msg->req_cpu = percpu_get_cpu();
+        msg->type = MAKE_RUNNABLE;
+        msg->data.make_runnable_data.result = -1;
+        msg->data.make_runnable_data.next_core = percpu_get_cpu();
+
+        while (1) {
+            // go to the next core, or back to the original core if all
+            // cores are visited or all threads are made runnable
+            context_switch(OP_SEND_MSG, 0);
+            if (percpu_get_cpu() == msg->req_cpu)
+                break;
+
+            count += make_runnable_local(ktids, results, n);
+            if (count == n)
+                msg->data.make_runnable_data.result = 0;
+        }
+
+        // set page table base back to its own
+        this_thr->pcb = pcb;
+        set_cr3(this_thr->pcb->page_table_base);
+    }
+
+    memcpy(tids, results, n * sizeof(int));
+    free(ktids);
+
+    return count;
+}
+
+/** @brief System call handler for set_tls_base
+ *
+ *  This function will be invoked by set_tls_base_wrapper().
+ *
+ *  Sets the base of the user TLS segment of the invoking thread. On success
+ *  set_tls_base_wrapper() also loads %gs of the invoking thread with 
+ *  SEGSEL_USER_TLS, so that %gs:0 is the first word at base. The base is 
+ *  kept across context switches and inherited by the thread of a task 
+ *  created by fork(); a thread created by thread_fork() starts with base 0 
+ *  and exec() resets it to 0.
+ *
+ *  @param base The new TLS base, any user address
+ *
+ *  @return 0 on success; an integer error code less than zero if base is a
+ *          kernel address
+ */
+int set_tls_base_syscall_handler(uint32_t base) {
+    if (base < USER_MEM_START)
+        return EINVAL;
+
+    tcb_t *this_thr = tcb_get_entry((void*)asm_get_esp());
+
+    // tls_base is written first, so if a context switch comes in between,
+    // the descriptor is rewritten with the new base
+    this_thr->tls_base = base;
+    gdt_set_tls_base(base);
+
+    return 0;
+}
@@ -24,12 +24,20 @@
 #include <apic.h>
 #include <timer_driver.h>
 #include <syscall_inter.h>
+#include <asm_atomic.h>
 
 #include <smp.h>
+#include <percpu.h>
 
 /** @brief Frequency */
 #define FREQ 100
 
+/** @brief Nanoseconds per millisecond */
+#define NS_PER_MS 1000000ull
+
+/** @brief Length of the calibration, in PIC timer ticks */
+#define CAL_TICKS 10
+
 /** @brief A flag indicating if init_vm has finished */
 extern int finished_init_vm;
 
@@ -54,6 +62,16 @@ static unsigned int *apic_num_ticks[MAX_CPUS];
 /** @brief The total number of PIC timer interrupts that handler has caught */
 static unsigned int numTicks;
 
+/** @brief The TSC at the time we start calibrating, time 0 of get_time_ns() */
+static uint64_t start_tsc;
+
+/** @brief TSC cycles per millisecond, 0 before calibration */
+static uint64_t tsc_per_ms;
+
+/** @brief The largest time get_time_ns() has returned on any core, only 
+ *         accessed by asm_cmpxchg64() */
+static uint64_t last_time_ns;
+
 /** @brief Initialize timer device driver.
  *
  *  Calculate interrupt rate, configure timer mode and rate. Set callback
@@ -78,7 +96,7 @@ void init_timer_driver() {
  */
 void init_lapic_timer_driver() {
 
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
 
     apic_num_ticks[cur_cpu] = malloc(sizeof(unsigned int));
     if(apic_num_ticks[cur_cpu] == NULL) {
@@ -124,7 +142,7 @@ void init_lapic_timer_driver() {
 void apic_timer_interrupt_handler() {
 
     // Update ticks
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
     int ticks = ++(*apic_num_ticks[cur_cpu]);
 
     tcb_t* next_thr = (tcb_t*)timer_callback(ticks);
@@ -134,7 +152,10 @@ void apic_timer_interrupt_handler() {
 
     enable_interrupts();
 
-    if (tcb_is_stack_overflow((void*)asm_get_esp())) {
+    // Before the first context switch the core may still be on its boot
+    // stack, which is not the kernel stack of a thread
+    if (PERCPU_READ(cur_running_thr) != NULL && 
+        tcb_is_stack_overflow((void*)asm_get_esp())) {
         panic("thread's kernel stack overflow!");
     }
 
@@ -163,14 +184,16 @@ void pic_timer_interrupt_handler() {
 
         if(start_numTicks == 0) {
             start_numTicks = numTicks;
+            start_tsc = rdtsc();
 
             init_lapic_timer_driver();
-        } else if(numTicks == start_numTicks + 10) {
+        } else if(numTicks == start_numTicks + CAL_TICKS) {
             // The PIC is configured to generate an interrupt every 10ms,
             // So numTicks gets incremented every 10ms
             // Evaluate APIC frequency after 100ms
 
             uint32_t lapic_timer_cur = lapic_read(LAPIC_TIMER_CUR);
+            uint64_t tsc = rdtsc();
 
             // Stop lapic timer for the moment
             lapic_write(LAPIC_TIMER_INIT, 0);
@@ -182,7 +205,10 @@ void pic_timer_interrupt_handler() {
             // Given that the lapic divider value is 1, diff in 100ms divided 
             // by 10 is the desired lapic_timer_init value to generate 
             // interrupts every 10ms
-            lapic_timer_init = diff / 10;
+            lapic_timer_init = diff / CAL_TICKS;
+
+            // Likewise for the TSC, which counts cycles of the core
+            tsc_per_ms = (tsc - start_tsc) / (CAL_TICKS * 1000 / FREQ);
 
             // Disable PIC
             outb(TIMER_MODE_IO_PORT, TIMER_ONE_SHOT);
@@ -206,7 +232,40 @@ void pic_timer_interrupt_handler() {
   */
 unsigned int timer_get_ticks() {
 
-    int cur_cpu = smp_get_cpu();
+    int cur_cpu = percpu_get_cpu();
     return *apic_num_ticks[cur_cpu];
 }
 
+
+/** @brief Get the time since boot in nanoseconds
+ *
+ *  The TSC is calibrated against the PIT on cpu0 together with the APIC 
+ *  timer. All cores share a clock and their TSCs tick at the same rate, 
+ *  but may be slightly apart; a core whose TSC is behind start_tsc counts
+ *  from 0 instead of wrapping around. To keep the time consistent across 
+ *  cores it never goes below what has been returned on any core, so a 
+ *  thread that migrates, or two threads that talk through memory, never see
+ *  it go backwards. The largest time is updated without a lock.
+ *
+ *  @return Nanoseconds since the calibration started, 0 before it finishes
+ */
+uint64_t timer_get_time_ns() {
+    if (tsc_per_ms == 0)
+        return 0;
+
+    uint64_t tsc = rdtsc();
+    uint64_t cycles = (tsc > start_tsc) ? tsc - start_tsc : 0;
+    // split the conversion, cycles * NS_PER_MS would overflow in hours
+    uint64_t ns = (cycles / tsc_per_ms) * NS_PER_MS + 
+                  (cycles % tsc_per_ms) * NS_PER_MS / tsc_per_ms;
+
+    // raise last_time_ns to ns, unless another core has gone further
+    uint64_t last = asm_cmpxchg64(&last_time_ns, 0, 0);
+    while (ns > last) {
+        uint64_t old = asm_cmpxchg64(&last_time_ns, last, ns);
+        if (old == last)
+            return ns;
+        last = old;
+    }
+    return last;
+}
@@ -19,6 +19,7 @@
 #include <pm.h>
 #include <control_block.h>
 #include <asm_helper.h>
+#include <asm_page.h>
 #include <apic.h>
 #include <mptable.h>
 
@@ -41,12 +42,18 @@
  */
 extern void asm_invalidate_tlb(uint32_t va);
 
+/** @brief Bytes of a bitmap with one bit per page directory entry */
+#define PD_BITMAP_SIZE (PAGE_SIZE / sizeof(pde_t) / 8)
+
 /** @brief Initial page directory for all cores */
 static uint32_t init_page_dir[MAX_CPUS];
 
 /** @brief A system wide all-zero frame used for ZFOD */
 static uint32_t all_zero_frame;
 
+/** @brief 1 if the CPU has SSE2, i.e. movnti, for non-temporal copies */
+static int has_sse2;
+
 /** @brief Default page directory entry control bits */
 static uint32_t ctrl_bits_pde;
 
@@ -155,10 +162,10 @@ static void clear_pd_entry(char *bitmap, int bitmap_size, int pd_index_start) {
     int i, j;
     for(i = 0; i < bitmap_size; i++) {
         char byte = bitmap[i];
-        for(j = 0; j < sizeof(char); j++) {
+        for(j = 0; j < 8; j++) {
             if(IS_SET(byte, j)) {
                 // Get page table address
-                int pd_index = i * sizeof(char) + j + pd_index_start;
+                int pd_index = i * 8 + j + pd_index_start;
                 uint32_t pt_addr = 
                     (uint32_t)(pd->pde[pd_index]) & PAGE_ALIGN_MASK;
                 sfree((void *)pt_addr, PAGE_SIZE);
@@ -209,8 +216,8 @@ static int count_pages_allocated(uint32_t va, int size_bytes,
 
     // Track the newly allcoated page tables in case there's not enough
     // kernel memory as we proceed, we can revert changes
-    int bitmap_size = (num_page_tables - 1)/sizeof(char) + 1;
-    char bitmap[bitmap_size];
+    int bitmap_size = (num_page_tables - 1)/8 + 1;
+    char bitmap[PD_BITMAP_SIZE];
     memset(bitmap, 0, bitmap_size); 
 
     for(i = 0; i < count; i++) {
@@ -247,7 +254,7 @@ static int count_pages_allocated(uint32_t va, int size_bytes,
             }
 
             // Clear
-            memset(new_pt, 0, PAGE_SIZE);
+            asm_zero_page(new_pt);
 
             uint32_t pde_ctrl_bits = ctrl_bits_pde;
 
@@ -288,7 +295,8 @@ static int remove_region(uint32_t va) {
     int is_first_page = 1;
     int is_finished = 0;
 
-    int pt_lock_index = -1;;
+    int pt_lock_index = -1;
+    uint32_t pt_lock_pd_index = 0;
 
     // Get page table lock
     tcb_t *this_thr = tcb_get_entry((void*)asm_get_esp());
@@ -299,7 +307,7 @@ static int remove_region(uint32_t va) {
     if(this_task == NULL) {
         panic("This task's pcb is NULL");
     }
-    mutex_t *pt_locks = this_task->pt_locks;
+    pt_lock_t *pt_lock = &this_task->pt_lock;
 
     while(!is_finished) {
         // Acquire lock for the page table that
@@ -314,11 +322,12 @@ static int remove_region(uint32_t va) {
         if(cur_pt_lock_index != pt_lock_index) {
             if(pt_lock_index != -1) {
                 // Not the first time, release previous lock
-                mutex_unlock(&pt_locks[pt_lock_index]);
+                pt_lock_unlock(pt_lock, pt_lock_pd_index, pt_lock_pd_index);
             }
             pt_lock_index = cur_pt_lock_index;
+            pt_lock_pd_index = pd_index;
             // Get next lock
-            mutex_lock(&pt_locks[pt_lock_index]);
+            pt_lock_lock(pt_lock, pt_lock_pd_index, pt_lock_pd_index);
         }
 
         pde_t *pde = &(pd->pde[pd_index]);
@@ -326,7 +335,7 @@ static int remove_region(uint32_t va) {
         // Check page directory entry presence
         if(!IS_SET(*pde, PG_P)) {
             // Not present
-            mutex_unlock(&pt_locks[pt_lock_index]);
+            pt_lock_unlock(pt_lock, pt_lock_pd_index, pt_lock_pd_index);
             return ERROR_BASE_NOT_PREV;
         }
 
@@ -337,7 +346,7 @@ static int remove_region(uint32_t va) {
 
         if(!IS_SET(*pte, PG_P)) {
             // Not present
-            mutex_unlock(&pt_locks[pt_lock_index]);
+            pt_lock_unlock(pt_lock, pt_lock_pd_index, pt_lock_pd_index);
             return ERROR_BASE_NOT_PREV;
         }
 
@@ -345,7 +354,7 @@ static int remove_region(uint32_t va) {
             // Make sure the first page is the base of a previous 
             // new_pages call.
             if(!IS_SET(*pte, PG_NEW_PAGES_START)) {
-                mutex_unlock(&pt_locks[pt_lock_index]);
+                pt_lock_unlock(pt_lock, pt_lock_pd_index, pt_lock_pd_index);
                 return ERROR_BASE_NOT_PREV;
             } else {
                 is_first_page = 0;
@@ -373,7 +382,7 @@ static int remove_region(uint32_t va) {
     }
 
     // Unlock lock for the page tables that the last page of the region is in
-    mutex_unlock(&pt_locks[pt_lock_index]);
+    pt_lock_unlock(pt_lock, pt_lock_pd_index, pt_lock_pd_index);
     return 0;
 }
 
@@ -423,11 +432,10 @@ int is_page_ZFOD(uint32_t va, uint32_t error_code, int need_check_error_code)
     if(this_task == NULL) {
         panic("This task's pcb is NULL");
     }
-    mutex_t *pt_locks = this_task->pt_locks;
+    pt_lock_t *pt_lock = &this_task->pt_lock;
 
     // Acquire lock first
-    int pt_lock_index = pd_index/NUM_PT_PER_LOCK;
-    mutex_lock(&pt_locks[pt_lock_index]);
+    pt_lock_lock(pt_lock, pd_index, pd_index);
 
     pde_t *pde = &(pd->pde[pd_index]);
 
@@ -445,7 +453,7 @@ int is_page_ZFOD(uint32_t va, uint32_t error_code, int need_check_error_code)
 
             // The page is not marked ZFOD
             if(!IS_SET(*pte, PG_ZFOD)) {
-                mutex_unlock(&pt_locks[pt_lock_index]);
+                pt_lock_unlock(pt_lock, pd_index, pd_index);
                 return 0;
             }
 
@@ -459,7 +467,7 @@ int is_page_ZFOD(uint32_t va, uint32_t error_code, int need_check_error_code)
             uint32_t new_f = get_frames_raw();
             if(new_f == ERROR_NOT_ENOUGH_MEM) {
                 panic("get_frames_raw failed in is_page_ZFOD");
-                mutex_unlock(&pt_locks[pt_lock_index]);
+                pt_lock_unlock(pt_lock, pd_index, pd_index);
             }
 
             // Set page table entry
@@ -469,21 +477,36 @@ int is_page_ZFOD(uint32_t va, uint32_t error_code, int need_check_error_code)
             asm_invalidate_tlb(page);
 
             // Clear new frame
-            memset((void *)page, 0, PAGE_SIZE);
+            asm_zero_page((void *)page);
 
-            mutex_unlock(&pt_locks[pt_lock_index]);
+            pt_lock_unlock(pt_lock, pd_index, pd_index);
             return 1;
         }
     }
 
     // Release page table lock
-    mutex_unlock(&pt_locks[pt_lock_index]);
+    pt_lock_unlock(pt_lock, pd_index, pd_index);
     return 0;
 
 }
 
 
 
+/** @brief Copy a page without polluting the cache if the CPU supports it
+ *
+ *  @param dst Page aligned destination
+ *  @param src Page aligned source
+ *
+ *  @return Void
+ */
+static void copy_page_nocache(void *dst, const void *src) {
+    if(has_sse2) {
+        asm_copy_page_nt(dst, src);
+    } else {
+        asm_copy_page(dst, src);
+    }
+}
+
 /** @brief Create an initial page directory along with page tables 
  *  for 16 MB kernel memory space, i.e., 0x0 to 0xffffff. 
  *  
@@ -500,7 +523,7 @@ static uint32_t init_pd() {
         return ERROR_MALLOC_LIB;
     }
     // Clear
-    memset(pd, 0, PAGE_SIZE);
+    asm_zero_page(pd);
 
     // Get pde ctrl bits
     uint32_t pde_ctrl_bits = ctrl_bits_pde;
@@ -513,7 +536,7 @@ static uint32_t init_pd() {
             return ERROR_MALLOC_LIB;
         }
         // Clear
-        memset(new_pt, 0, PAGE_SIZE);
+        asm_zero_page(new_pt);
         pd->pde[i] = ((uint32_t)new_pt | pde_ctrl_bits);
     }
 
@@ -675,6 +698,8 @@ int init_vm() {
     // Configure default page table entry and page diretory entry control bits
     init_pg_ctrl_bits();
 
+    has_sse2 = (asm_get_cpuid_edx(1) & CPUID_EDX_SSE2) != 0;
+
     if(init_vm_raw() < 0) {
         lprintf("init_vm_raw failed");
         return -1;
@@ -689,7 +714,7 @@ int init_vm() {
         return ERROR_MALLOC_LIB;
     }
     // Clear
-    memset(new_f, 0, PAGE_SIZE);
+    asm_zero_page(new_f);
     all_zero_frame = (uint32_t)new_f;
 
     // Init user space physical memory manager
@@ -709,7 +734,7 @@ uint32_t create_pd() {
     if(pd == NULL) {
         return ERROR_MALLOC_LIB;
     }
-    memset((void *)pd, 0, PAGE_SIZE);
+    asm_zero_page((void *)pd);
 
     // Reuse kernel space page tables
     uint32_t old_pd = get_cr3();
@@ -761,7 +786,7 @@ uint32_t clone_pd() {
         free(frame_buf);
         return ERROR_MALLOC_LIB;
     }
-    memset(pd, 0, PAGE_SIZE);
+    asm_zero_page(pd);
 
     int i, j;
     for(i = 0; i < PAGE_SIZE/ENTRY_SIZE; i++) {
@@ -791,7 +816,7 @@ uint32_t clone_pd() {
                 return ERROR_MALLOC_LIB;
             } 
             uint32_t old_pt_addr = old_pd->pde[i] & PAGE_ALIGN_MASK;
-            memcpy((void *)new_pt, (void *)old_pt_addr, PAGE_SIZE);
+            asm_copy_page(new_pt, (void *)old_pt_addr);
             pd->pde[i] = (uint32_t)new_pt | GET_CTRL_BITS(old_pd->pde[i]);
 
             // Clone frames
@@ -808,7 +833,7 @@ uint32_t clone_pd() {
                     // current page table entry points to.
                     uint32_t va = GET_VA_BASE(i, j);
                     // Copy the content in the frame to a buffer
-                    memcpy(frame_buf, (void *)va, PAGE_SIZE);
+                    asm_copy_page(frame_buf, (void *)va);
 
                     // Temporarily change the frame where the old page table 
                     // entry points to to the new frame so that we can copy 
@@ -818,9 +843,10 @@ uint32_t clone_pd() {
                         new_f | GET_CTRL_BITS(pt->pte[j]);
                     // Invalidate page in tlb as we update page table entry
                     asm_invalidate_tlb(va);
-                    
 
-                    memcpy((void *)va, frame_buf, PAGE_SIZE);
+                    // The parent goes on running while the child's pages
+                    // aren't touched for a while, so keep them out of cache
+                    copy_page_nocache((void *)va, frame_buf);
                     // Change back old page table entry to point to the old
                     // frame.
                     ((pt_t *)old_pt_addr)->pte[j] = 
@@ -965,14 +991,7 @@ int new_region(uint32_t va, int size_bytes, int rw_perm,
     uint32_t page_lowest_pd_index = GET_PD_INDEX(page_lowest);
     uint32_t page_highest_pd_index = GET_PD_INDEX(page_highest);
 
-    // The lock index for the lowest page table that region is in.
-    // For example, if NUM_PT_PER_LOCK is 8, then page table 0 - 7
-    // has lock index 0, page table 8 - 15 has lock index 1
-    int lowest_pt_lock_index = page_lowest_pd_index/NUM_PT_PER_LOCK;
-    int highest_pt_lock_index = page_highest_pd_index/NUM_PT_PER_LOCK;
-    int num_pt_lock = highest_pt_lock_index - lowest_pt_lock_index + 1;
-
-    mutex_t *pt_locks;
+    pt_lock_t *pt_lock = NULL;
     if(is_new_pages_syscall) {
         // Only need lock when serving new_pages_syscall, since in the other 
         // case where kernel calls this function to allocate initial space 
@@ -989,13 +1008,8 @@ int new_region(uint32_t va, int size_bytes, int rw_perm,
             panic("This task's pcb is NULL");
         }
 
-        pt_locks = this_task->pt_locks;
-        int pt_lock_index = lowest_pt_lock_index;
-        int i;
-        for(i = 0; i < num_pt_lock; i++) {
-            mutex_lock(&pt_locks[pt_lock_index]);
-            pt_lock_index++;
-        }
+        pt_lock = &this_task->pt_lock;
+        pt_lock_lock(pt_lock, page_lowest_pd_index, page_highest_pd_index);
     }
 
 
@@ -1008,12 +1022,8 @@ int new_region(uint32_t va, int size_bytes, int rw_perm,
     if(num_pages_allocated < 0) {
         // Not enough kernel memory to allocate page tables
         if(is_new_pages_syscall) {
-            int i;
-            int pt_lock_index = highest_pt_lock_index;
-            for(i = 0; i < num_pt_lock; i++) {
-                mutex_unlock(&pt_locks[pt_lock_index]);
-                pt_lock_index--;
-            }
+            pt_lock_unlock(pt_lock, page_lowest_pd_index, 
+                    page_highest_pd_index);
         }
         return ERROR_MALLOC_LIB;
     }
@@ -1024,12 +1034,7 @@ int new_region(uint32_t va, int size_bytes, int rw_perm,
         // while if kernel calls this function to allocate initial space
         // for tasks, it's OK to have regions overlap (e.g., rodata and text
         // segments may overlap with each other.)
-        int i;
-        int pt_lock_index = highest_pt_lock_index;
-        for(i = 0; i < num_pt_lock; i++) {
-            mutex_unlock(&pt_locks[pt_lock_index]);
-            pt_lock_index--;
-        }
+        pt_lock_unlock(pt_lock, page_lowest_pd_index, page_highest_pd_index);
 
         return ERROR_OVERLAP;
     }
@@ -1044,12 +1049,8 @@ int new_region(uint32_t va, int size_bytes, int rw_perm,
     // the frames as allocated now.
     if(reserve_frames(count - num_pages_allocated) == -1) {
         if(is_new_pages_syscall) {
-            int i;
-            int pt_lock_index = highest_pt_lock_index;
-            for(i = 0; i < num_pt_lock; i++) {
-                mutex_unlock(&pt_locks[pt_lock_index]);
-                pt_lock_index--;
-            }
+            pt_lock_unlock(pt_lock, page_lowest_pd_index, 
+                    page_highest_pd_index);
         }
         return ERROR_NOT_ENOUGH_MEM;
     }
@@ -1123,7 +1124,7 @@ int new_region(uint32_t va, int size_bytes, int rw_perm,
 
             // Clear new frame
             if(!is_ZFOD) {
-                memset((void *)page, 0, PAGE_SIZE);
+                asm_zero_page((void *)page);
             }
 
         }
@@ -1133,13 +1134,8 @@ int new_region(uint32_t va, int size_bytes, int rw_perm,
 
     // Unlock locks
     if(is_new_pages_syscall) {
-        int i;
-        int pt_lock_index = highest_pt_lock_index;
         // Unlock locks of the page tables that cover the region
-        for(i = 0; i < num_pt_lock; i++) {
-            mutex_unlock(&pt_locks[pt_lock_index]);
-            pt_lock_index--;
-        }
+        pt_lock_unlock(pt_lock, page_lowest_pd_index, page_highest_pd_index);
     }
 
     return 0;
@@ -1263,24 +1259,13 @@ int check_mem_validness(char *va, int max_bytes, int is_check_null,
     if(this_task == NULL) {
         panic("This task's pcb is NULL");
     }
-    mutex_t *pt_locks = this_task->pt_locks;
+    pt_lock_t *pt_lock = &this_task->pt_lock;
 
     // Acquire locks for page tables covered by region first
     // Get page table index range in page diretory
     uint32_t page_lowest_pd_index = GET_PD_INDEX(page_lowest);
     uint32_t page_highest_pd_index = GET_PD_INDEX(page_highest);
-
-    // The lock index for the lowest page table that region is in
-    // For example, if NUM_PT_PER_LOCK is 8, then page table 0 - 7
-    // has lock index 0, page table 8 - 15 has lock index 1
-    int lowest_pt_lock_index = page_lowest_pd_index/NUM_PT_PER_LOCK;
-    int highest_pt_lock_index = page_highest_pd_index/NUM_PT_PER_LOCK;
-    int num_pt_lock = highest_pt_lock_index - lowest_pt_lock_index + 1;
-    int pt_lock_index = lowest_pt_lock_index;
-    for(i = 0; i < num_pt_lock; i++) {
-        mutex_lock(&pt_locks[pt_lock_index]);
-        pt_lock_index++;
-    }
+    pt_lock_lock(pt_lock, page_lowest_pd_index, page_highest_pd_index);
 
     int ret = 0;
     int is_finished = 0;
@@ -1343,11 +1328,7 @@ int check_mem_validness(char *va, int max_bytes, int is_check_null,
     }
 
     // Release page table locks covered by region
-    pt_lock_index = highest_pt_lock_index;
-    for(i = 0; i < num_pt_lock; i++) {
-        mutex_unlock(&pt_locks[pt_lock_index]);
-        pt_lock_index--;
-    }
+    pt_lock_unlock(pt_lock, page_lowest_pd_index, page_highest_pd_index);
     return ret;
 }
 
@@ -26,7 +26,10 @@ int gettid(void);
 int yield(int pid);
 int deschedule(int *flag);
 int make_runnable(int pid);
+int make_runnable_many(int *tids, int n);
+int set_tls_base(void *base);
 unsigned int get_ticks(void);
+int get_time_ns(unsigned long long *ns);
 int sleep(int ticks);
 
 /* Memory management */
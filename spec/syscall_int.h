@@ -66,4 +66,12 @@
 #define SYSCALL_RESERVED_15       0x8F
 #define SYSCALL_RESERVED_END      0x8F
 
+/* Extensions of the spec, using the reserved syscall numbers above */
+#define MAKE_RUNNABLE_MANY_INT    SYSCALL_RESERVED_0
+#define SET_TLS_BASE_INT          SYSCALL_RESERVED_1
+#define GET_TIME_NS_INT           SYSCALL_RESERVED_2
+
+/* Maximum number of tids that can be passed to make_runnable_many() */
+#define MAKE_RUNNABLE_MANY_MAX    64
+
 #endif /* _SYSCALL_INT_H */
@@ -0,0 +1,18 @@
+/** @file barrier.h
+ *  @brief This file defines the interface to barriers
+ */
+
+#ifndef _BARRIER_H
+#define _BARRIER_H
+
+#include <barrier_type.h>
+
+/** @brief Returned by barrier_wait() to the last thread arriving in a phase */
+#define BARRIER_SERIAL_THREAD 1
+
+/* barrier functions */
+int barrier_init(barrier_t *barrier, int num_threads);
+int barrier_wait(barrier_t *barrier);
+void barrier_destroy(barrier_t *barrier);
+
+#endif /* _BARRIER_H */
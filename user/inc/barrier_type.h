@@ -0,0 +1,26 @@
+/** @file barrier_type.h
+ *  @brief This file defines the type for barriers.
+ */
+
+#ifndef _BARRIER_TYPE_H
+#define _BARRIER_TYPE_H
+
+#include <mutex_type.h>
+#include <cond_type.h>
+
+/** @brief barrier type */
+typedef struct barrier {
+    /** @brief Number of threads that must call barrier_wait() in a phase, 
+     *  -1 if the barrier is destroyed */
+    int num_threads;
+    /** @brief Number of threads that have not arrived in this phase */
+    volatile int count;
+    /** @brief Flips every time a phase completes */
+    volatile int sense;
+    /** @brief A mutex to guard sense for threads that block */
+    mutex_t mutex;
+    /** @brief A condition variable for threads that block to wait on */
+    cond_t cond;
+} barrier_t;
+
+#endif /* _BARRIER_TYPE_H */
@@ -0,0 +1,97 @@
+/** @file bench.h
+ *  @brief Timing and reporting helpers for the bench_* programs
+ *
+ *  A benchmark is timed with the time stamp counter, get_time_ns() and 
+ *  get_ticks(),
+ *  and every result is reported as one line, both on the console and to 
+ *  the simulator log, so runs on different kernels can be diffed:
+ *     bench: prog=<prog> op=<op> arg=<n> iters=<n> cycles=<n> 
+ *            cycles_per_iter=<n> ns=<n> ns_per_iter=<n> ticks=<n>
+ *  (on a single line). arg is an operation specific parameter such as the 
+ *  number of pages, 0 if there is none.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <simics.h>
+
+/** @brief A running benchmark */
+typedef struct {
+    /** @brief Name of the program */
+    const char *prog;
+    /** @brief Name of the operation */
+    const char *op;
+    /** @brief Operation specific parameter */
+    int arg;
+    /** @brief Time stamp counter at start */
+    uint64_t tsc;
+    /** @brief get_time_ns() at start */
+    unsigned long long ns;
+    /** @brief Ticks at start */
+    unsigned int ticks;
+} bench_t;
+
+/** @brief Read the time stamp counter
+ *
+ *  @return The time stamp counter
+ */
+static inline uint64_t bench_rdtsc() {
+    uint64_t tsc;
+    __asm__ __volatile__("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+/** @brief Start timing an operation
+ *
+ *  @param b The benchmark
+ *  @param prog Name of the program
+ *  @param op Name of the operation
+ *  @param arg Operation specific parameter
+ *
+ *  @return void
+ */
+static inline void bench_start(bench_t *b, const char *prog, const char *op,
+                               int arg) {
+    b->prog = prog;
+    b->op = op;
+    b->arg = arg;
+    b->ticks = get_ticks();
+    get_time_ns(&b->ns);
+    b->tsc = bench_rdtsc();
+}
+
+/** @brief Stop timing an operation and report the result
+ *
+ *  @param b The benchmark
+ *  @param iters Number of times the operation was done
+ *
+ *  @return void
+ */
+static inline void bench_end(bench_t *b, int iters) {
+    uint64_t cycles = bench_rdtsc() - b->tsc;
+    unsigned long long ns;
+    get_time_ns(&ns);
+    ns -= b->ns;
+    unsigned int ticks = get_ticks() - b->ticks;
+    uint64_t per_iter = iters > 0 ? cycles / iters : 0;
+    unsigned long long ns_per_iter = iters > 0 ? ns / iters : 0;
+
+    printf("bench: prog=%s op=%s arg=%d iters=%d cycles=%llu "
+           "cycles_per_iter=%llu ns=%llu ns_per_iter=%llu ticks=%u\n", 
+           b->prog, b->op, b->arg, iters, cycles, per_iter, ns, ns_per_iter, 
+           ticks);
+    lprintf("bench: prog=%s op=%s arg=%d iters=%d cycles=%llu "
+            "cycles_per_iter=%llu ns=%llu ns_per_iter=%llu ticks=%u", 
+            b->prog, b->op, b->arg, iters, cycles, per_iter, ns, ns_per_iter,
+            ticks);
+}
+
+#endif /* _BENCH_H */
@@ -5,19 +5,35 @@
 #ifndef _COND_TYPE_H
 #define _COND_TYPE_H
 
-#include <mutex_type.h>
-#include <queue.h>
+#include <variable_queue.h>
+#include <spinlock.h>
 
+/** @brief The node that a thread waiting on a condition variable puts in the
+ *  waiting queue, it is allocated on the stack of the waiting thread */
+typedef struct cond_node {
+    /** @brief Link in the waiting queue */
+    Q_NEW_LINK(cond_node) link;
+    /** @brief The thread id assigned by the kernel */
+    int ktid;
+    /** @brief Set to 1 when the thread is signaled */
+    int reject;
+} cond_node_t;
+
+/** @brief The waiting queue of a condition variable */
+Q_NEW_HEAD(cond_queue_t, cond_node);
 
 /** @brief Condition variable type */
 typedef struct cond {
-    /** @brief A mutex to protect critical section of condition varaible code 
+    /** @brief A flag indicating if the condition variable is destroied */
+    int is_destroyed;
+    /** @brief A spinlock to protect critical section of condition varaible 
+     *  code 
      */
-    mutex_t mutex;
-    /** @brief A double-ended queue to place the threads that are blocking on 
-     *  the condition varaible.
+    spinlock_t inner_lock;
+    /** @brief A FIFO queue to place the threads that are blocking on the 
+     *  condition varaible.
      */
-    deque_t deque;
+    cond_queue_t waiters;
 } cond_t;
 
 #endif /* _COND_TYPE_H */
@@ -0,0 +1,17 @@
+/** @file latch.h
+ *  @brief This file defines the interface to latches
+ */
+
+#ifndef _LATCH_H
+#define _LATCH_H
+
+#include <latch_type.h>
+
+/* latch functions */
+int latch_init(latch_t *latch, int count);
+void latch_count_down(latch_t *latch);
+void latch_wait(latch_t *latch);
+int latch_try_wait(latch_t *latch);
+void latch_destroy(latch_t *latch);
+
+#endif /* _LATCH_H */
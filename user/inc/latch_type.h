@@ -0,0 +1,22 @@
+/** @file latch_type.h
+ *  @brief This file defines the type for latches.
+ */
+
+#ifndef _LATCH_TYPE_H
+#define _LATCH_TYPE_H
+
+#include <mutex_type.h>
+#include <cond_type.h>
+
+/** @brief latch type, a single use countdown event */
+typedef struct latch {
+    /** @brief Number of latch_count_down() calls before the latch opens, 
+     *  -1 if the latch is destroyed */
+    volatile int count;
+    /** @brief A mutex to guard count for threads that block */
+    mutex_t mutex;
+    /** @brief A condition variable for threads that block to wait on */
+    cond_t cond;
+} latch_t;
+
+#endif /* _LATCH_TYPE_H */
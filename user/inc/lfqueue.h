@@ -0,0 +1,26 @@
+/** @file lfqueue.h
+ *  @brief This file defines the interface for lock-free queues.
+ */
+
+#ifndef _LFQUEUE_H
+#define _LFQUEUE_H
+
+#include <lfqueue_type.h>
+
+/* multi-producer multi-consumer queue functions */
+int mpmc_init(mpmc_queue_t *queue, int capacity);
+void mpmc_destroy(mpmc_queue_t *queue);
+int mpmc_try_push(mpmc_queue_t *queue, void *item);
+int mpmc_try_pop(mpmc_queue_t *queue, void **item);
+void mpmc_push(mpmc_queue_t *queue, void *item);
+void *mpmc_pop(mpmc_queue_t *queue);
+
+/* single-producer single-consumer ring functions */
+int spsc_init(spsc_ring_t *ring, int capacity);
+void spsc_destroy(spsc_ring_t *ring);
+int spsc_try_push(spsc_ring_t *ring, void *item);
+int spsc_try_pop(spsc_ring_t *ring, void **item);
+void spsc_push(spsc_ring_t *ring, void *item);
+void *spsc_pop(spsc_ring_t *ring);
+
+#endif /* _LFQUEUE_H */
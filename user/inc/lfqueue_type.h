@@ -0,0 +1,61 @@
+/** @file lfqueue_type.h
+ *  @brief This file defines the types for lock-free queues.
+ */
+
+#ifndef _LFQUEUE_TYPE_H
+#define _LFQUEUE_TYPE_H
+
+#include <mutex_type.h>
+#include <cond_type.h>
+
+/** @brief Threads blocked on a queue because it is empty or full */
+typedef struct lfq_waitset {
+    /** @brief Number of threads that are about to block or blocked */
+    volatile int num_waiters;
+    /** @brief Mutex for blocked threads to check the queue again */
+    mutex_t mutex;
+    /** @brief Blocked threads wait on it */
+    cond_t cond;
+} lfq_waitset_t;
+
+/** @brief A cell of a MPMC queue */
+typedef struct mpmc_cell {
+    /** @brief Sequence number, tells which lap of push or pop owns the cell */
+    volatile int seq;
+    /** @brief The item */
+    void * volatile item;
+} mpmc_cell_t;
+
+/** @brief Bounded multi-producer multi-consumer queue */
+typedef struct mpmc_queue {
+    /** @brief Capacity - 1, the capacity is a power of 2 */
+    int mask;
+    /** @brief Cells */
+    mpmc_cell_t *cells;
+    /** @brief Position of the next push, only increases */
+    volatile int push_pos;
+    /** @brief Position of the next pop, only increases */
+    volatile int pop_pos;
+    /** @brief Threads blocked in mpmc_pop() */
+    lfq_waitset_t not_empty;
+    /** @brief Threads blocked in mpmc_push() */
+    lfq_waitset_t not_full;
+} mpmc_queue_t;
+
+/** @brief Bounded single-producer single-consumer ring */
+typedef struct spsc_ring {
+    /** @brief Capacity - 1, the capacity is a power of 2 */
+    int mask;
+    /** @brief Items */
+    void * volatile *items;
+    /** @brief Index of the next push, only written by the producer */
+    volatile int tail;
+    /** @brief Index of the next pop, only written by the consumer */
+    volatile int head;
+    /** @brief The consumer blocked in spsc_pop() */
+    lfq_waitset_t not_empty;
+    /** @brief The producer blocked in spsc_push() */
+    lfq_waitset_t not_full;
+} spsc_ring_t;
+
+#endif /* _LFQUEUE_TYPE_H */
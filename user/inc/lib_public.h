@@ -51,6 +51,8 @@ uint32_t get_root_thread_stack_high();
 
 /** @brief Initialized malloc lib */
 int malloc_init();
+/** @brief Tell malloc lib that the thread library has been initialized */
+void malloc_thr_init();
 
 #endif 
 
@@ -5,19 +5,43 @@
 #ifndef _MUTEX_TYPE_H
 #define _MUTEX_TYPE_H
 
-#include <queue.h>
+#include <variable_queue.h>
 #include <spinlock.h>
 
+/** @brief The mutex is destroied */
+#define MUTEX_DESTROYED     -1
+/** @brief The mutex is available */
+#define MUTEX_UNLOCKED      0
+/** @brief The mutex is locked and no thread is waiting for it */
+#define MUTEX_LOCKED        1
+/** @brief The mutex is locked and some threads may be waiting for it */
+#define MUTEX_CONTENDED     2
+
+/** @brief The node that a thread blocked on a mutex puts in the waiting queue,
+ *  it is allocated on the stack of the blocked thread */
+typedef struct mutex_node {
+    /** @brief Link in the waiting queue */
+    Q_NEW_LINK(mutex_node) link;
+    /** @brief The thread id assigned by the kernel */
+    int ktid;
+    /** @brief Set to 1 when the mutex is handed over to the thread */
+    int reject;
+} mutex_node_t;
+
+/** @brief The waiting queue of a mutex */
+Q_NEW_HEAD(mutex_queue_t, mutex_node);
+
 /** @brief Mutex type */
 typedef struct mutex {
-    /** @brief A flag indicating if the mutex lock is available */
-    int lock_available;
-    /** @brief A spinlock to protect critical section of mutex code */
+    /** @brief State of the mutex: MUTEX_UNLOCKED, MUTEX_LOCKED, 
+     *  MUTEX_CONTENDED or MUTEX_DESTROYED */
+    int lock_state;
+    /** @brief A spinlock to protect the waiting queue */
     spinlock_t inner_lock;
-    /** @brief A double-ended queue to store the threads that are blocking on
-      * the mutex
+    /** @brief A FIFO queue to store the threads that are blocking on the 
+      * mutex
       */
-    deque_t deque;
+    mutex_queue_t waiters;
 } mutex_t;
 
 #endif /* _MUTEX_TYPE_H */
@@ -0,0 +1,18 @@
+/** @file pool.h
+ *  @brief This file defines the interface for thread pools.
+ */
+
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <pool_type.h>
+
+/* thread pool functions */
+int pool_init(pool_t *pool, int num_workers);
+void pool_destroy(pool_t *pool);
+int pool_submit(pool_t *pool, void (*func)(void *), void *arg);
+void pool_wait(pool_t *pool);
+int parallel_for(pool_t *pool, int begin, int end, int grain,
+                 void (*body)(int, void *), void *arg);
+
+#endif /* _POOL_H */
@@ -0,0 +1,86 @@
+/** @file pool_type.h
+ *  @brief This file defines the type for thread pools.
+ */
+
+#ifndef _POOL_TYPE_H
+#define _POOL_TYPE_H
+
+#include <variable_queue.h>
+#include <mutex_type.h>
+#include <cond_type.h>
+
+/** @brief Capacity of the deque of a worker, must be a power of 2 */
+#define POOL_DEQUE_SIZE 256
+
+struct pool;
+struct pool_loop;
+
+/** @brief A task submitted to a thread pool */
+typedef struct pool_task {
+    /** @brief Link in the injection queue of the pool */
+    Q_NEW_LINK(pool_task) link;
+    /** @brief The function to run, NULL for a chunk of parallel_for() */
+    void (*func)(void *);
+    /** @brief The argument of func */
+    void *arg;
+    /** @brief The parallel_for() this chunk belongs to */
+    struct pool_loop *loop;
+    /** @brief The first iteration of the chunk */
+    int begin;
+    /** @brief One past the last iteration of the chunk */
+    int end;
+} pool_task_t;
+
+/** @brief Queue of tasks */
+Q_NEW_HEAD(pool_task_queue_t, pool_task);
+
+/** @brief Chase-Lev work stealing deque of a worker
+ *
+ *  The owner pushes and takes at bottom, other workers steal at top.
+ */
+typedef struct pool_deque {
+    /** @brief Index of the oldest task, only increases */
+    volatile int top;
+    /** @brief Index of the next free entry */
+    volatile int bottom;
+    /** @brief Circular buffer of tasks */
+    pool_task_t * volatile tasks[POOL_DEQUE_SIZE];
+} pool_deque_t;
+
+/** @brief A worker thread of a pool */
+typedef struct pool_worker {
+    /** @brief The pool that the worker belongs to */
+    struct pool *pool;
+    /** @brief Thread lib assigned thread id of the worker */
+    volatile int tid;
+    /** @brief State of the pseudo random number generator to pick victims */
+    unsigned int seed;
+    /** @brief Tasks of the worker */
+    pool_deque_t deque;
+} pool_worker_t;
+
+/** @brief Thread pool type */
+typedef struct pool {
+    /** @brief Number of workers */
+    int num_workers;
+    /** @brief Workers */
+    pool_worker_t *workers;
+    /** @brief Number of tasks that are queued but not started */
+    volatile int num_queued;
+    /** @brief Number of tasks that are submitted but not finished */
+    volatile int num_pending;
+    /** @brief Number of workers that are sleeping on work_cv */
+    volatile int num_sleeping;
+    /** @brief Set when the pool is destroyed */
+    volatile int is_shutdown;
+    /** @brief Mutex to protect injection and the condition variables */
+    mutex_t lock;
+    /** @brief Workers sleep on it when there is no task */
+    cond_t work_cv;
+    /** @brief pool_wait() and parallel_for() sleep on it */
+    cond_t done_cv;
+    /** @brief Tasks submitted by threads that are not workers */
+    pool_task_queue_t injection;
+} pool_t;
+
+#endif /* _POOL_TYPE_H */
@@ -10,7 +10,9 @@
 
 /** @brief rwlock type */
 typedef struct rwlock {
-    /** @brief State of rwlock */
+    /** @brief State of rwlock, the number of readers holding the lock and
+     *  the RW_* flags in rwlock.c, only changed with atomic instructions
+     */
     int lock_state;
     /** @brief A count of how many writers are waiting on the lock */
     int writer_waiting_count;
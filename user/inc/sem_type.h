@@ -11,14 +11,18 @@
 
 /** @brief semaphore type */ 
 typedef struct sem {
-    /** @brief A mutux to guard access to changes to cond and count */
+    /** @brief A mutux to guard access to changes to cond and num_wakeups */
     mutex_t mutex;
-    /** @brief A condition variable to wait and signal threads according 
-     * to the available count. 
+    /** @brief A condition variable for threads to block on when no 
+     * resource is available. 
      */
     cond_t cond;
-    /** @brief A counter indicating the number of resources availbale */
+    /** @brief Number of resources availbale if positive, minus the number 
+     * of waiting threads if negative. Only changed with atomic instructions.
+     */
     int count;
+    /** @brief Number of resources handed to blocked threads but not taken */
+    int num_wakeups;
 } sem_t;
 
 #endif /* _SEM_TYPE_H */
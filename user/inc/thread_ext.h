@@ -0,0 +1,32 @@
+/** @file thread_ext.h
+ *  @brief This file defines the interface our thread library adds to 
+ *         thread.h
+ *
+ *  thread.h lives in 410user/inc, which may not be modified and comes 
+ *  before user/inc in the include path, so a user/inc/thread.h would never
+ *  be found. thr_internals.h includes this file, so everything that 
+ *  includes thread.h still sees these functions.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _THREAD_EXT_H
+#define _THREAD_EXT_H
+
+/** @brief Number of thread specific data keys, see thr_key_create() */
+#define THR_TLS_KEYS 16
+
+/* thread specific data */
+int thr_key_create(void);
+void *thr_getspecific(int key);
+int thr_setspecific(int key, void *value);
+
+/* thread library tuning and detached threads */
+int thr_set_stack_cache(int max_idle);
+int thr_detach(int tid);
+int thr_set_spin(int spin, int backoff);
+
+#endif /* _THREAD_EXT_H */
@@ -0,0 +1,14 @@
+/** @file variable_queue.h
+ *
+ *  @brief Makes the queue macros of vq_challenge/variable_queue.h available
+ *         under the usual include path
+ *
+ *  The macros are kept in vq_challenge only, which is not in the include
+ *  path of the kernel or of user programs, so this file just includes it.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
+ **/
+
+#include "../../vq_challenge/variable_queue.h"
@@ -31,6 +31,15 @@ void *ebp__main;
  */
 #define VALID_OUTBOUND 4
 
+/** @brief Factor the root thread stack grows by on a fault */
+static int growth_factor = AUTOSTACK_GROWTH_FACTOR;
+
+/** @brief Maximum number of pages the root thread stack grows on a fault */
+static int max_grow_pages = AUTOSTACK_MAX_GROW_PAGES;
+
+/** @brief If new stack pages are touched as soon as they are allocated */
+static int is_prefault = AUTOSTACK_PREFAULT;
+
 /** @brief Get current root thread stack low
  *  
  *  Root thread stack low has the chance to grow down before a new thread is 
@@ -101,11 +110,80 @@ int allocate_pages(uint32_t range_high, uint32_t range_low) {
     return lowest_page_base;
 }
 
+/** @brief Grow root thread stack down to cover a faulting address
+ *
+ *  The stack grows by growth_factor times its current size (at least down 
+ *  to AUTOSTACK_HEADROOM pages below the faulting page, at most 
+ *  max_grow_pages), so a deep recursion takes a logarithmic number of 
+ *  exceptions instead of one per page, and the page right below the 
+ *  faulting one is always mapped, so the common "one page below the stack"
+ *  push never traps at all. If that much can not be allocated, e.g. it 
+ *  runs into the heap or memory is short, fall back to growing exactly 
+ *  down to the faulting page.
+ *
+ *  @param fault_addr The faulting address, below root_thread_stack_low
+ *
+ *  @return 0 on success; -1 on failure
+ */
+static int grow_root_stack(uint32_t fault_addr) {
+    uint32_t old_low = root_thread_stack_low & PAGE_ALIGN_MASK;
+    uint32_t fault_page = fault_addr & PAGE_ALIGN_MASK;
+    uint32_t cur_size = root_thread_stack_high - old_low;
+    uint32_t grow = cur_size * (growth_factor - 1);
+    uint32_t max_grow = max_grow_pages * PAGE_SIZE;
+    uint32_t headroom = AUTOSTACK_HEADROOM * PAGE_SIZE;
+
+    if (grow > max_grow)
+        grow = max_grow;
+    if (grow < old_low - fault_page + headroom)
+        grow = old_low - fault_page + headroom;
+
+    uint32_t new_low = ERROR_NEW_PAGES_GENERAL;
+    if (grow < old_low)
+        new_low = allocate_pages(root_thread_stack_low - 1, old_low - grow);
+    if (new_low == ERROR_NEW_PAGES_GENERAL)
+        new_low = allocate_pages(root_thread_stack_low - 1, fault_addr);
+    if (new_low == ERROR_NEW_PAGES_GENERAL)
+        return -1;
+
+    // Take the zero-fill faults of the new region now, in one go
+    if (is_prefault) {
+        uint32_t page;
+        for (page = new_low; page < old_low; page += PAGE_SIZE)
+            *(volatile char *)page = 0;
+    }
+
+    // Update root thread's valid stack region
+    root_thread_stack_low = new_low;
+    return 0;
+}
+
+/** @brief Set how autostack grows root thread stack
+ *
+ *  @param factor The stack grows to factor times its size on a fault, 
+ *                at least 2
+ *  @param max_pages The stack grows by at most this many pages on a fault, 
+ *                   unless the fault is further below
+ *  @param prefault Non-zero to touch every new page when the stack grows
+ *
+ *  @return 0 on success; -1 if an argument is out of range
+ */
+int autostack_set_growth(int factor, int max_pages, int prefault) {
+    if (factor < 2 || max_pages < 1)
+        return -1;
+
+    growth_factor = factor;
+    max_grow_pages = max_pages;
+    is_prefault = prefault;
+    return 0;
+}
+
 /** @brief Exception handler for autostack 
  *
  *  Only handles stack growth for root thread before a new thread is created. 
- *  Expands the root thread's stack region down to the page where a memory 
- *  address which results in fault page is in. The handler will try to
+ *  Expands the root thread's stack region down past the page where a memory 
+ *  address which results in fault page is in, see grow_root_stack(). The 
+ *  handler will try to
  *  allocate pages down to a faulting address if that address is within the
  *  function call stack frame, (within the region delimited by %ebp and %esp),
  *  but addresses that below %esp VALID_OUTBOUND distance are also considered
@@ -129,20 +207,17 @@ void swexn_handler(void *arg, ureg_t *ureg) {
 
         // ureg->cr2 is the memory address that resulted in the fault
         if(ureg->cr2 > ureg->ebp || 
-                (ureg->cr2 + VALID_OUTBOUND) < ureg->esp) {
+                (ureg->cr2 + VALID_OUTBOUND) < ureg->esp ||
+                ureg->cr2 >= root_thread_stack_low) {
             return;
         }
         
         // Try allocating new pages for it
         // After this call, memory region down to faulting address
         // will become valid if pages are successfully allocated
-        uint32_t new_root_thread_stack_low =
-            allocate_pages(root_thread_stack_low - 1, ureg->cr2); 
-        if(new_root_thread_stack_low == ERROR_NEW_PAGES_GENERAL) {
+        if(grow_root_stack(ureg->cr2) < 0) {
             return;
         }
-        // Update root thread's valid stack region
-        root_thread_stack_low = new_root_thread_stack_low;
 
         // Re-register exception handler and re-execute faulting instruction
         uint32_t esp3 = exn_stack_high;
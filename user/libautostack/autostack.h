@@ -23,9 +23,22 @@
  * do something requires substantial stack space.
  *
  */
-#define EXCEPTION_STACK_SIZE (PAGE_SIZE/16)
+#define EXCEPTION_STACK_SIZE (PAGE_SIZE/8)
+
+/** @brief Default factor the root thread stack grows by on a fault */
+#define AUTOSTACK_GROWTH_FACTOR 2
+
+/** @brief Default maximum number of pages the stack grows on a fault */
+#define AUTOSTACK_MAX_GROW_PAGES 64
+
+/** @brief Number of pages kept mapped below a faulting page */
+#define AUTOSTACK_HEADROOM 1
+
+/** @brief If new stack pages are touched by default */
+#define AUTOSTACK_PREFAULT 0
 
 int allocate_pages(uint32_t range_high, uint32_t range_low);
+int autostack_set_growth(int factor, int max_pages, int prefault);
 void swexn_handler(void *arg, ureg_t *ureg);
 void install_autostack(void *stack_high, void *stack_low);
 
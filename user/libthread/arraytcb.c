@@ -8,9 +8,21 @@
  *  array[3]->data->tid == 2 means thread #2 is running on stack #3. At 
  *  beginning, master thread (tid == 0) is running on stack 0. 
  *  array[i] == NULL means stack i is not used by any thread. Besides 
- *  array->data[] there is another data structure array->avail_list which is a
- *  linked list that stores all avilable (no be used by any thread) stack 
- *  'slot' so that arraytcb_insert_thread() can be done in O(1) time. 
+ *  array->data[] there is another data structure array->avail_slots which is
+ *  a stack of all avilable (no be used by any thread) stack 'slot' so that
+ *  arraytcb_insert_thread() can be done in O(1) time. 
+ *
+ *  Up to max_cached available slots keep their stack mapped, they are kept
+ *  in array->cached_slots instead, and are reused before any other slot.
+ *  Creating a thread on a cached slot and exiting a thread whose slot is
+ *  cached need no new_pages() or remove_pages() at all.
+ *
+ *  A thread leaves array->data[] when it exits, but its tcb stays in the tid
+ *  index until it is joined. The tid index is a hash table chained through
+ *  tcb->tid_next. Since tids are assigned in sequence, tid & (num_buckets-1)
+ *  spreads them evenly, and the table is doubled whenever there are more 
+ *  tcbs than buckets. So arraytcb_find_thread() is O(1), and nothing is 
+ *  allocated when a thread exits or is joined.
  *
  *  @author Ke Wu <kewu@andrew.cmu.edu>
  *  @bug no known bug
@@ -18,6 +30,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <simics.h>
 
 #include <cond.h>
@@ -29,7 +42,7 @@ static struct arraytcb_s *array;
 
 /** @brief Initialize arraytcb data structure
  *  
- *  @param size The initial size of arraytcb
+ *  @param size The initial size of arraytcb, must be a power of 2
  *
  *  @return On success return 0, on error return -1
  *
@@ -43,11 +56,18 @@ int arraytcb_init(int size) {
     array->maxsize = size;
     array->cursize = 0;
     array->data = calloc(size, sizeof(tcb_t*));
+    array->avail_slots = malloc(size * sizeof(int));
+    array->num_avail = 0;
+    array->cached_slots = malloc(size * sizeof(int));
+    array->num_cached = 0;
+    array->is_cached = calloc(size, sizeof(char));
+    array->num_buckets = size;
+    array->num_tids = 0;
+    array->tid_buckets = calloc(size, sizeof(tcb_t*));
 
-    array->avail_list = malloc(sizeof(availnode_t));
-    if (!array->avail_list)
+    if (!array->data || !array->avail_slots || !array->cached_slots ||
+        !array->is_cached || !array->tid_buckets)
         return -1;
-    array->avail_list->next = NULL;
     return 0;
 }
 
@@ -61,27 +81,78 @@ int arraytcb_init(int size) {
 static int double_array() {
     int newsize = array->maxsize * 2;
     tcb_t** newdata = calloc(newsize, sizeof(tcb_t*));
-    if (!newdata)
+    int *newavail = malloc(newsize * sizeof(int));
+    int *newcached = malloc(newsize * sizeof(int));
+    char *newis_cached = calloc(newsize, sizeof(char));
+    if (!newdata || !newavail || !newcached || !newis_cached) {
+        free(newdata);
+        free(newavail);
+        free(newcached);
+        free(newis_cached);
         return -1;
+    }
     
     int i;
-    for (i = 0; i < array->cursize; i++)
+    for (i = 0; i < array->cursize; i++) {
         newdata[i] = array->data[i];
+        newis_cached[i] = array->is_cached[i];
+    }
+    for (i = 0; i < array->num_avail; i++)
+        newavail[i] = array->avail_slots[i];
+    for (i = 0; i < array->num_cached; i++)
+        newcached[i] = array->cached_slots[i];
 
     array->maxsize = newsize;
     free(array->data);
+    free(array->avail_slots);
+    free(array->cached_slots);
+    free(array->is_cached);
     array->data = newdata;
+    array->avail_slots = newavail;
+    array->cached_slots = newcached;
+    array->is_cached = newis_cached;
 
     return 0;
 }
 
+/** @brief Double the number of buckets of the tid index
+ *
+ *  When array->num_tids exceeds array->num_buckets, this function will be 
+ *  invoked to keep the buckets short. If memory runs out, the index keeps
+ *  working with longer buckets.
+ *
+ *  @return void
+ */
+static void double_tid_index() {
+    int newsize = array->num_buckets * 2;
+    tcb_t** newbuckets = calloc(newsize, sizeof(tcb_t*));
+    if (!newbuckets)
+        return;
+
+    int i;
+    for (i = 0; i < array->num_buckets; i++) {
+        tcb_t *thr = array->tid_buckets[i];
+        while (thr) {
+            tcb_t *next = thr->tid_next;
+            thr->tid_next = newbuckets[thr->tid & (newsize - 1)];
+            newbuckets[thr->tid & (newsize - 1)] = thr;
+            thr = next;
+        }
+    }
+
+    free(array->tid_buckets);
+    array->tid_buckets = newbuckets;
+    array->num_buckets = newsize;
+}
+
 /** @brief Insert a thread (indicated by tid) to arraytcb
  *  
  *  It will instantiate a tcb structure for the new thread and try to insert it
- *  to arraytcb. Then the program will check if there is any existing stack 
- *  'slot' that is available by looking at array->avail_list, if not it will 
- *  allocate a new stack 'slot' for the thread. double_array() will be invoked 
- *  if there is no more space in arraytcb for new thread. 
+ *  to arraytcb and the tid index. Then the program will check if there is any
+ *  existing stack 'slot' that is available by looking at array->cached_slots
+ *  and array->avail_slots, if not it will allocate a new stack 'slot' for the
+ *  thread. double_array() 
+ *  will be invoked if there is no more space in arraytcb for new thread. 
  *
  *  Note that although arraytcb will be locked when insert a new thread, only 
  *  the minimum amount of work is in critical section. Some expensive 
@@ -90,87 +161,99 @@ static int double_array() {
  *  @param tid The tid of the new thread that need to be inserted
  *  @param mutex_arraytcb The mutex to protect arraytcb data structure so that 
  *                        only one thread can access arraytcb at the same time.
+ *  @param is_stack_mapped Set to 1 if the stack of the slot is still mapped
+ *                         (it is from array->cached_slots), 0 if it must be
+ *                         allocated by the caller
  *
  *  @return On success return a non-negative number which is the index of the 
  *          stack 'slot' that is used for the new thread. On error -1 is 
  *          returned.
  *          
  */
-int arraytcb_insert_thread(int tid, mutex_t *mutex_arraytcb) {
+int arraytcb_insert_thread(int tid, mutex_t *mutex_arraytcb,
+                           int *is_stack_mapped) {
     // instantiate a tcb structure for the new thread
     tcb_t* new_thread = malloc(sizeof(tcb_t));
     if (!new_thread)
         return -1;
+    memset(new_thread, 0, sizeof(tcb_t));
+    new_thread->self = new_thread;
     new_thread->tid = tid;
     new_thread->state = RUNNING;
+    new_thread->is_joined = 0;
+    new_thread->is_detached = 0;
+    new_thread->exit_status = NULL;
     cond_init(&new_thread->cond_var);
 
     mutex_lock(mutex_arraytcb);
 
-    // check if there is any existing stack 'slot' that is available
-    if (array->avail_list->next) {
-        // using an existing available stack 'slot' from array->avail_list
-        availnode_t *tmp = array->avail_list->next;
-        array->avail_list->next = array->avail_list->next->next;
-        int index = tmp->index;
-        array->data[index] = new_thread;
-        
-        mutex_unlock(mutex_arraytcb);
-
-        free(tmp);
-        return index;
+    int index;
+    *is_stack_mapped = 0;
+    if (array->num_cached > 0) {
+        // reuse a slot whose stack is still mapped
+        index = array->cached_slots[--array->num_cached];
+        array->is_cached[index] = 0;
+        *is_stack_mapped = 1;
+    } else if (array->num_avail > 0) {
+        // using an existing available stack 'slot' from array->avail_slots
+        index = array->avail_slots[--array->num_avail];
     } else {
         // no available exisiting stack 'slot', allocate a new stack 'slot'
         if (array->cursize == array->maxsize){
-            if (double_array(array) < 0) {
+            if (double_array() < 0) {
+                mutex_unlock(mutex_arraytcb);
+                cond_destroy(&new_thread->cond_var);
                 free(new_thread);
                 return -1;
             }
         }
+        index = array->cursize++;
+    }
+    array->data[index] = new_thread;
+    new_thread->index = index;
 
-        int index = array->cursize++;
-        array->data[index] = new_thread;
-        
-        mutex_unlock(mutex_arraytcb);
+    // put the tcb to the tid index
+    if (++array->num_tids > array->num_buckets)
+        double_tid_index();
+    int bucket = tid & (array->num_buckets - 1);
+    new_thread->tid_next = array->tid_buckets[bucket];
+    array->tid_buckets[bucket] = new_thread;
 
-        return index;
-    }
+    mutex_unlock(mutex_arraytcb);
+
+    return index;
 }
 
 /** @brief Delete a thread from arraytcb
  *  
  *  After deletion, the stack 'slot' that belonged to the deleted thread becomes 
- *  available for other threads to use. The program will insert the index of 
- *  the stack to array->avail_list so that the next time 
- *  arraytcb_insert_thread() can find this available stack is O(1) time.
+ *  available for other threads to use. If there are less than max_cached 
+ *  cached slots, the program will push the index of the stack to 
+ *  array->cached_slots and the stack should be kept mapped, otherwise to
+ *  array->avail_slots and the stack should be removed by the caller. Either
+ *  way the next time arraytcb_insert_thread() can find this available stack
+ *  in O(1) time. The tcb itself stays in the tid index until 
+ *  arraytcb_remove_thread().
  *
  *  This function should be invoked() when arraytcb is locked.
  *  
  *  @param index The stack index for the thread that need to be deleted
+ *  @param max_cached The maximum number of cached slots
  *
- *  @return On success return 0, on error return -1
+ *  @return Return 1 if the stack is cached, 0 if the stack should be removed,
+ *          on error return -1
  *
  */
-int arraytcb_delete_thread(int index) {
+int arraytcb_delete_thread(int index, int max_cached) {
     if (array->data[index]){
-        tcb_t *thr = array->data[index];
         array->data[index] = NULL;
-
-        cond_destroy(&thr->cond_var);
-        free(thr);
-
-        availnode_t *tmp = malloc(sizeof(availnode_t));
-        while (!tmp) {
-            lprintf("malloc failed, will try again...");
-            printf("malloc failed, will try again...\n");
-            yield(-1);
-            tmp = malloc(sizeof(availnode_t));
+        // both stacks have room for every slot, so they never overflow
+        if (array->num_cached < max_cached) {
+            array->cached_slots[array->num_cached++] = index;
+            array->is_cached[index] = 1;
+            return 1;
         }
-        tmp->index = index;
-
-        tmp->next = array->avail_list->next;
-        array->avail_list->next = tmp;
-
+        array->avail_slots[array->num_avail++] = index;
         return 0;
     } else{
         return -1;
@@ -204,11 +287,28 @@ tcb_t* arraytcb_get_thread(int index) {
  *
  */
 tcb_t* arraytcb_find_thread(int tid) {
-    int i;
-    for (i = 0; i < array->cursize; i++)
-       if (array->data[i] && array->data[i]->tid == tid)
-            return array->data[i];
-    return NULL; 
+    tcb_t *thr = array->tid_buckets[tid & (array->num_buckets - 1)];
+    while (thr && thr->tid != tid)
+        thr = thr->tid_next;
+    return thr;
+}
+
+/** @brief Remove a joined thread from the tid index
+ *
+ *  After this, the tcb can be destroyed by the caller.
+ *
+ *  This function should be invoked() when arraytcb is locked.
+ *  
+ *  @param thr The tcb structure of the thread, it must be in the tid index
+ *
+ *  @return void
+ */
+void arraytcb_remove_thread(tcb_t *thr) {
+    tcb_t **link = &array->tid_buckets[thr->tid & (array->num_buckets - 1)];
+    while (*link != thr)
+        link = &(*link)->tid_next;
+    *link = thr->tid_next;
+    array->num_tids--;
 }
 
 /** @brief Set ktid to the tcb structure specified by index
@@ -236,12 +336,20 @@ int arraytcb_set_ktid(int index, int ktid) {
  *
  */
 void arraytcb_free() {
-     int i;
-    for (i = 0; i < array->cursize; i++)
-        if (array->data[i]) {
-            cond_destroy(&array->data[i]->cond_var);
-            free(array->data[i]);
+    int i;
+    for (i = 0; i < array->num_buckets; i++) {
+        tcb_t *thr = array->tid_buckets[i];
+        while (thr) {
+            tcb_t *next = thr->tid_next;
+            cond_destroy(&thr->cond_var);
+            free(thr);
+            thr = next;
         }
+    }
+    free(array->tid_buckets);
+    free(array->cached_slots);
+    free(array->is_cached);
+    free(array->avail_slots);
     free(array->data);
     free(array);
 }
@@ -260,3 +368,18 @@ int arraytcb_is_valid(int index) {
     }
 }
 
+/** @brief Check if the stack of a slot is in use
+ *
+ *  The stack of a slot is in use if a thread is running on it, or it is kept
+ *  mapped in the stack cache. Pages shared with such a slot can not be 
+ *  removed.
+ *
+ *  This function should be invoked() when arraytcb is locked.
+ *  
+ *  @param index The index to check, must be within the boundary
+ *
+ *  @return Return 1 if the stack is in use, 0 if not
+ */
+int arraytcb_is_stack_in_use(int index) {
+    return array->data[index] != NULL || array->is_cached[index];
+}
@@ -9,33 +9,51 @@
 #ifndef _ARRAYTCB_H_
 #define _ARRAYTCB_H_
 
+#include <mutex_type.h>
 #include <cond_type.h>
+#include <thr_internals.h>
 
 /** @brief Thread state */
 typedef enum {
     RUNNING,
-    JOINED
+    EXITED
 } thr_state_t;
 
-/** @brief Thread control block struct */
-typedef struct {
+/** @brief Thread control block struct
+ *
+ *  A tcb is created by thr_create() and lives until the thread is joined,
+ *  so that its exit status can be kept in it after the thread exits.
+ *
+ *  The tcb is also the TLS block of the thread, its address is the TLS base
+ *  of the thread, see asm_get_tls().
+ */
+typedef struct tcb_s {
+    /** @brief Points to the tcb itself, must be the first field */
+    struct tcb_s *self;
+    /** @brief Index of the stack 'slot' of the thread */
+    int index;
     /** @brief Kernel assigned thread id */
     int ktid;
     /** @brief Thread lib assigned thread id */
     int tid;
     /** @brief Thread state */
     thr_state_t state;
+    /** @brief If some thread has called thr_join() on this thread */
+    int is_joined;
+    /** @brief If the tcb is reclaimed without a join, see thr_detach() */
+    int is_detached;
+    /** @brief Exit status, valid when state is EXITED */
+    void *exit_status;
     /** @brief Condition variable that belongs to the thread */
     cond_t cond_var;
+    /** @brief Next tcb in the same bucket of the tid index */
+    struct tcb_s *tid_next;
+    /** @brief Thread specific data, indexed by keys of thr_key_create() */
+    void *specific[THR_TLS_KEYS];
 } tcb_t;
 
-/** @brief The node type of array->avail_list */
-typedef struct availnode_s {
-    /** @brief Pointer to next node */
-    struct availnode_s *next;
-    /** @brief Which stack 'slot' is available (not used by any thread) */
-    int index;
-} availnode_t;
+/** @brief Get the tcb of the calling thread */
+#define THR_SELF() ((tcb_t *)asm_get_tls())
 
 /** @brief The data structure of arraytcb */
 struct arraytcb_s {
@@ -48,27 +66,50 @@ struct arraytcb_s {
     int cursize;
     /** @brief Where the actual tcb data is stored */
     tcb_t** data;
-    /** @brief A linked list that stores all available (not used by any
-     * thread) stack 'slot'
+    /** @brief A stack that stores all available (not used by any thread)
+     *  stack 'slot', it has room for maxsize slots
      */
-    availnode_t *avail_list;
+    int *avail_slots;
+    /** @brief Number of slots in avail_slots */
+    int num_avail;
+    /** @brief A stack that stores available stack 'slot' whose stack is 
+     *  still mapped, it has room for maxsize slots
+     */
+    int *cached_slots;
+    /** @brief Number of slots in cached_slots */
+    int num_cached;
+    /** @brief is_cached[i] is set if slot i is in cached_slots */
+    char *is_cached;
+    /** @brief Buckets of the tid index, a tcb is in bucket 
+     *  (tid & (num_buckets - 1)) from thr_create() until it is joined
+     */
+    tcb_t** tid_buckets;
+    /** @brief Number of buckets of the tid index, a power of 2 */
+    int num_buckets;
+    /** @brief Number of tcbs in the tid index */
+    int num_tids;
 };
 
 int arraytcb_init(int size);
 
-int arraytcb_insert_thread(int tid, mutex_t *mutex_arraytcb);
+int arraytcb_insert_thread(int tid, mutex_t *mutex_arraytcb,
+                           int *is_stack_mapped);
 
-int arraytcb_delete_thread(int index);
+int arraytcb_delete_thread(int index, int max_cached);
 
 tcb_t* arraytcb_get_thread(int index);
 
 tcb_t* arraytcb_find_thread(int tid);
 
+void arraytcb_remove_thread(tcb_t *thr);
+
 int arraytcb_set_ktid(int index, int ktid);
 
 void arraytcb_free();
 
 int arraytcb_is_valid(int index);
 
+int arraytcb_is_stack_in_use(int index);
+
 #endif
 
@@ -0,0 +1,121 @@
+/** @file barrier.c
+ *
+ *  @brief This file contains implementation of sense-reversing barriers
+ *
+ *  A barrier makes num_threads threads wait for each other, phase after
+ *  phase. Every thread reads the current sense before it arrives, and waits
+ *  until the sense is flipped. Arrival is a lock xadd on count, so threads do
+ *  not contend on a lock to arrive. The last thread to arrive resets count
+ *  for the next phase before it flips the sense, so a fast thread may enter
+ *  the next phase right away and never sees a stale count.
+ *
+ *  A waiting thread first spins on the sense for a while, yielding between
+ *  checks so that the threads that have not arrived can run. If the phase
+ *  is still not over, it blocks on the condition variable. The last thread
+ *  flips the sense with the mutex held, so a thread checking the sense with
+ *  the mutex held can not miss the broadcast.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <barrier.h>
+#include <mutex.h>
+#include <cond.h>
+#include <syscall.h>
+#include <assert.h>
+#include <thr_internals.h>
+
+/** @brief Number of times a thread checks the sense before blocking */
+#define BARRIER_SPIN_NUM 16
+
+/** @brief Initialize barrier
+ *  
+ *  @param barrier The barrier to initialize
+ *  @param num_threads Number of threads that wait on the barrier in a phase
+ *
+ *  @return 0 on success; -1 on error
+ */
+int barrier_init(barrier_t *barrier, int num_threads) {
+    if (num_threads <= 0)
+        return -1;
+
+    if ((mutex_init(&barrier->mutex) < 0) ||
+            (cond_init(&barrier->cond) < 0)) {
+        return -1;
+    }
+
+    barrier->num_threads = num_threads;
+    barrier->count = num_threads;
+    barrier->sense = 0;
+
+    return 0;
+}
+
+/** @brief Wait until all threads of the barrier have arrived in this phase
+ *  
+ *  @param barrier The barrier to wait on
+ *
+ *  @return BARRIER_SERIAL_THREAD to exactly one thread of each phase (the
+ *          last one to arrive); 0 to the other threads
+ */
+int barrier_wait(barrier_t *barrier) {
+    int local_sense;
+    int i;
+
+    if (barrier->num_threads < 0) {
+        panic("barrier %p has already been destroied!", barrier);
+    }
+
+    // The sense can not flip before this thread arrives
+    local_sense = !barrier->sense;
+
+    if (asm_xadd((int *)&barrier->count, -1) == 1) {
+        // Last to arrive, start the next phase and release everyone
+        barrier->count = barrier->num_threads;
+        mutex_lock(&barrier->mutex);
+        asm_xchg((int *)&barrier->sense, local_sense);
+        mutex_unlock(&barrier->mutex);
+        cond_broadcast(&barrier->cond);
+        return BARRIER_SERIAL_THREAD;
+    }
+
+    for (i = 0; i < BARRIER_SPIN_NUM; i++) {
+        if (barrier->sense == local_sense)
+            return 0;
+        yield(-1);
+    }
+
+    mutex_lock(&barrier->mutex);
+    while (barrier->sense != local_sense) {
+        cond_wait(&barrier->cond, &barrier->mutex);
+    }
+    mutex_unlock(&barrier->mutex);
+
+    return 0;
+}
+
+/** @brief Deactivate a barrier
+ *
+ *  It is illegal to destroy a barrier while some thread is waiting on it
+ *  
+ *  @param barrier The barrier to deactivate
+ *
+ *  @return void
+ */
+void barrier_destroy(barrier_t *barrier) {
+    if (barrier->num_threads < 0) {
+        panic("barrier %p has already been destroied!", barrier);
+    }
+    if (barrier->count != barrier->num_threads) {
+        panic("barrier %p is destroyed with %d threads waiting!", barrier,
+              barrier->num_threads - barrier->count);
+    }
+
+    barrier->num_threads = -1;
+
+    mutex_destroy(&barrier->mutex);
+    cond_destroy(&barrier->cond);
+}
@@ -2,11 +2,24 @@
  *  @brief This file contains the implementation of condition varaible
  *
  *  cond_t contains the following fields
- *     1. mutex: a mutex to protect critical section of condition varaible code.
- *     2. deque: a double-ended queue to store the threads that are blocking on
- *        the condition varaible. The queue is FIFO so first blocked thread will
+ *     1. is_destroyed: a flag indicating if the condition variable is 
+ *        destroied.
+ *     2. inner_lock: a spinlock to protect critical section of condition 
+ *        varaible code. The critical sections only manipulate the queue, so
+ *        they are guaranteed to be short.
+ *     3. waiters: a queue to store the threads that are blocking on the
+ *        condition varaible. The queue is FIFO so first blocked thread will
  *        get be signaled first.
  *
+ *  A waiting thread puts a node allocated on its own stack in the queue. 
+ *  Because the stack of cond_wait() will not be destroied until the thread is
+ *  signaled, it is safe, and no malloc() is needed.
+ *
+ *  Threads are made runnable after inner_lock is released. cond_broadcast() 
+ *  detaches the whole queue at once, so it holds inner_lock only for a 
+ *  constant time no matter how many threads are waiting, and then wakes them
+ *  up in batches with make_runnable_many().
+ *
  *  @author Ke Wu (kewu)
  *
  *  @bug No known bugs.
@@ -14,13 +27,27 @@
 #include <mutex.h>
 #include <thread.h>
 #include <syscall.h>
+#include <syscall_int.h>
 #include <cond_type.h>
 #include <stdlib.h>
-#include <queue.h>
 #include <stdio.h>
 #include <thr_internals.h>
 #include <simics.h>
 
+/** @brief Wake up a thread that has been removed from the waiting queue
+ *  
+ *  @param node The node of the thread to wake up
+ *
+ *  @return void
+ */
+static void cond_wakeup(cond_node_t *node) {
+    // node is on the stack of the waiting thread, read ktid before setting 
+    // reject
+    int ktid = node->ktid;
+    node->reject = 1;
+    make_runnable(ktid);
+}
+
 /** @brief Initialize condition variable
  *  
  *  @param cv Condition variable to initialize
@@ -28,11 +55,11 @@
  *  @return 0 on success; -1 on error
  */
 int cond_init(cond_t *cv) {
-    int is_error = 0;
-    is_error |= mutex_init(&cv->mutex);
-    is_error |= queue_init(&cv->deque);
+    cv->is_destroyed = 0;
+    SPINLOCK_INIT(&cv->inner_lock);
+    Q_INIT_HEAD(&cv->waiters);
 
-    return is_error ? -1 : 0;
+    return 0;
 }
 
 /** @brief Destory condition variable
@@ -42,28 +69,27 @@ int cond_init(cond_t *cv) {
  *  @return void
  */
 void cond_destroy(cond_t *cv) {
-    mutex_lock(&cv->mutex);
+    SPINLOCK_LOCK(&cv->inner_lock);
 
-    if (!queue_is_active(&cv->deque)) {
+    if (cv->is_destroyed) {
         // try to destory a destroied cond_var
         panic("condition variable %p has already been destroied!", cv);
     }
 
-    while (queue_destroy(&cv->deque) < 0) {
+    while (Q_GET_FRONT(&cv->waiters) != NULL) {
         // illegal, some threads are blocked waiting on it
         lprintf("Destroy condition variable %p failed, "
                 "some threads are blocking on it, will try again...", cv);
         printf("Destroy condition variable %p failed, "
                 "some threads are blocking on it, will try again...\n", cv);
-        mutex_unlock(&cv->mutex);
+        SPINLOCK_UNLOCK(&cv->inner_lock);
         yield(-1);
-        mutex_lock(&cv->mutex);
+        SPINLOCK_LOCK(&cv->inner_lock);
     }
 
-    mutex_unlock(&cv->mutex);
-
-    mutex_destroy(&cv->mutex);
+    cv->is_destroyed = 1;
 
+    SPINLOCK_UNLOCK(&cv->inner_lock);
 }
 
 /** @brief Allows a thread to wait for a condition
@@ -74,39 +100,33 @@ void cond_destroy(cond_t *cv) {
  *  @return void
  */
 void cond_wait(cond_t *cv, mutex_t *mp) {
-    // first allocate node for queue
-    node_t *tmp = malloc(sizeof(node_t));
-    while (!tmp) {
-        lprintf("malloc failed, will try again...");
-        printf("malloc failed, will try again...\n");
-        yield(-1);
-        tmp = malloc(sizeof(node_t));
-    }
-    tmp->ktid = thr_getktid();
-    tmp->reject = 0;
+    cond_node_t node;
+    node.ktid = thr_getktid();
+    node.reject = 0;
 
-    mutex_lock(&cv->mutex);
+    SPINLOCK_LOCK(&cv->inner_lock);
 
-    if (!queue_is_active(&cv->deque)) {
+    if (cv->is_destroyed) {
         // try to wait on a destroied cond_var
         panic("condition variable %p has already been destroied!", cv);
     }
 
-    enqueue(&cv->deque, tmp);
+    Q_INSERT_TAIL(&cv->waiters, &node, link);
 
+    SPINLOCK_UNLOCK(&cv->inner_lock);
+
+    // the node is already in the queue, so a signal that comes after mp is
+    // unlocked will not be missed
     mutex_unlock(mp);
 
-    mutex_unlock(&cv->mutex);
     // The while loop is used to guard against inproper "wake ups", reject is 
     // used to indicate if the thread has been dequeued by others
-    while(!tmp->reject) {
-        if (deschedule(&tmp->reject) < 0) {
+    while(!node.reject) {
+        if (deschedule(&node.reject) < 0) {
             panic("deschedule error of condition variable %p", cv);
         }
     }
 
-    free(tmp);
-
     mutex_lock(mp);
 }
 
@@ -117,49 +137,66 @@ void cond_wait(cond_t *cv, mutex_t *mp) {
  *  @return void
  */
 void cond_signal(cond_t *cv) {
-    mutex_lock(&cv->mutex);
+    SPINLOCK_LOCK(&cv->inner_lock);
 
-    if (!queue_is_active(&cv->deque)) {
+    if (cv->is_destroyed) {
         // try to singal a destroied cond_var
         panic("condition variable %p has already been destroied!", cv);
     }
 
-    node_t *tmp = dequeue(&cv->deque);
-    if (tmp) {
+    cond_node_t *node = Q_GET_FRONT(&cv->waiters);
+    if (node) 
+        Q_REMOVE(&cv->waiters, node, link);
+
+    SPINLOCK_UNLOCK(&cv->inner_lock);
+
+    if (node) {
         // if some threads are waiting on the condition varaible, awaken the 
         // thread in the head of the queue
-        int tmp_ktid = tmp->ktid;
-        tmp->reject = 1;
-        make_runnable(tmp_ktid);
+        cond_wakeup(node);
     }
-    mutex_unlock(&cv->mutex);
 }
 
 /** @brief Wake up all threads waiting on the condition variable
  *  
  *  This function will not awaken threads that may invoke cond_wait(cv)
- *  after this call has begun execution, because cond_broadcast(cv) and
- *  cond_broadcast(cv) are guarded by the same mutex cv->mutex on entry.
+ *  after this call has begun execution, because the whole queue is detached
+ *  from cv at once with cv->inner_lock held.
  *
  *  @param cv Condition variable that threads may wait on
  *  
  *  @return void
  */
 void cond_broadcast(cond_t *cv) {
-    mutex_lock(&cv->mutex);
+    SPINLOCK_LOCK(&cv->inner_lock);
 
-    if (!queue_is_active(&cv->deque)) {
+    if (cv->is_destroyed) {
         // try to singal a destroied cond_var
         panic("condition variable %p has already been destroied!", cv);
     }
 
-    node_t *tmp = dequeue(&cv->deque);
-    while (tmp) {
-        int tmp_ktid = tmp->ktid;
-        tmp->reject = 1;
-        make_runnable(tmp_ktid);
-        tmp = dequeue(&cv->deque);
+    cond_queue_t batch = cv->waiters;
+    Q_INIT_HEAD(&cv->waiters);
+
+    SPINLOCK_UNLOCK(&cv->inner_lock);
+
+    int ktids[MAKE_RUNNABLE_MANY_MAX];
+    int n = 0;
+    cond_node_t *node = Q_GET_FRONT(&batch);
+    while (node) {
+        // get next node and ktid before setting reject, after which the 
+        // thread may go on and its stack may be reused
+        cond_node_t *next = Q_GET_NEXT(node, link);
+        ktids[n++] = node->ktid;
+        node->reject = 1;
+
+        if (n == MAKE_RUNNABLE_MANY_MAX) {
+            make_runnable_many(ktids, n);
+            n = 0;
+        }
+        node = next;
     }
-    mutex_unlock(&cv->mutex);
-}
 
+    if (n > 0)
+        make_runnable_many(ktids, n);
+}
@@ -0,0 +1,121 @@
+/** @file latch.c
+ *
+ *  @brief This file contains implementation of latches
+ *
+ *  A latch is a single use countdown event: it is initialized with a count,
+ *  every latch_count_down() decreases it by one, and latch_wait() blocks
+ *  until it reaches 0. The count is changed with lock cmpxchg so that a
+ *  count down never takes a lock unless it opens the latch, and a waiter
+ *  never takes a lock once the latch is open. The thread that opens the
+ *  latch broadcasts with the mutex held, so a waiter checking the count with
+ *  the mutex held can not miss the broadcast.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <latch.h>
+#include <mutex.h>
+#include <cond.h>
+#include <assert.h>
+#include <thr_internals.h>
+
+/** @brief Initialize latch
+ *  
+ *  @param latch The latch to initialize
+ *  @param count Number of latch_count_down() calls that open the latch
+ *
+ *  @return 0 on success; -1 on error
+ */
+int latch_init(latch_t *latch, int count) {
+    if (count < 0)
+        return -1;
+
+    if ((mutex_init(&latch->mutex) < 0) ||
+            (cond_init(&latch->cond) < 0)) {
+        return -1;
+    }
+
+    latch->count = count;
+
+    return 0;
+}
+
+/** @brief Decrement the count of a latch, wake up all waiters if it is 0
+ *
+ *  Counting down an open latch has no effect
+ *  
+ *  @param latch The latch to count down
+ *
+ *  @return void
+ */
+void latch_count_down(latch_t *latch) {
+    int count;
+
+    do {
+        count = latch->count;
+        if (count < 0) {
+            panic("latch %p has already been destroied!", latch);
+        }
+        if (count == 0)
+            return;
+    } while (asm_cmpxchg((int *)&latch->count, count, count - 1) != count);
+
+    if (count == 1) {
+        mutex_lock(&latch->mutex);
+        mutex_unlock(&latch->mutex);
+        cond_broadcast(&latch->cond);
+    }
+}
+
+/** @brief Block until the latch is open
+ *  
+ *  @param latch The latch to wait on
+ *
+ *  @return void
+ */
+void latch_wait(latch_t *latch) {
+    if (latch->count == 0)
+        return;
+
+    mutex_lock(&latch->mutex);
+    while (latch->count > 0) {
+        cond_wait(&latch->cond, &latch->mutex);
+    }
+    if (latch->count < 0) {
+        panic("latch %p has already been destroied!", latch);
+    }
+    mutex_unlock(&latch->mutex);
+}
+
+/** @brief Check if the latch is open without blocking
+ *  
+ *  @param latch The latch to check
+ *
+ *  @return 1 if the latch is open; 0 if not
+ */
+int latch_try_wait(latch_t *latch) {
+    if (latch->count < 0) {
+        panic("latch %p has already been destroied!", latch);
+    }
+    return latch->count == 0;
+}
+
+/** @brief Deactivate a latch
+ *
+ *  It is illegal to destroy a latch while some thread is waiting on it
+ *  
+ *  @param latch The latch to deactivate
+ *
+ *  @return void
+ */
+void latch_destroy(latch_t *latch) {
+    if (asm_xchg((int *)&latch->count, -1) < 0) {
+        panic("latch %p has already been destroied!", latch);
+    }
+
+    mutex_destroy(&latch->mutex);
+    cond_destroy(&latch->cond);
+}
@@ -0,0 +1,473 @@
+/** @file lfqueue.c
+ *  @brief This file contains the implementation of lock-free queues
+ *
+ *  mpmc_queue_t is a bounded queue in the style of Dmitry Vyukov. Every cell
+ *  has a sequence number. A cell at position pos is free for the push of
+ *  that position when seq == pos, and holds the item for the pop of that
+ *  position when seq == pos + 1. A producer claims a position by a cmpxchg
+ *  on push_pos, stores the item and then publishes it by setting seq, so
+ *  producers and consumers only contend on push_pos and pop_pos and never
+ *  wait for each other unless the queue is full or empty.
+ *
+ *  spsc_ring_t is a ring for exactly one producer and one consumer. The
+ *  producer only writes tail and the consumer only writes head, and stores
+ *  are not reordered with other stores or older loads on x86, so neither
+ *  side needs an atomic instruction.
+ *
+ *  The blocking functions first try the lock-free operation, and only park
+ *  in a waitset when the queue is full (push) or empty (pop). A parked
+ *  thread increases num_waiters before trying again with the mutex of the
+ *  waitset held. A thread that pushes or pops an item checks num_waiters of
+ *  the other side with lock xadd, which is a full fence, so either the
+ *  parked thread sees the item or the other thread sees it is parked and
+ *  signals it after taking the mutex. Nothing is locked when nobody parks.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <mutex.h>
+#include <cond.h>
+#include <lfqueue.h>
+#include <thr_internals.h>
+
+/** @brief Initialize a waitset
+ *
+ *  @param waitset The waitset
+ *
+ *  @return 0 on success; -1 on error
+ */
+static int waitset_init(lfq_waitset_t *waitset) {
+    waitset->num_waiters = 0;
+    if (mutex_init(&waitset->mutex) < 0)
+        return -1;
+    if (cond_init(&waitset->cond) < 0) {
+        mutex_destroy(&waitset->mutex);
+        return -1;
+    }
+    return 0;
+}
+
+/** @brief Deactivate a waitset
+ *
+ *  @param waitset The waitset
+ *
+ *  @return void
+ */
+static void waitset_destroy(lfq_waitset_t *waitset) {
+    if (waitset->num_waiters != 0) {
+        panic("queue is destroyed with %d threads blocked on it!",
+              waitset->num_waiters);
+    }
+    mutex_destroy(&waitset->mutex);
+    cond_destroy(&waitset->cond);
+}
+
+/** @brief Park until an operation on a queue succeeds
+ *
+ *  @param waitset The waitset to park in
+ *  @param op The lock-free operation, returns 0 on success, -1 on failure
+ *  @param queue The queue to operate on
+ *  @param item The item to push, or where to store the popped item
+ *
+ *  @return void
+ */
+static void waitset_wait(lfq_waitset_t *waitset, 
+                         int (*op)(void *, void **), void *queue, 
+                         void **item) {
+    mutex_lock(&waitset->mutex);
+    asm_xadd((int *)&waitset->num_waiters, 1);
+    while (op(queue, item) < 0)
+        cond_wait(&waitset->cond, &waitset->mutex);
+    asm_xadd((int *)&waitset->num_waiters, -1);
+    mutex_unlock(&waitset->mutex);
+}
+
+/** @brief Wake up a thread parked in a waitset, if any
+ *
+ *  Must be called after an operation succeeds, without the mutex of any
+ *  waitset held.
+ *
+ *  @param waitset The waitset
+ *
+ *  @return void
+ */
+static void waitset_wake(lfq_waitset_t *waitset) {
+    // lock xadd orders the operation before reading num_waiters
+    if (asm_xadd((int *)&waitset->num_waiters, 0) > 0) {
+        mutex_lock(&waitset->mutex);
+        mutex_unlock(&waitset->mutex);
+        cond_signal(&waitset->cond);
+    }
+}
+
+/** @brief Check if a capacity is a power of 2 and at least 2
+ *
+ *  @param capacity The capacity
+ *
+ *  @return 1 if it is valid; 0 if not
+ */
+static int is_valid_capacity(int capacity) {
+    return capacity >= 2 && (capacity & (capacity - 1)) == 0;
+}
+
+/** @brief Initialize a MPMC queue
+ *
+ *  @param queue The queue
+ *  @param capacity Maximum number of items, must be a power of 2
+ *
+ *  @return 0 on success; -1 on error
+ */
+int mpmc_init(mpmc_queue_t *queue, int capacity) {
+    int i;
+
+    if (!queue || !is_valid_capacity(capacity))
+        return -1;
+
+    queue->cells = malloc(capacity * sizeof(mpmc_cell_t));
+    if (!queue->cells)
+        return -1;
+    for (i = 0; i < capacity; i++)
+        queue->cells[i].seq = i;
+
+    queue->mask = capacity - 1;
+    queue->push_pos = 0;
+    queue->pop_pos = 0;
+
+    if (waitset_init(&queue->not_empty) < 0) {
+        free(queue->cells);
+        return -1;
+    }
+    if (waitset_init(&queue->not_full) < 0) {
+        waitset_destroy(&queue->not_empty);
+        free(queue->cells);
+        return -1;
+    }
+    return 0;
+}
+
+/** @brief Deactivate a MPMC queue, items left in it are dropped
+ *
+ *  @param queue The queue
+ *
+ *  @return void
+ */
+void mpmc_destroy(mpmc_queue_t *queue) {
+    waitset_destroy(&queue->not_empty);
+    waitset_destroy(&queue->not_full);
+    free(queue->cells);
+    queue->cells = NULL;
+}
+
+/** @brief Push an item to a MPMC queue without waking up consumers
+ *
+ *  @param queue The queue
+ *  @param item The item
+ *
+ *  @return 0 on success; -1 if the queue is full
+ */
+static int mpmc_enqueue(mpmc_queue_t *queue, void *item) {
+    int pos = queue->push_pos;
+    mpmc_cell_t *cell;
+
+    while (1) {
+        cell = &queue->cells[pos & queue->mask];
+        int diff = (int)((unsigned)cell->seq - (unsigned)pos);
+        if (diff == 0) {
+            // the cell is free, try to claim the position
+            int old = asm_cmpxchg((int *)&queue->push_pos, pos, pos + 1);
+            if (old == pos)
+                break;
+            pos = old;
+        } else if (diff < 0) {
+            // the cell still holds the item of the last lap
+            return -1;
+        } else {
+            // another producer has claimed the position
+            pos = queue->push_pos;
+        }
+    }
+
+    cell->item = item;
+    // stores are not reordered on x86, consumers see the item before seq
+    cell->seq = pos + 1;
+    return 0;
+}
+
+/** @brief Pop an item from a MPMC queue without waking up producers
+ *
+ *  @param queue The queue
+ *  @param item Where to store the item
+ *
+ *  @return 0 on success; -1 if the queue is empty
+ */
+static int mpmc_dequeue(mpmc_queue_t *queue, void **item) {
+    int pos = queue->pop_pos;
+    mpmc_cell_t *cell;
+
+    while (1) {
+        cell = &queue->cells[pos & queue->mask];
+        int diff = (int)((unsigned)cell->seq - (unsigned)(pos + 1));
+        if (diff == 0) {
+            // the cell holds an item, try to claim the position
+            int old = asm_cmpxchg((int *)&queue->pop_pos, pos, pos + 1);
+            if (old == pos)
+                break;
+            pos = old;
+        } else if (diff < 0) {
+            // the item of the position is not pushed yet
+            return -1;
+        } else {
+            // another consumer has claimed the position
+            pos = queue->pop_pos;
+        }
+    }
+
+    *item = cell->item;
+    // free the cell for the push of the next lap
+    cell->seq = pos + queue->mask + 1;
+    return 0;
+}
+
+/** @brief mpmc_enqueue() for waitset_wait()
+ *
+ *  @param queue The queue
+ *  @param item Where the item is stored
+ *
+ *  @return 0 on success; -1 if the queue is full
+ */
+static int mpmc_push_op(void *queue, void **item) {
+    return mpmc_enqueue(queue, *item);
+}
+
+/** @brief mpmc_dequeue() for waitset_wait()
+ *
+ *  @param queue The queue
+ *  @param item Where to store the item
+ *
+ *  @return 0 on success; -1 if the queue is empty
+ */
+static int mpmc_pop_op(void *queue, void **item) {
+    return mpmc_dequeue(queue, item);
+}
+
+/** @brief Push an item to a MPMC queue if it is not full
+ *
+ *  @param queue The queue
+ *  @param item The item
+ *
+ *  @return 0 on success; -1 if the queue is full
+ */
+int mpmc_try_push(mpmc_queue_t *queue, void *item) {
+    if (mpmc_enqueue(queue, item) < 0)
+        return -1;
+    waitset_wake(&queue->not_empty);
+    return 0;
+}
+
+/** @brief Pop an item from a MPMC queue if it is not empty
+ *
+ *  @param queue The queue
+ *  @param item Where to store the item
+ *
+ *  @return 0 on success; -1 if the queue is empty
+ */
+int mpmc_try_pop(mpmc_queue_t *queue, void **item) {
+    if (mpmc_dequeue(queue, item) < 0)
+        return -1;
+    waitset_wake(&queue->not_full);
+    return 0;
+}
+
+/** @brief Push an item to a MPMC queue, block while it is full
+ *
+ *  @param queue The queue
+ *  @param item The item
+ *
+ *  @return void
+ */
+void mpmc_push(mpmc_queue_t *queue, void *item) {
+    if (mpmc_enqueue(queue, item) < 0)
+        waitset_wait(&queue->not_full, mpmc_push_op, queue, &item);
+    waitset_wake(&queue->not_empty);
+}
+
+/** @brief Pop an item from a MPMC queue, block while it is empty
+ *
+ *  @param queue The queue
+ *
+ *  @return The item
+ */
+void *mpmc_pop(mpmc_queue_t *queue) {
+    void *item;
+
+    if (mpmc_dequeue(queue, &item) < 0)
+        waitset_wait(&queue->not_empty, mpmc_pop_op, queue, &item);
+    waitset_wake(&queue->not_full);
+    return item;
+}
+
+/** @brief Initialize a SPSC ring
+ *
+ *  @param ring The ring
+ *  @param capacity Maximum number of items, must be a power of 2
+ *
+ *  @return 0 on success; -1 on error
+ */
+int spsc_init(spsc_ring_t *ring, int capacity) {
+    if (!ring || !is_valid_capacity(capacity))
+        return -1;
+
+    ring->items = malloc(capacity * sizeof(void *));
+    if (!ring->items)
+        return -1;
+
+    ring->mask = capacity - 1;
+    ring->tail = 0;
+    ring->head = 0;
+
+    if (waitset_init(&ring->not_empty) < 0) {
+        free((void *)ring->items);
+        return -1;
+    }
+    if (waitset_init(&ring->not_full) < 0) {
+        waitset_destroy(&ring->not_empty);
+        free((void *)ring->items);
+        return -1;
+    }
+    return 0;
+}
+
+/** @brief Deactivate a SPSC ring, items left in it are dropped
+ *
+ *  @param ring The ring
+ *
+ *  @return void
+ */
+void spsc_destroy(spsc_ring_t *ring) {
+    waitset_destroy(&ring->not_empty);
+    waitset_destroy(&ring->not_full);
+    free((void *)ring->items);
+    ring->items = NULL;
+}
+
+/** @brief Push an item to a SPSC ring without waking up the consumer
+ *
+ *  @param ring The ring
+ *  @param item The item
+ *
+ *  @return 0 on success; -1 if the ring is full
+ */
+static int spsc_enqueue(spsc_ring_t *ring, void *item) {
+    int tail = ring->tail;
+
+    if (tail - ring->head > ring->mask)
+        return -1;
+
+    ring->items[tail & ring->mask] = item;
+    // stores are not reordered on x86, the consumer sees the item first
+    ring->tail = tail + 1;
+    return 0;
+}
+
+/** @brief Pop an item from a SPSC ring without waking up the producer
+ *
+ *  @param ring The ring
+ *  @param item Where to store the item
+ *
+ *  @return 0 on success; -1 if the ring is empty
+ */
+static int spsc_dequeue(spsc_ring_t *ring, void **item) {
+    int head = ring->head;
+
+    if (head == ring->tail)
+        return -1;
+
+    *item = ring->items[head & ring->mask];
+    // the load of the item is not reordered with this store on x86
+    ring->head = head + 1;
+    return 0;
+}
+
+/** @brief spsc_enqueue() for waitset_wait()
+ *
+ *  @param ring The ring
+ *  @param item Where the item is stored
+ *
+ *  @return 0 on success; -1 if the ring is full
+ */
+static int spsc_push_op(void *ring, void **item) {
+    return spsc_enqueue(ring, *item);
+}
+
+/** @brief spsc_dequeue() for waitset_wait()
+ *
+ *  @param ring The ring
+ *  @param item Where to store the item
+ *
+ *  @return 0 on success; -1 if the ring is empty
+ */
+static int spsc_pop_op(void *ring, void **item) {
+    return spsc_dequeue(ring, item);
+}
+
+/** @brief Push an item to a SPSC ring if it is not full
+ *
+ *  @param ring The ring
+ *  @param item The item
+ *
+ *  @return 0 on success; -1 if the ring is full
+ */
+int spsc_try_push(spsc_ring_t *ring, void *item) {
+    if (spsc_enqueue(ring, item) < 0)
+        return -1;
+    waitset_wake(&ring->not_empty);
+    return 0;
+}
+
+/** @brief Pop an item from a SPSC ring if it is not empty
+ *
+ *  @param ring The ring
+ *  @param item Where to store the item
+ *
+ *  @return 0 on success; -1 if the ring is empty
+ */
+int spsc_try_pop(spsc_ring_t *ring, void **item) {
+    if (spsc_dequeue(ring, item) < 0)
+        return -1;
+    waitset_wake(&ring->not_full);
+    return 0;
+}
+
+/** @brief Push an item to a SPSC ring, block while it is full
+ *
+ *  @param ring The ring
+ *  @param item The item
+ *
+ *  @return void
+ */
+void spsc_push(spsc_ring_t *ring, void *item) {
+    if (spsc_enqueue(ring, item) < 0)
+        waitset_wait(&ring->not_full, spsc_push_op, ring, &item);
+    waitset_wake(&ring->not_empty);
+}
+
+/** @brief Pop an item from a SPSC ring, block while it is empty
+ *
+ *  @param ring The ring
+ *
+ *  @return The item
+ */
+void *spsc_pop(spsc_ring_t *ring) {
+    void *item;
+
+    if (spsc_dequeue(ring, &item) < 0)
+        waitset_wait(&ring->not_empty, spsc_pop_op, ring, &item);
+    waitset_wake(&ring->not_full);
+    return item;
+}
@@ -1,5 +1,30 @@
 /** @file malloc.c
- *  @brief Wrapper for malloc lib
+ *  @brief Thread-caching wrapper for malloc lib
+ *
+ *  The underlying _malloc()/_free() manage a single heap and are not thread
+ *  safe, so every call into them has to hold heap_lock. To keep threads from
+ *  serializing on that lock, small requests are served from size classes
+ *  instead:
+ *
+ *  1. Every thread has a thread cache, one free list per size class. The
+ *     cache is indexed by the stack position index of the thread, so no lock
+ *     is needed to use it: only the thread running on stack i touches cache
+ *     i. A thread that reuses the stack of an exited thread simply inherits
+ *     its cached blocks.
+ *  2. When a cache list is empty it is refilled with a batch of blocks from
+ *     one of NUM_ARENAS arenas (chosen by stack position index too), each
+ *     with its own lock. An arena carves its blocks out of SLAB_SIZE slabs
+ *     that it gets from the heap.
+ *  3. When a cache list is full, a batch of blocks is flushed back to the
+ *     arenas that own them. Blocks of the thread's own arena are put back
+ *     under its lock, blocks of other arenas are pushed to their lock-free
+ *     remote_frees stack, which is drained by the owner the next time it
+ *     runs out of blocks.
+ *
+ *  Requests larger than the largest size class go to the heap directly.
+ *  Every block starts with a BLOCK_HDR_SIZE header that records its size
+ *  class and its arena, so free() knows where to return it. Slabs are never
+ *  given back to the heap.
  *
  *  @author Ke Wu (kewu)
  *  @author Jian Wang (jianwan3)
@@ -10,38 +35,371 @@
 #include <stdlib.h>
 #include <types.h>
 #include <stddef.h>
+#include <string.h>
 
 #include <spinlock.h>
+#include <thr_lib_helper.h>
+#include <arraytcb.h>
+
+/** @brief Number of size classes */
+#define NUM_SIZE_CLASSES 7
+
+/** @brief log2 of the payload size of the smallest size class */
+#define MIN_CLASS_SHIFT 4
+
+/** @brief Payload size of the largest size class */
+#define MAX_CLASS_SIZE (1 << (MIN_CLASS_SHIFT + NUM_SIZE_CLASSES - 1))
+
+/** @brief Size class of blocks that are allocated from the heap directly */
+#define LARGE_CLASS (-1)
+
+/** @brief Number of arenas */
+#define NUM_ARENAS 4
+
+/** @brief Number of thread caches, threads on higher stack positions use
+ *         their arena directly */
+#define MAX_CACHED_THREADS 64
+
+/** @brief Maximum number of blocks of a size class in a thread cache */
+#define CACHE_MAX_BLOCKS 32
+
+/** @brief Number of blocks moved between a thread cache and an arena */
+#define CACHE_BATCH 8
+
+/** @brief Size of the chunk an arena gets from the heap at a time */
+#define SLAB_SIZE 8192
+
+/** @brief Size of the header in front of the payload of every block */
+#define BLOCK_HDR_SIZE offsetof(block_t, next)
+
+/** @brief Get the block of a payload */
+#define PAYLOAD_TO_BLOCK(buf) ((block_t*)((char*)(buf) - BLOCK_HDR_SIZE))
+
+/** @brief Get the payload of a block */
+#define BLOCK_TO_PAYLOAD(block) ((void*)((char*)(block) + BLOCK_HDR_SIZE))
 
-/** @brief Mutex to guard malloc library */
-spinlock_t mutex_malloc;
+/** @brief Block type */
+typedef struct block {
+    /** @brief Size class of the block, LARGE_CLASS if it is from the heap */
+    int size_class;
+    /** @brief The arena that the block belongs to */
+    int arena;
+    /** @brief Next free block, only valid when the block is free. It is the
+     *         first word of the payload */
+    struct block *next;
+} block_t;
+
+/** @brief Arena type */
+typedef struct arena {
+    /** @brief Lock to protect free_lists */
+    spinlock_t lock;
+    /** @brief Free blocks of each size class */
+    block_t *free_lists[NUM_SIZE_CLASSES];
+    /** @brief Blocks freed by threads of other arenas, a lock-free stack */
+    block_t *remote_frees;
+} arena_t;
+
+/** @brief Thread cache type */
+typedef struct thread_cache {
+    /** @brief Free blocks of each size class */
+    block_t *lists[NUM_SIZE_CLASSES];
+    /** @brief Number of blocks in each list */
+    int counts[NUM_SIZE_CLASSES];
+} thread_cache_t;
+
+/** @brief Lock to guard the heap, i.e. _malloc() and friends */
+static spinlock_t heap_lock;
+
+/** @brief Arenas */
+static arena_t arenas[NUM_ARENAS];
+
+/** @brief Thread caches, indexed by stack position index */
+static thread_cache_t thread_caches[MAX_CACHED_THREADS];
+
+/** @brief If the thread library has been initialized. Before that there is
+ *         only the root thread and stack position index can not be used */
+static int is_multithreaded;
 
 /** @brief Initialize malloc lib
- *  
+ *
  *  @return 0 on success
  */
 int malloc_init() {
-    SPINLOCK_INIT(&mutex_malloc);
+    int i;
+
+    SPINLOCK_INIT(&heap_lock);
+    for (i = 0; i < NUM_ARENAS; i++) {
+        SPINLOCK_INIT(&arenas[i].lock);
+    }
+    return 0;
+}
+
+/** @brief Tell malloc lib that the thread library has been initialized
+ *
+ *  From now on, thread caches are selected by the stack position index in 
+ *  the tcb of the calling thread.
+ *
+ *  @return void
+ */
+void malloc_thr_init() {
+    is_multithreaded = 1;
+}
+
+/** @brief Get the stack position index of the current thread
+ *
+ *  @return Stack position index of the current thread
+ */
+static int get_thread_index() {
+    return is_multithreaded ? THR_SELF()->index : 0;
+}
+
+/** @brief Get the size class of a request
+ *
+ *  @param size Size of the request, no more than MAX_CLASS_SIZE
+ *
+ *  @return The smallest size class that can hold size bytes
+ */
+static int get_size_class(size_t size) {
+    int size_class = 0;
+    while ((1 << (MIN_CLASS_SHIFT + size_class)) < size) {
+        size_class++;
+    }
+    return size_class;
+}
+
+/** @brief Get the payload size of a size class
+ *
+ *  @param size_class The size class
+ *
+ *  @return Payload size of the size class
+ */
+static size_t get_class_size(int size_class) {
+    return 1 << (MIN_CLASS_SHIFT + size_class);
+}
+
+/** @brief Put a block to the remote_frees stack of its arena
+ *
+ *  @param block The block to put
+ *
+ *  @return void
+ */
+static void remote_free(block_t *block) {
+    arena_t *arena = &arenas[block->arena];
+    block_t *head;
+
+    do {
+        head = arena->remote_frees;
+        block->next = head;
+    } while (asm_cmpxchg((int*)&arena->remote_frees, (int)head,
+                         (int)block) != (int)head);
+}
+
+/** @brief Move blocks of remote_frees stack of an arena to its free lists
+ *
+ *  This function should be invoked when the arena is locked.
+ *
+ *  @param arena The arena
+ *
+ *  @return void
+ */
+static void drain_remote_frees(arena_t *arena) {
+    block_t *block = (block_t*)asm_xchg((int*)&arena->remote_frees, 0);
+
+    while (block) {
+        block_t *next = block->next;
+        block->next = arena->free_lists[block->size_class];
+        arena->free_lists[block->size_class] = block;
+        block = next;
+    }
+}
+
+/** @brief Carve a new slab into blocks of a size class
+ *
+ *  This function should be invoked when the arena is locked.
+ *
+ *  @param arena_index The index of the arena
+ *  @param size_class The size class
+ *
+ *  @return 0 on success; -1 if the heap is out of memory
+ */
+static int carve_slab(int arena_index, int size_class) {
+    arena_t *arena = &arenas[arena_index];
+    size_t block_size = BLOCK_HDR_SIZE + get_class_size(size_class);
+
+    SPINLOCK_LOCK(&heap_lock);
+    char *slab = _malloc(SLAB_SIZE);
+    SPINLOCK_UNLOCK(&heap_lock);
+
+    if (!slab)
+        return -1;
+
+    char *cur;
+    for (cur = slab; cur + block_size <= slab + SLAB_SIZE;
+         cur += block_size) {
+        block_t *block = (block_t*)cur;
+        block->size_class = size_class;
+        block->arena = arena_index;
+        block->next = arena->free_lists[size_class];
+        arena->free_lists[size_class] = block;
+    }
     return 0;
 }
 
+/** @brief Take at most max free blocks of a size class from an arena
+ *
+ *  @param arena_index The index of the arena
+ *  @param size_class The size class
+ *  @param max Maximum number of blocks to take
+ *  @param count Set to the number of blocks taken
+ *
+ *  @return The blocks taken, linked through next; NULL if out of memory
+ */
+static block_t *arena_alloc(int arena_index, int size_class, int max,
+                            int *count) {
+    arena_t *arena = &arenas[arena_index];
+
+    SPINLOCK_LOCK(&arena->lock);
+
+    if (!arena->free_lists[size_class]) {
+        drain_remote_frees(arena);
+    }
+    if (!arena->free_lists[size_class] &&
+        carve_slab(arena_index, size_class) < 0) {
+        SPINLOCK_UNLOCK(&arena->lock);
+        *count = 0;
+        return NULL;
+    }
+
+    block_t *head = arena->free_lists[size_class];
+    block_t *tail = head;
+    int n = 1;
+    while (n < max && tail->next) {
+        tail = tail->next;
+        n++;
+    }
+    arena->free_lists[size_class] = tail->next;
+    tail->next = NULL;
+
+    SPINLOCK_UNLOCK(&arena->lock);
+
+    *count = n;
+    return head;
+}
+
+/** @brief Give a list of blocks back to the arenas that own them
+ *
+ *  @param arena_index The index of the arena of the current thread
+ *  @param blocks The blocks to give back, linked through next
+ *
+ *  @return void
+ */
+static void arena_free(int arena_index, block_t *blocks) {
+    arena_t *arena = &arenas[arena_index];
+
+    SPINLOCK_LOCK(&arena->lock);
+    while (blocks) {
+        block_t *next = blocks->next;
+        if (blocks->arena == arena_index) {
+            blocks->next = arena->free_lists[blocks->size_class];
+            arena->free_lists[blocks->size_class] = blocks;
+        } else {
+            remote_free(blocks);
+        }
+        blocks = next;
+    }
+    SPINLOCK_UNLOCK(&arena->lock);
+}
+
+/** @brief Allocate a block of a size class for the current thread
+ *
+ *  @param size_class The size class
+ *
+ *  @return The block on success; NULL if out of memory
+ */
+static block_t *alloc_block(int size_class) {
+    int index = get_thread_index();
+    int count;
+
+    if (index >= MAX_CACHED_THREADS) {
+        return arena_alloc(index % NUM_ARENAS, size_class, 1, &count);
+    }
+
+    thread_cache_t *cache = &thread_caches[index];
+    if (!cache->lists[size_class]) {
+        cache->lists[size_class] = arena_alloc(index % NUM_ARENAS,
+                                        size_class, CACHE_BATCH, &count);
+        cache->counts[size_class] = count;
+        if (!count)
+            return NULL;
+    }
+
+    block_t *block = cache->lists[size_class];
+    cache->lists[size_class] = block->next;
+    cache->counts[size_class]--;
+    return block;
+}
+
+/** @brief Free a block of a size class for the current thread
+ *
+ *  @param block The block
+ *
+ *  @return void
+ */
+static void free_block(block_t *block) {
+    int index = get_thread_index();
+    int size_class = block->size_class;
+
+    if (index >= MAX_CACHED_THREADS) {
+        block->next = NULL;
+        arena_free(index % NUM_ARENAS, block);
+        return;
+    }
+
+    thread_cache_t *cache = &thread_caches[index];
+    block->next = cache->lists[size_class];
+    cache->lists[size_class] = block;
+    cache->counts[size_class]++;
+
+    if (cache->counts[size_class] > CACHE_MAX_BLOCKS) {
+        // flush a batch back to arenas
+        block_t *tail = block;
+        int n = 1;
+        while (n < CACHE_BATCH) {
+            tail = tail->next;
+            n++;
+        }
+        cache->lists[size_class] = tail->next;
+        cache->counts[size_class] -= n;
+        tail->next = NULL;
+        arena_free(index % NUM_ARENAS, block);
+    }
+}
+
 /** @brief Wrapper for malloc syscall
- *  
+ *
  *  @param __size Parameter 1 of malloc syscall
  *
  *  @return Return value of malloc syscall
  */
 void *malloc(size_t __size)
 {
-    SPINLOCK_LOCK(&mutex_malloc);
-    void *ret = _malloc(__size);
-    SPINLOCK_UNLOCK(&mutex_malloc);
+    block_t *block;
 
-    return ret;
+    if (__size <= MAX_CLASS_SIZE) {
+        block = alloc_block(get_size_class(__size));
+    } else {
+        SPINLOCK_LOCK(&heap_lock);
+        block = _malloc(BLOCK_HDR_SIZE + __size);
+        SPINLOCK_UNLOCK(&heap_lock);
+        if (block)
+            block->size_class = LARGE_CLASS;
+    }
+
+    return block ? BLOCK_TO_PAYLOAD(block) : NULL;
 }
 
 /** @brief Wrapper for calloc syscall
- *  
+ *
  *  @param __nelt Parameter 1 of calloc syscall
  *  @param __eltsize Parameter 2 of calloc syscall
  *
@@ -49,15 +407,18 @@ void *malloc(size_t __size)
  */
 void *calloc(size_t __nelt, size_t __eltsize)
 {
-    SPINLOCK_LOCK(&mutex_malloc);
-    void *ret = _calloc(__nelt, __eltsize);
-    SPINLOCK_UNLOCK(&mutex_malloc);
+    if (__eltsize != 0 && __nelt > ((size_t)-1) / __eltsize)
+        return NULL;
+
+    void *ret = malloc(__nelt * __eltsize);
+    if (ret)
+        memset(ret, 0, __nelt * __eltsize);
 
     return ret;
 }
 
 /** @brief Wrapper for realloc syscall
- *  
+ *
  *  @param __buf Parameter 1 of realloc syscall
  *  @param __new_size Parameter 2 of realloc syscall
  *
@@ -65,23 +426,49 @@ void *calloc(size_t __nelt, size_t __eltsize)
  */
 void *realloc(void *__buf, size_t __new_size)
 {
-    SPINLOCK_LOCK(&mutex_malloc);
-    void *ret = _realloc(__buf, __new_size);
-    SPINLOCK_UNLOCK(&mutex_malloc);
+    if (!__buf)
+        return malloc(__new_size);
+
+    block_t *block = PAYLOAD_TO_BLOCK(__buf);
+
+    if (block->size_class == LARGE_CLASS) {
+        SPINLOCK_LOCK(&heap_lock);
+        block = _realloc(block, BLOCK_HDR_SIZE + __new_size);
+        SPINLOCK_UNLOCK(&heap_lock);
+        return block ? BLOCK_TO_PAYLOAD(block) : NULL;
+    }
+
+    size_t old_size = get_class_size(block->size_class);
+    if (__new_size <= old_size)
+        return __buf;
+
+    void *ret = malloc(__new_size);
+    if (ret) {
+        memcpy(ret, __buf, old_size);
+        free(__buf);
+    }
 
     return ret;
 }
 
 /** @brief Wrapper for free syscall
- *  
+ *
  *  @param __buf Parameter 1 of free syscall
  *
  *  @return void
  */
 void free(void *__buf)
 {
-    SPINLOCK_LOCK(&mutex_malloc);
-    _free(__buf);
-    SPINLOCK_UNLOCK(&mutex_malloc);
-}
+    if (!__buf)
+        return;
+
+    block_t *block = PAYLOAD_TO_BLOCK(__buf);
 
+    if (block->size_class == LARGE_CLASS) {
+        SPINLOCK_LOCK(&heap_lock);
+        _free(block);
+        SPINLOCK_UNLOCK(&heap_lock);
+    } else {
+        free_block(block);
+    }
+}
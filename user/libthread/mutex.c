@@ -2,24 +2,27 @@
  *  @brief Implementation of mutex
  *
  *  mutex_t contains the following fields
- *     1. lock_available: it is an integer to indicate if the mutex lock is
- *        available. lock_available == 1 means available (unlocked), 
- *        lock_available == 0 means unavailable (locked).
- *        lock_available == -1 means the mutex is destroied
- *     2. inner_lock: a spinlock to protect critical section of mutex code.
- *     3. deque: a double-ended queue to store the threads that are blocking on
- *        the mutex. The queue is FIFO so first blocked thread will get the 
+ *     1. lock_state: it is an integer to indicate the state of the mutex.
+ *        MUTEX_UNLOCKED means available, MUTEX_LOCKED means locked and
+ *        nobody is waiting, MUTEX_CONTENDED means locked and some threads
+ *        may be waiting, MUTEX_DESTROYED means the mutex is destroied.
+ *     2. inner_lock: a spinlock to protect the waiting queue.
+ *     3. waiters: a queue to store the threads that are blocking on the 
+ *        mutex. The queue is FIFO so first blocked thread will get the 
  *        mutex first.
  *
- *  To achieve bounded waiting, a spinlock and a queue are used. Although 
- *  spinlock itself doesn't satisfy bounded waitting, the critical section 
- *  (which is the code of mutex) that protected by spinlock are guaranteed to 
- *  be short. Becuase only when one thread is in the mutex code need to obtain
- *  the spinlock. It is unlikely that there are always some threads that hold 
- *  the spinlock of mutex. So it is better than we use spinlock (xchg) as 
- *  implementation of mutex directly because we can not predict what the 
- *  critical section mutex is trying to protect. So spinlock help mutex somewhat
- *  approximate bounded waiting.
+ *  Uncontended mutex_lock() and mutex_unlock() are a single cmpxchg on 
+ *  lock_state (MUTEX_UNLOCKED <-> MUTEX_LOCKED), and never touch inner_lock.
+ *
+ *  A thread that can not get the mutex takes inner_lock, marks the mutex as
+ *  MUTEX_CONTENDED, enqueues a node allocated on its own stack and blocks in
+ *  the kernel with deschedule(). Because the stack of mutex_lock() will not 
+ *  be destroied until the thread gets the mutex, it is safe, and no malloc() 
+ *  is needed. An unlocking thread that finds the mutex MUTEX_CONTENDED hands 
+ *  the mutex over directly to the thread in the head of the queue and makes 
+ *  it runnable. Since the mutex stays locked during the handover, a newly
+ *  arriving thread can not overtake the threads in the queue, so bounded 
+ *  waiting is preserved.
  *
  *  @author Ke Wu (kewu)
  *  @author Jian Wang (jianwan3)
@@ -41,10 +44,10 @@
  *  @return 0 on success; -1 on error
  */
 int mutex_init(mutex_t *mp) {
-    mp->lock_available = 1; 
+    mp->lock_state = MUTEX_UNLOCKED; 
     SPINLOCK_INIT(&mp->inner_lock);
-    int is_error = queue_init(&mp->deque);
-    return is_error ? -1 : 0;
+    Q_INIT_HEAD(&mp->waiters);
+    return 0;
 }
 
 /** @brief Destroy mutex
@@ -56,35 +59,34 @@ int mutex_init(mutex_t *mp) {
 void mutex_destroy(mutex_t *mp) {
     SPINLOCK_LOCK(&mp->inner_lock);
 
-    if (mp->lock_available < 0) {
+    if (mp->lock_state == MUTEX_DESTROYED) {
         // try to destroy a destroied mutex
         panic("mutex %p has already been destroied!", mp);
     }
 
-    while (mp->lock_available != 1) {
-        // illegal, mutex is locked
-        lprintf("Destroy mutex %p failed, mutex is locked, "
+    while (Q_GET_FRONT(&mp->waiters) != NULL) {
+        // illegal, some threads are blocked waiting on it
+        lprintf("Destroy mutex %p failed, some threads are blocking on it, "
                 "will try again...", mp);
-        printf("Destroy mutex %p failed, mutex is locked, "
+        printf("Destroy mutex %p failed, some threads are blocking on it, "
                 "will try again...\n", mp);
         SPINLOCK_UNLOCK(&mp->inner_lock);
         yield(-1);
         SPINLOCK_LOCK(&mp->inner_lock);
     }
 
-    while (queue_destroy(&mp->deque) < 0){
-        // illegal, some threads are blocked waiting on it
-        lprintf("Destroy mutex %p failed, some threads are blocking on it, "
+    while (asm_cmpxchg(&mp->lock_state, MUTEX_UNLOCKED, MUTEX_DESTROYED) 
+           != MUTEX_UNLOCKED) {
+        // illegal, mutex is locked
+        lprintf("Destroy mutex %p failed, mutex is locked, "
                 "will try again...", mp);
-        printf("Destroy mutex %p failed, some threads are blocking on it, "
+        printf("Destroy mutex %p failed, mutex is locked, "
                 "will try again...\n", mp);
         SPINLOCK_UNLOCK(&mp->inner_lock);
         yield(-1);
         SPINLOCK_LOCK(&mp->inner_lock);
     }
 
-    mp->lock_available = -1;
-
     SPINLOCK_UNLOCK(&mp->inner_lock);
 }
 
@@ -100,39 +102,42 @@ void mutex_destroy(mutex_t *mp) {
  *  @return void
  */
 void mutex_lock(mutex_t *mp) {
+    // fast path, the mutex is available
+    if (asm_cmpxchg(&mp->lock_state, MUTEX_UNLOCKED, MUTEX_LOCKED) 
+        == MUTEX_UNLOCKED)
+        return;
+
     SPINLOCK_LOCK(&mp->inner_lock);
-    if (mp->lock_available < 0) {
+    if (mp->lock_state == MUTEX_DESTROYED) {
         // try to lock a destroied mutex
         panic("mutex %p has already been destroied!", mp);
     }
 
-    if (mp->lock_available){
-        // mutex is unlocked, get the mutex lock directly and set it to locked
-        mp->lock_available = 0;
+    // mark the mutex as contended so that the holder will check the queue
+    // when it unlocks. If the mutex has been unlocked in the meantime, we get
+    // it directly
+    if (asm_xchg(&mp->lock_state, MUTEX_CONTENDED) == MUTEX_UNLOCKED) {
         SPINLOCK_UNLOCK(&mp->inner_lock);
-    } else {
-        // mutex is locked, enter the tail of queue to wait
-        node_t *tmp = malloc(sizeof(node_t));
-        while (!tmp) {
-            lprintf("malloc failed, will try again...");
-            printf("malloc failed, will try again...\n");
-            yield(-1);
-            tmp = malloc(sizeof(node_t));
-        }
-        tmp->ktid = thr_getktid();
-        tmp->reject = 0;
+        return;
+    }
 
-        enqueue(&mp->deque, tmp);
+    // mutex is locked, enter the tail of queue to wait, note that stack
+    // memory is used for the node. Because the stack of mutex_lock() will
+    // not be destroied until this thread get the mutex, so it is safe
+    mutex_node_t node;
+    node.ktid = thr_getktid();
+    node.reject = 0;
+    Q_INSERT_TAIL(&mp->waiters, &node, link);
 
-        SPINLOCK_UNLOCK(&mp->inner_lock);
+    SPINLOCK_UNLOCK(&mp->inner_lock);
 
-        // while is necessary, reject is used to indicate if the thread has been
-        // dequeued by others
-        while(!tmp->reject) {
-            yield(-1);
+    // while is necessary, reject is used to indicate if the mutex has been
+    // handed over to this thread, and deschedule() will return immediately if
+    // it has
+    while (!node.reject) {
+        if (deschedule(&node.reject) < 0) {
+            panic("deschedule error of mutex %p", mp);
         }
-
-        free(tmp);
     }
 }
 
@@ -147,36 +152,47 @@ void mutex_lock(mutex_t *mp) {
  *  @return void
  */
 void mutex_unlock(mutex_t *mp) {
-    SPINLOCK_LOCK(&mp->inner_lock);
+    int state;
 
-    if (mp->lock_available < 0) {
-        // try to unlock a destroied mutex
-        panic("mutex %p has already been destroied!", mp);
-    }
+    // fast path, nobody is waiting
+    while ((state = asm_cmpxchg(&mp->lock_state, MUTEX_LOCKED, 
+                                MUTEX_UNLOCKED)) != MUTEX_CONTENDED) {
+        if (state == MUTEX_LOCKED)
+            return;
+
+        if (state == MUTEX_DESTROYED) {
+            // try to unlock a destroied mutex
+            panic("mutex %p has already been destroied!", mp);
+        }
 
-    while (mp->lock_available == 1) {
         lprintf("try to unlock an unlocked mutex %p, "
                 "will wait until it is locked", mp);
         printf("try to unlock an unlocked mutex %p, "
                 "will wait until it is locked\n", mp);
-        SPINLOCK_UNLOCK(&mp->inner_lock);
         yield(-1);
-        SPINLOCK_LOCK(&mp->inner_lock);
     }
 
-    node_t *tmp = dequeue(&mp->deque);
+    SPINLOCK_LOCK(&mp->inner_lock);
+
+    mutex_node_t *node = Q_GET_FRONT(&mp->waiters);
 
-    if (!tmp) {
+    if (node == NULL) {
         // no thread is waiting the mutex, set mutex as available 
-        mp->lock_available = 1;
+        asm_xchg(&mp->lock_state, MUTEX_UNLOCKED);
         SPINLOCK_UNLOCK(&mp->inner_lock);
     } else {
-        // some threads are waiting the mutex, awaken the thread in the head of
-        // queue
-        int tmp_ktid = tmp->ktid;
-        tmp->reject = 1;
+        // some threads are waiting the mutex, hand over the mutex to the 
+        // thread in the head of queue, it is still contended if there are 
+        // more threads waiting
+        Q_REMOVE(&mp->waiters, node, link);
+        asm_xchg(&mp->lock_state, Q_GET_FRONT(&mp->waiters) == NULL ?
+                                  MUTEX_LOCKED : MUTEX_CONTENDED);
+
+        // node is on the stack of the waiting thread, read ktid before 
+        // setting reject
+        int ktid = node->ktid;
+        node->reject = 1;
         SPINLOCK_UNLOCK(&mp->inner_lock);
-        yield(tmp_ktid);
+        make_runnable(ktid);
     }
 }
-
@@ -0,0 +1,469 @@
+/** @file pool.c
+ *  @brief This file contains the implementation of thread pools
+ *
+ *  A pool has a fixed set of worker threads, created by pool_init(). Every
+ *  worker owns a Chase-Lev deque of tasks:
+ *     1. A task submitted by a worker (e.g. by a running task) is pushed to
+ *        the bottom of the deque of that worker, without any lock.
+ *     2. A task submitted by any other thread goes to the injection queue of
+ *        the pool, which is protected by pool->lock.
+ *     3. A worker looking for a task first takes from the bottom of its own
+ *        deque, then tries the injection queue, then steals from the top of
+ *        the deques of other workers, starting from a random victim.
+ *  The owner and thieves only race for the last task of a deque, that race
+ *  is settled by a cmpxchg on top. Taking stores bottom with xchg, which is
+ *  a full fence on x86, so a thief can not miss the new bottom.
+ *
+ *  pool->num_queued counts tasks that are queued somewhere and not started.
+ *  It is increased before a task is published, so a worker that sees it is
+ *  zero can sleep on work_cv. A worker that sees it is positive but finds no
+ *  task yields and tries again. Both num_queued and num_sleeping are updated
+ *  with lock xadd, so a submitter that increases num_queued and then finds
+ *  num_sleeping zero can not race with a worker going to sleep.
+ *
+ *  parallel_for() submits the whole range as a single chunk. A worker that
+ *  runs a chunk larger than grain splits off the upper half as a new chunk to
+ *  its own deque and continues with the lower half, so idle workers steal
+ *  big chunks and the load is balanced without any fixed assignment.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdlib.h>
+#include <syscall.h>
+
+#include <thread.h>
+#include <mutex.h>
+#include <cond.h>
+#include <pool.h>
+#include <thr_internals.h>
+
+/** @brief Mask to get the index in a deque buffer */
+#define DEQUE_MASK (POOL_DEQUE_SIZE - 1)
+
+/** @brief State of a parallel_for(), it is on the stack of the caller */
+typedef struct pool_loop {
+    /** @brief The loop body */
+    void (*body)(int, void *);
+    /** @brief The argument of body */
+    void *arg;
+    /** @brief Chunks no larger than grain are not split */
+    int grain;
+    /** @brief Number of iterations that are not finished */
+    volatile int remaining;
+} pool_loop_t;
+
+/** @brief Push a task to the bottom of a deque, only called by the owner
+ *
+ *  @param deque The deque
+ *  @param task The task
+ *
+ *  @return 0 on success; -1 if the deque is full
+ */
+static int deque_push(pool_deque_t *deque, pool_task_t *task) {
+    int bottom = deque->bottom;
+
+    if (bottom - deque->top >= POOL_DEQUE_SIZE)
+        return -1;
+
+    deque->tasks[bottom & DEQUE_MASK] = task;
+    // stores are not reordered on x86, thieves see the task before bottom
+    deque->bottom = bottom + 1;
+    return 0;
+}
+
+/** @brief Take a task from the bottom of a deque, only called by the owner
+ *
+ *  @param deque The deque
+ *
+ *  @return The task; NULL if the deque is empty
+ */
+static pool_task_t *deque_take(pool_deque_t *deque) {
+    int bottom = deque->bottom - 1;
+    asm_xchg((int *)&deque->bottom, bottom);
+    int top = deque->top;
+
+    if (top > bottom) {
+        // empty
+        deque->bottom = bottom + 1;
+        return NULL;
+    }
+
+    pool_task_t *task = deque->tasks[bottom & DEQUE_MASK];
+    if (top == bottom) {
+        // the last task, race with thieves for it
+        if (asm_cmpxchg((int *)&deque->top, top, top + 1) != top)
+            task = NULL;
+        deque->bottom = bottom + 1;
+    }
+    return task;
+}
+
+/** @brief Steal a task from the top of a deque
+ *
+ *  @param deque The deque
+ *
+ *  @return The task; NULL if the deque is empty or another thread wins
+ */
+static pool_task_t *deque_steal(pool_deque_t *deque) {
+    int top = deque->top;
+    int bottom = deque->bottom;
+
+    if (top >= bottom)
+        return NULL;
+
+    pool_task_t *task = deque->tasks[top & DEQUE_MASK];
+    if (asm_cmpxchg((int *)&deque->top, top, top + 1) != top)
+        return NULL;
+    return task;
+}
+
+/** @brief Get the worker that the current thread is
+ *
+ *  @param pool The pool
+ *
+ *  @return The worker; NULL if the current thread is not a worker of pool
+ */
+static pool_worker_t *get_current_worker(pool_t *pool) {
+    int tid = thr_getid();
+    int i;
+
+    for (i = 0; i < pool->num_workers; i++) {
+        if (pool->workers[i].tid == tid)
+            return &pool->workers[i];
+    }
+    return NULL;
+}
+
+/** @brief Queue a task that has been counted in num_pending
+ *
+ *  @param pool The pool
+ *  @param worker The current worker; NULL if the current thread is not one
+ *  @param task The task
+ *
+ *  @return void
+ */
+static void enqueue(pool_t *pool, pool_worker_t *worker, pool_task_t *task) {
+    // count the task before it can be seen, see the file comment
+    asm_xadd((int *)&pool->num_queued, 1);
+
+    if (!worker || deque_push(&worker->deque, task) < 0) {
+        mutex_lock(&pool->lock);
+        Q_INSERT_TAIL(&pool->injection, task, link);
+        mutex_unlock(&pool->lock);
+    }
+
+    if (pool->num_sleeping > 0) {
+        mutex_lock(&pool->lock);
+        cond_signal(&pool->work_cv);
+        mutex_unlock(&pool->lock);
+    }
+}
+
+/** @brief Find a task for a worker
+ *
+ *  @param worker The worker
+ *
+ *  @return The task; NULL if no task is found
+ */
+static pool_task_t *find_task(pool_worker_t *worker) {
+    pool_t *pool = worker->pool;
+    pool_task_t *task;
+    int i;
+
+    if ((task = deque_take(&worker->deque)) != NULL)
+        return task;
+
+    // unlocked peek, the queue is checked again with the lock held
+    if (Q_GET_FRONT(&pool->injection)) {
+        mutex_lock(&pool->lock);
+        task = Q_GET_FRONT(&pool->injection);
+        if (task)
+            Q_REMOVE(&pool->injection, task, link);
+        mutex_unlock(&pool->lock);
+        if (task)
+            return task;
+    }
+
+    worker->seed = worker->seed * 1103515245 + 12345;
+    int victim = (worker->seed >> 16) % pool->num_workers;
+    for (i = 0; i < pool->num_workers; i++) {
+        pool_worker_t *other = &pool->workers[(victim + i) %
+                                              pool->num_workers];
+        if (other != worker && (task = deque_steal(&other->deque)) != NULL)
+            return task;
+    }
+    return NULL;
+}
+
+/** @brief Wake up threads in pool_wait() and parallel_for()
+ *
+ *  @param pool The pool
+ *
+ *  @return void
+ */
+static void notify_done(pool_t *pool) {
+    mutex_lock(&pool->lock);
+    cond_broadcast(&pool->done_cv);
+    mutex_unlock(&pool->lock);
+}
+
+/** @brief Run a chunk of parallel_for()
+ *
+ *  @param worker The current worker
+ *  @param task The chunk
+ *
+ *  @return void
+ */
+static void run_chunk(pool_worker_t *worker, pool_task_t *task) {
+    pool_loop_t *loop = task->loop;
+    int begin = task->begin;
+    int end = task->end;
+    int i;
+
+    // split off the upper half for other workers to steal
+    while (end - begin > loop->grain) {
+        int mid = begin + (end - begin) / 2;
+        pool_task_t *half = malloc(sizeof(pool_task_t));
+        if (!half)
+            break;
+        half->func = NULL;
+        half->loop = loop;
+        half->begin = mid;
+        half->end = end;
+        asm_xadd((int *)&worker->pool->num_pending, 1);
+        enqueue(worker->pool, worker, half);
+        end = mid;
+    }
+
+    for (i = begin; i < end; i++)
+        loop->body(i, loop->arg);
+
+    // the caller of parallel_for() may return once remaining is zero, so
+    // loop must not be touched after that
+    if (asm_xadd((int *)&loop->remaining, begin - end) == end - begin)
+        notify_done(worker->pool);
+}
+
+/** @brief Main function of worker threads
+ *
+ *  @param arg The worker
+ *
+ *  @return NULL
+ */
+static void *worker_main(void *arg) {
+    pool_worker_t *worker = arg;
+    pool_t *pool = worker->pool;
+
+    worker->tid = thr_getid();
+
+    while (1) {
+        pool_task_t *task = find_task(worker);
+
+        if (task) {
+            asm_xadd((int *)&pool->num_queued, -1);
+            if (task->loop)
+                run_chunk(worker, task);
+            else
+                task->func(task->arg);
+            free(task);
+
+            if (asm_xadd((int *)&pool->num_pending, -1) == 1)
+                notify_done(pool);
+            continue;
+        }
+
+        if (pool->num_queued > 0) {
+            // a task is being published, or a thief is holding it
+            yield(-1);
+            continue;
+        }
+
+        mutex_lock(&pool->lock);
+        if (pool->is_shutdown) {
+            mutex_unlock(&pool->lock);
+            break;
+        }
+        asm_xadd((int *)&pool->num_sleeping, 1);
+        while (pool->num_queued == 0 && !pool->is_shutdown)
+            cond_wait(&pool->work_cv, &pool->lock);
+        asm_xadd((int *)&pool->num_sleeping, -1);
+        mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+/** @brief Initialize a thread pool and create its workers
+ *
+ *  The thread library must have been initialized.
+ *
+ *  @param pool The pool to initialize
+ *  @param num_workers Number of worker threads
+ *
+ *  @return 0 on success; -1 on error
+ */
+int pool_init(pool_t *pool, int num_workers) {
+    int i;
+
+    if (num_workers <= 0)
+        return -1;
+
+    pool->workers = calloc(num_workers, sizeof(pool_worker_t));
+    if (!pool->workers)
+        return -1;
+
+    pool->num_workers = 0;
+    pool->num_queued = 0;
+    pool->num_pending = 0;
+    pool->num_sleeping = 0;
+    pool->is_shutdown = 0;
+    Q_INIT_HEAD(&pool->injection);
+
+    int is_error = 0;
+    is_error |= mutex_init(&pool->lock);
+    is_error |= cond_init(&pool->work_cv);
+    is_error |= cond_init(&pool->done_cv);
+    if (is_error) {
+        free(pool->workers);
+        return -1;
+    }
+
+    for (i = 0; i < num_workers; i++) {
+        pool_worker_t *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->seed = i + 1;
+        worker->tid = -1;
+    }
+
+    // workers only look at the workers before num_workers
+    for (i = 0; i < num_workers; i++) {
+        pool->num_workers = i + 1;
+        int tid = thr_create(worker_main, &pool->workers[i]);
+        if (tid < 0) {
+            pool->num_workers = i;
+            pool_destroy(pool);
+            return -1;
+        }
+        pool->workers[i].tid = tid;
+    }
+
+    return 0;
+}
+
+/** @brief Wait for all tasks and destroy a thread pool
+ *
+ *  Must not be called by a task of the pool.
+ *
+ *  @param pool The pool to destroy
+ *
+ *  @return void
+ */
+void pool_destroy(pool_t *pool) {
+    int i;
+
+    pool_wait(pool);
+
+    mutex_lock(&pool->lock);
+    pool->is_shutdown = 1;
+    cond_broadcast(&pool->work_cv);
+    mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->num_workers; i++)
+        thr_join(pool->workers[i].tid, NULL);
+
+    cond_destroy(&pool->done_cv);
+    cond_destroy(&pool->work_cv);
+    mutex_destroy(&pool->lock);
+    free(pool->workers);
+}
+
+/** @brief Submit a task to a thread pool
+ *
+ *  @param pool The pool
+ *  @param func The function to run
+ *  @param arg The argument of func
+ *
+ *  @return 0 on success; -1 on error
+ */
+int pool_submit(pool_t *pool, void (*func)(void *), void *arg) {
+    if (!func)
+        return -1;
+
+    pool_task_t *task = malloc(sizeof(pool_task_t));
+    if (!task)
+        return -1;
+    task->func = func;
+    task->arg = arg;
+    task->loop = NULL;
+
+    asm_xadd((int *)&pool->num_pending, 1);
+    enqueue(pool, get_current_worker(pool), task);
+    return 0;
+}
+
+/** @brief Wait until all tasks submitted to a thread pool are finished
+ *
+ *  Tasks submitted by other tasks are waited for as well. Must not be called
+ *  by a task of the pool.
+ *
+ *  @param pool The pool
+ *
+ *  @return void
+ */
+void pool_wait(pool_t *pool) {
+    mutex_lock(&pool->lock);
+    while (pool->num_pending != 0)
+        cond_wait(&pool->done_cv, &pool->lock);
+    mutex_unlock(&pool->lock);
+}
+
+/** @brief Run body(i, arg) for every i in [begin, end) on a thread pool
+ *
+ *  Returns when all iterations are finished. Must not be called by a task of
+ *  the pool.
+ *
+ *  @param pool The pool
+ *  @param begin The first iteration
+ *  @param end One past the last iteration
+ *  @param grain Ranges of no more than grain iterations are not split
+ *  @param body The loop body
+ *  @param arg The argument of body
+ *
+ *  @return 0 on success; -1 on error
+ */
+int parallel_for(pool_t *pool, int begin, int end, int grain,
+                 void (*body)(int, void *), void *arg) {
+    pool_loop_t loop;
+
+    if (!body)
+        return -1;
+    if (end <= begin)
+        return 0;
+
+    loop.body = body;
+    loop.arg = arg;
+    loop.grain = grain > 0 ? grain : 1;
+    loop.remaining = end - begin;
+
+    pool_task_t *task = malloc(sizeof(pool_task_t));
+    if (!task)
+        return -1;
+    task->func = NULL;
+    task->loop = &loop;
+    task->begin = begin;
+    task->end = end;
+
+    asm_xadd((int *)&pool->num_pending, 1);
+    enqueue(pool, NULL, task);
+
+    mutex_lock(&pool->lock);
+    while (loop.remaining != 0)
+        cond_wait(&pool->done_cv, &pool->lock);
+    mutex_unlock(&pool->lock);
+
+    return 0;
+}
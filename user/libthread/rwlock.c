@@ -2,20 +2,32 @@
  *  @brief Contains the implementation of rwlock
  *
  *  rwlock_t contains the following fields
- *     1. lock_state: it is used to indicate the state of rwlock. 
- *        lock_state == 0 means rwlock is available (unlocked).
- *        lock_state > 0 means some readers are holding the lock (shared), the 
- *                       value of lock_state indicates how many readers are 
- *                       holding the lock
- *        lock_state == -1 means a writer is holding the lock (exclusvie)
- *        lock_state == -2 means the rwlock is destoried
+ *     1. lock_state: a state word, changed only with atomic instructions.
+ *        The low bits (RW_READER_MASK) count the readers holding the lock,
+ *        and the high bits are flags:
+ *        RW_WRITER_HELD means a writer is holding the lock (exclusive)
+ *        RW_WRITER_WAITING means some writers are waiting for the lock
+ *        RW_DESTROYED means the rwlock is destroyed
  *     2. writer_waiting_count: indicates how many writers are waiting the lock
  *     3. reader_waiting_count: indicates how many readers are waiting the lock
- *     4. mutex_inner: a mutex to protect critical section of rwlock code.
+ *     4. mutex_inner: a mutex to protect the slow paths of rwlock code.
  *     5. cond_reader: conditional variable for readers to block
  *     6. cond_writer: conditional variable for writers to block
  *
+ *  A reader first adds one to lock_state with lock xadd. If none of the flags
+ *  was set, it holds the lock without touching mutex_inner. Otherwise it
+ *  takes mutex_inner, takes back its increment and waits on cond_reader
+ *  until no writer holds or waits for the lock (favor writer). A reader
+ *  unlocks with lock xadd as well, and only takes mutex_inner to signal a
+ *  writer if it is the last reader and a writer is waiting.
  *
+ *  Writers always take mutex_inner. A writer sets RW_WRITER_WAITING before
+ *  it checks the reader count, so every reader arriving later goes to the
+ *  slow path. The flags are only changed with mutex_inner held, which makes
+ *  the slow paths behave just like the all-mutex rwlock: a thread that
+ *  checks the state with mutex_inner held can not miss a signal. A reader
+ *  that backs off from the fast path may briefly leave one extra count in
+ *  lock_state, so a waiting writer is woken up again once it is taken back.
  *
  *  @author Ke Wu (kewu)
  *
@@ -27,6 +39,18 @@
 #include <assert.h>
 #include <simics.h>
 #include <stdio.h>
+#include <thr_internals.h>
+
+/** @brief Bits of lock_state counting readers holding the lock */
+#define RW_READER_MASK      0x0fffffff
+/** @brief A writer is holding the lock */
+#define RW_WRITER_HELD      0x10000000
+/** @brief Some writers are waiting for the lock */
+#define RW_WRITER_WAITING   0x20000000
+/** @brief The rwlock is destroyed */
+#define RW_DESTROYED        0x40000000
+/** @brief Flags that force a reader to the slow path */
+#define RW_READER_SLOW      (RW_WRITER_HELD|RW_WRITER_WAITING|RW_DESTROYED)
 
 /** @brief Initialize rwlock
  *
@@ -45,54 +69,88 @@ int rwlock_init( rwlock_t *rwlock ) {
     return is_error ? -1 : 0;
 }
 
-/** @brief Lock rwlock
+/** @brief Wake up a writer if no reader holds the lock any more
+ *
+ *  Must be called with mutex_inner held
+ *
+ *  @param rwlock The rwlock
+ *  @param state The value of lock_state after the last change to it
+ *
+ *  @return void
+ */
+static void wake_writer_if_free(rwlock_t *rwlock, int state) {
+    if ((state & RW_READER_MASK) == 0 && rwlock->writer_waiting_count > 0)
+        cond_signal(&rwlock->cond_writer);
+}
+
+/** @brief Lock rwlock for reading when the fast path fails
  *
  *  @param rwlock The rwlock to acquire lock
- *  @param type Type of lock to acquire (RWLOCK_READ or RWLOCK_WRITE)
  *
  *  @return void
  */
-void rwlock_lock( rwlock_t *rwlock, int type ) {
-    if (type == RWLOCK_READ) {
-        mutex_lock(&rwlock->mutex_inner);
+static void rwlock_lock_read_slow( rwlock_t *rwlock ) {
+    int state;
 
-        if (rwlock->lock_state == -2) {
-            panic("readers/writers lock %p has already been destroyed!", 
-                    rwlock);
-        }
+    mutex_lock(&rwlock->mutex_inner);
 
-        rwlock->reader_waiting_count++;
-        // as long as rwlock is not available or some writers are waiting, 
-        // reader should wait
-        while (rwlock->lock_state != 0 || rwlock->writer_waiting_count > 0) {
-            // only when there is no writer is waiting and rwlock is a reader
-            // lock can the new reader hold the shared reader lock(favor writer)
-            if (rwlock->lock_state > 0 && rwlock->writer_waiting_count == 0) 
-                break;
-            cond_wait(&rwlock->cond_reader, &rwlock->mutex_inner);
-        }
-        rwlock->reader_waiting_count--;
+    // take back the increment of the fast path
+    state = asm_xadd(&rwlock->lock_state, -1) - 1;
 
-        // share the lock with other readers
-        rwlock->lock_state++;
+    if (state & RW_DESTROYED) {
+        panic("readers/writers lock %p has already been destroyed!", 
+                rwlock);
+    }
+    wake_writer_if_free(rwlock, state);
 
-        mutex_unlock(&rwlock->mutex_inner);
+    rwlock->reader_waiting_count++;
+    // as long as a writer holds or waits for the rwlock, reader should wait
+    // (favor writer), otherwise it can share the lock with other readers
+    while (rwlock->lock_state & (RW_WRITER_HELD|RW_WRITER_WAITING))
+        cond_wait(&rwlock->cond_reader, &rwlock->mutex_inner);
+    rwlock->reader_waiting_count--;
+
+    // share the lock with other readers
+    asm_xadd(&rwlock->lock_state, 1);
+
+    mutex_unlock(&rwlock->mutex_inner);
+}
+
+/** @brief Lock rwlock
+ *
+ *  @param rwlock The rwlock to acquire lock
+ *  @param type Type of lock to acquire (RWLOCK_READ or RWLOCK_WRITE)
+ *
+ *  @return void
+ */
+void rwlock_lock( rwlock_t *rwlock, int type ) {
+    if (type == RWLOCK_READ) {
+        // fast path: no writer holds or waits for the rwlock
+        if ((asm_xadd(&rwlock->lock_state, 1) & RW_READER_SLOW) == 0)
+            return;
+        rwlock_lock_read_slow(rwlock);
     } else {
         mutex_lock(&rwlock->mutex_inner);
 
-        if (rwlock->lock_state == -2) {
+        if (rwlock->lock_state & RW_DESTROYED) {
             panic("readers/writers lock %p has already been destroied!", 
                     rwlock);
         }
 
-        rwlock->writer_waiting_count++;
+        // readers arriving from now on go to the slow path
+        if (rwlock->writer_waiting_count++ == 0)
+            asm_xadd(&rwlock->lock_state, RW_WRITER_WAITING);
+
         // as long as rwlock is not available, writer must wait
-        while (rwlock->lock_state != 0) 
+        while (rwlock->lock_state & (RW_READER_MASK|RW_WRITER_HELD)) 
             cond_wait(&rwlock->cond_writer, &rwlock->mutex_inner);
-        rwlock->writer_waiting_count--;
 
-        // mark the lock as writer lock
-        rwlock->lock_state = -1;
+        // mark the lock as writer lock, and clear RW_WRITER_WAITING in the
+        // same instruction if this is the last waiting writer
+        if (--rwlock->writer_waiting_count == 0)
+            asm_xadd(&rwlock->lock_state, RW_WRITER_HELD - RW_WRITER_WAITING);
+        else
+            asm_xadd(&rwlock->lock_state, RW_WRITER_HELD);
 
         mutex_unlock(&rwlock->mutex_inner);
     }
@@ -108,13 +166,27 @@ void rwlock_lock( rwlock_t *rwlock, int type ) {
  *  @return void
  */
 void rwlock_unlock( rwlock_t *rwlock ) {
+    int state = rwlock->lock_state;
+
+    // fast path: a reader that is not the last one with a writer waiting
+    if (!(state & (RW_WRITER_HELD|RW_DESTROYED)) && 
+            (state & RW_READER_MASK) != 0) {
+        state = asm_xadd(&rwlock->lock_state, -1) - 1;
+        if ((state & RW_WRITER_WAITING) && (state & RW_READER_MASK) == 0) {
+            mutex_lock(&rwlock->mutex_inner);
+            wake_writer_if_free(rwlock, rwlock->lock_state);
+            mutex_unlock(&rwlock->mutex_inner);
+        }
+        return;
+    }
+
     mutex_lock(&rwlock->mutex_inner);
 
-    if (rwlock->lock_state == -2) {
+    if (rwlock->lock_state & RW_DESTROYED) {
         panic("readers/writers lock %p has already been destroied!", rwlock);
     }
 
-    while (rwlock->lock_state == 0) {
+    while ((rwlock->lock_state & (RW_READER_MASK|RW_WRITER_HELD)) == 0) {
         lprintf("try to unlock an unlocked rwlock %p, "
                 "will wait until it is locked", rwlock);
         printf("try to unlock an unlocked rwlock %p, "
@@ -124,20 +196,22 @@ void rwlock_unlock( rwlock_t *rwlock ) {
         mutex_lock(&rwlock->mutex_inner);
     }
 
-    // for writer lock (lock_state < 0), release rwlock is lock_state++
-    // for reader lock (lock_state > 0). release rwlock is lock_state--
-    rwlock->lock_state = (rwlock->lock_state>0) ? 
-        (rwlock->lock_state-1) : 
-        (rwlock->lock_state+1);
+    if (rwlock->lock_state & RW_WRITER_HELD) {
+        // for writer lock, release rwlock is clearing RW_WRITER_HELD, then it
+        // is available for other waiting threads even if a reader backing off
+        // from the fast path still has its count in lock_state
+        asm_xadd(&rwlock->lock_state, -RW_WRITER_HELD);
 
-    // if lock_state == 0, it is available for other waiting threads 
-    if (rwlock->lock_state == 0) {
         // if some writers are waiting, give the rwlock to writer(favor writer)
         if (rwlock->writer_waiting_count > 0) 
             cond_signal(&rwlock->cond_writer);
         else
             // no writer is waiting, all readers can share the lock
             cond_broadcast(&rwlock->cond_reader);
+    } else {
+        // for reader lock, release rwlock is decrementing the reader count
+        state = asm_xadd(&rwlock->lock_state, -1) - 1;
+        wake_writer_if_free(rwlock, state);
     }
 
     mutex_unlock(&rwlock->mutex_inner);
@@ -152,7 +226,7 @@ void rwlock_unlock( rwlock_t *rwlock ) {
 void rwlock_destroy( rwlock_t *rwlock ) {
     mutex_lock(&rwlock->mutex_inner);
 
-    if (rwlock->lock_state == -2) {
+    if (rwlock->lock_state & RW_DESTROYED) {
         panic("readers/writers lock %p has already been destroied!", rwlock);
     }
 
@@ -170,7 +244,7 @@ void rwlock_destroy( rwlock_t *rwlock ) {
         mutex_lock(&rwlock->mutex_inner);
     }
 
-    rwlock->lock_state = -2;
+    asm_xadd(&rwlock->lock_state, RW_DESTROYED);
 
     mutex_unlock(&rwlock->mutex_inner);
 
@@ -192,15 +266,15 @@ void rwlock_destroy( rwlock_t *rwlock ) {
  */
 void rwlock_downgrade( rwlock_t *rwlock) {
     mutex_lock(&rwlock->mutex_inner);
-    if (rwlock->lock_state != -1){
+    if (!(rwlock->lock_state & RW_WRITER_HELD) ||
+            (rwlock->lock_state & RW_DESTROYED)) {
         // illegal
         panic("readers/writers lock %p cannot be downgraded while not locked",
                 rwlock);
     }
     // downgrade lock from writer lock to reader lock
-    rwlock->lock_state = 1;
+    asm_xadd(&rwlock->lock_state, 1 - RW_WRITER_HELD);
     // other readers may share the rwlock
     cond_broadcast(&rwlock->cond_reader);
     mutex_unlock(&rwlock->mutex_inner);
 }
-
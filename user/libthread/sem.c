@@ -1,12 +1,24 @@
 /** @file sem.c
  *
  *  @brief This file contains implementation of semaphore built
- *  on top of mutex and condition variables
+ *  on top of an atomic counter, mutex and condition variables
  *  
- *  The semaphore contains three fields: a mutux to guard access to changes to
- *  its other fields, a condition variable to wait and signal threads according
- *  to available resources, and a counter indicating the number of resources 
- *  availbale.
+ *  The semaphore contains four fields: a counter indicating the number of
+ *  resources availbale, a counter of resources handed to blocked threads, a
+ *  mutux to guard access to the latter, and a condition variable for threads
+ *  to block on.
+ *
+ *  count is changed with lock xadd only. sem_wait() decrements it and owns a
+ *  resource right away if it was positive, and sem_signal() increments it
+ *  and is done if it was not negative, so neither of them touches the mutex
+ *  or the kernel when no thread has to block. A negative count is minus the
+ *  number of threads that have to block. sem_signal() that finds a negative
+ *  count hands its resource to one of them by incrementing num_wakeups with
+ *  the mutex held, and a blocked thread waits until num_wakeups is positive
+ *  and takes one, so a wakeup is never lost even if it comes first.
+ *
+ *  A destroyed semaphore has count SEM_DESTROYED, which is far below any 
+ *  count a live semaphore can reach.
  *  
  *  @author Jian Wang (jianwan3)
  *  @author Ke Wu (kewu)
@@ -16,6 +28,10 @@
 
 #include <sem.h>
 #include <assert.h>
+#include <thr_internals.h>
+
+/** @brief count of a destroyed semaphore */
+#define SEM_DESTROYED (-0x40000000)
 
 /** @brief Initialize semaphore
  *  
@@ -35,6 +51,7 @@ int sem_init(sem_t *sem, int count) {
     }
 
     sem->count = count; 
+    sem->num_wakeups = 0;
 
     return 0;
 }
@@ -48,24 +65,23 @@ int sem_init(sem_t *sem, int count) {
  *  @return void
  */
 void sem_wait(sem_t *sem) {
-    mutex_lock(&sem->mutex);
+    int count = asm_xadd(&sem->count, -1);
 
-    if(sem->count > 0) {
-        sem->count--;
-    } else {
-        if (sem->count < 0) {
-            panic("semaphore %p has already been destroied!", sem);
-        }
-
-        // sem->count is 0, should block
-        while(sem->count == 0) {
-            cond_wait(&sem->cond, &sem->mutex);
-            // Waked up, but others calling sem_wait may have made 
-            // sem->count 0 again, may need to block again
-        }
-        sem->count--;
+    if(count > 0) {
+        // got a resource without blocking
+        return;
+    }
+
+    if (count <= SEM_DESTROYED) {
+        panic("semaphore %p has already been destroied!", sem);
     }
 
+    // no resource available, wait for sem_signal() to hand one over
+    mutex_lock(&sem->mutex);
+    while(sem->num_wakeups == 0) {
+        cond_wait(&sem->cond, &sem->mutex);
+    }
+    sem->num_wakeups--;
     mutex_unlock(&sem->mutex);
 }
 
@@ -78,19 +94,23 @@ void sem_wait(sem_t *sem) {
  *  @return void
  */
 void sem_signal(sem_t *sem) {
-    mutex_lock(&sem->mutex);
-    
-    if (sem->count < 0) {
-        panic("semaphore %p has already been destroied!", sem);
-    }
+    int count = asm_xadd(&sem->count, 1);
 
-    sem->count++;
+    if (count >= 0) {
+        // no thread is waiting
+        return;
+    }
 
-    mutex_unlock(&sem->mutex);
+    if (count <= SEM_DESTROYED) {
+        panic("semaphore %p has already been destroied!", sem);
+    }
 
-    // Wake up one
+    // hand the resource to a waiting thread and wake up one, with the mutex
+    // held so that sem_destroy() can not run in between
+    mutex_lock(&sem->mutex);
+    sem->num_wakeups++;
     cond_signal(&sem->cond);
-
+    mutex_unlock(&sem->mutex);
 }
 
 /** @brief Deactivate a semaphore
@@ -100,19 +120,21 @@ void sem_signal(sem_t *sem) {
  *  @return void
  */
 void sem_destroy(sem_t *sem) {
+    int count = sem->count;
 
-    mutex_lock(&sem->mutex);
-
-    if (sem->count < 0) {
+    if (count <= SEM_DESTROYED) {
         panic("semaphore %p has already been destroied!", sem);
     }
 
-    sem->count = -1;
-    
+    // It's illegal to destroy a semaphore while threads are waiting on it,
+    // including a thread that has been handed a wakeup but not taken it
+    mutex_lock(&sem->mutex);
+    if (count < 0 || sem->num_wakeups != 0 ||
+            asm_cmpxchg(&sem->count, count, SEM_DESTROYED) != count) {
+        panic("semaphore %p is destroyed while in use!", sem);
+    }
     mutex_unlock(&sem->mutex);
 
     mutex_destroy(&sem->mutex);
     cond_destroy(&sem->cond);
 }
-
-
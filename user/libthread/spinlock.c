@@ -0,0 +1,97 @@
+/** @file spinlock.c
+ *  @brief Slow path and tuning of spinlock
+ *
+ *  See spinlock.h for the design.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <spinlock.h>
+#include <syscall.h>
+#include <thr_internals.h>
+
+/** @brief Number of pauses spun before yielding to the holder */
+static int max_spin = MAX_SPIN_NUM;
+
+/** @brief Maximum number of pauses between two reads of a lock */
+static int max_backoff = MAX_BACKOFF_NUM;
+
+/** @brief If every thread has its ktid in its tcb, set by thr_init() */
+static int is_thr_init;
+
+/** @brief Get the value the calling thread stores in the locks it holds
+ *
+ *  @return The ktid of the calling thread; SPINLOCK_ANON before thr_init()
+ */
+int spinlock_self() {
+    return is_thr_init ? thr_getktid() : SPINLOCK_ANON;
+}
+
+/** @brief Acquire a spinlock that was not free at the first try
+ *
+ *  @param lock The spinlock
+ *
+ *  @return void
+ */
+void spinlock_lock_slow(spinlock_t *lock) {
+    int self = spinlock_self();
+
+    while (1) {
+        int spun = 0;
+        int backoff = 1;
+        int holder;
+
+        // try at least once, even with a spin budget of 0
+        do {
+            // test before test-and-set, a read keeps the line shared
+            if (*(volatile int *)lock == SPINLOCK_FREE &&
+                asm_cmpxchg(lock, SPINLOCK_FREE, self) == SPINLOCK_FREE)
+                return;
+
+            int i;
+            for (i = 0; i < backoff; i++)
+                asm_pause();
+            spun += backoff;
+            if (backoff < max_backoff)
+                backoff <<= 1;
+        } while (spun < max_spin);
+
+        holder = *(volatile int *)lock;
+        if (holder == SPINLOCK_FREE)
+            continue;
+        // the holder may have exited or not be runnable, yield to anyone
+        if (holder == SPINLOCK_ANON || holder == self || yield(holder) < 0)
+            yield(-1);
+    }
+}
+
+/** @brief Tell spinlock that every thread has its ktid in its tcb
+ *
+ *  Called by thr_init() once the TLS block of the root thread is set, the 
+ *  holder of a lock is recorded from then on.
+ *
+ *  @return void
+ */
+void spinlock_thr_init() {
+    is_thr_init = 1;
+}
+
+/** @brief Set how long a thread spins for a spinlock before yielding
+ *
+ *  @param spin Number of pauses spun before yielding to the holder, 0 to 
+ *              yield after a single try
+ *  @param backoff Maximum number of pauses between two reads of a lock
+ *
+ *  @return 0 on success; -1 if an argument is out of range
+ */
+int thr_set_spin(int spin, int backoff) {
+    if (spin < 0 || backoff < 1)
+        return -1;
+
+    max_spin = spin;
+    max_backoff = backoff;
+    return 0;
+}
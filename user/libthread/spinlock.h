@@ -2,17 +2,20 @@
  *
  *  @brief Constains the macro implementation of spinlock
  *  
- *  Using xchg insturction achieve a simple spinlock. 
- *  It simply tries to acqure a lock for a 
- *  limited times until it defers trying through yielding. The design 
- *  choice related to it is whether to yield immediately if a lock is not 
- *  available. In a single core machine, if a lock is not available, then it's 
- *  likely other thread not running is holding the lock, so the current thread 
- *  should yield immediately; in a multi-core machine, the thread that is 
- *  holding the lock may be running as well and is likely to release the lock 
- *  in a short time, so it makes sense for the current thread to try acquring 
- *  for a few times instead of yielding immediately. To adapt to work well in a
- *  multi-threaded environment, our spinlock tries a few times before it yields.
+ *  The lock word is SPINLOCK_FREE when the lock is available, otherwise it 
+ *  is the ktid of the holder (or SPINLOCK_ANON if the holder is not known, 
+ *  e.g. before thr_init()). SPINLOCK_LOCK() tries a single cmpxchg, which 
+ *  is all an uncontended lock costs, and falls back to spinlock_lock_slow().
+ *
+ *  The slow path spins test-and-test-and-set: it only reads the lock word 
+ *  until it looks free, so waiters spin in their own cache instead of 
+ *  bouncing the line with locked instructions, and it backs off 
+ *  exponentially with pause between reads. In a single core machine the 
+ *  holder can not run while we spin, and in a multi-core machine it is 
+ *  likely to release the lock soon, so we spin for a bounded budget and then
+ *  yield to the holder, letting it finish its critical section rather than 
+ *  handing the CPU to an arbitrary thread. The budget is set by 
+ *  thr_set_spin().
  *
  *  @author Jian Wang (jianwan3)
  *  @author Ke Wu (kewu)
@@ -27,31 +30,35 @@
 /**@ brief spinlock type */
 typedef int spinlock_t;
 
-/**@ brief Maximal number of spinning times trying to acquire a lock */
+/**@ brief Default number of pauses spun before yielding to the holder */
 #define MAX_SPIN_NUM  1000
 
+/**@ brief Default maximum number of pauses between two reads of a lock */
+#define MAX_BACKOFF_NUM  64
+
+/**@ brief Lock word of an available lock */
+#define SPINLOCK_FREE  0
+
+/**@ brief Lock word of a lock held by an unknown thread */
+#define SPINLOCK_ANON  (-1)
+
 /**@ brief Initialize spin lock */
-#define SPINLOCK_INIT(lock)     *(lock) = 1
+#define SPINLOCK_INIT(lock)     *(lock) = SPINLOCK_FREE
 
-/**@ brief Destory spin lock */
-#define SPINLOCK_DESTROY(lock)  asm_xchg(lock, 0)
+/**@ brief Destory spin lock, it is held by nobody forever */
+#define SPINLOCK_DESTROY(lock)  asm_xchg(lock, SPINLOCK_ANON)
 
 /**@ brief Lock spin lock */
 #define SPINLOCK_LOCK(lock)     do { \
-    while (1) { \
-        int i = 0; \
-        while (i<MAX_SPIN_NUM &&   \
-                !asm_xchg(lock, 0)) \
-        i++; \
-        if (i==MAX_SPIN_NUM) \
-        yield(-1); \
-        else \
-        break; \
-    } \
+    if (asm_cmpxchg(lock, SPINLOCK_FREE, spinlock_self()) != SPINLOCK_FREE) \
+        spinlock_lock_slow(lock); \
 } while(0)
 
 /**@ brief Unlock spin lock */
-#define SPINLOCK_UNLOCK(lock)   asm_xchg(lock, 1)
+#define SPINLOCK_UNLOCK(lock)   asm_xchg(lock, SPINLOCK_FREE)
 
-#endif /* _SPINLOCK_H */
+int spinlock_self();
+void spinlock_lock_slow(spinlock_t *lock);
+void spinlock_thr_init();
 
+#endif /* _SPINLOCK_H */
@@ -10,6 +10,11 @@
 #ifndef THR_INTERNALS_H
 #define THR_INTERNALS_H
 
+#include <thread_ext.h>
+
+/** @brief Node of a thread waiting on a mutex, see mutex_type.h */
+struct mutex_node;
+
 /** @brief C wrapper for xchg(lock_available, val)
  *  
  *  In the inside, it will atomically exchange *lock_available with val
@@ -21,6 +26,37 @@
  */
 int asm_xchg(int *lock_available, int val);
 
+/** @brief C wrapper for lock cmpxchg
+ *  
+ *  In the inside, it will atomically set *addr to val if *addr equals
+ *  expected
+ *
+ *  @param addr The address of variable to be compared and exchanged
+ *  @param expected The value *addr is expected to be
+ *  @param val The value to replace *addr if *addr equals expected
+ * 
+ *  @return The old value of (*addr), the exchange happened iff it equals 
+ *          expected
+ */
+int asm_cmpxchg(int *addr, int expected, int val);
+
+/** @brief C wrapper for lock xadd
+ *  
+ *  In the inside, it will atomically add val to *addr
+ *
+ *  @param addr The address of variable to be added to
+ *  @param val The value to add
+ * 
+ *  @return The old value of (*addr)
+ */
+int asm_xadd(int *addr, int val);
+
+/** @brief Execute pause, a hint that the caller is spin-waiting
+ *
+ *  @return void
+ */
+void asm_pause();
+
 /** @brief Creates a new thread to run func(args) on a given stack
  *  
  *  This function is writtrn in assembly. It will create a thread 
@@ -29,8 +65,9 @@ int asm_xchg(int *lock_available, int val);
  *  To be more specific, this function will first save its two parameters to
  *  registers. Then it will invoke thread_fork which is a trap. After that, two
  *  threads will run the same code. The original thread will just return. The 
- *  new thread will first get its ktid, and call arraytcb_set_ktid() to save its
- *  ktid in arraytcb. Then it will set its esp to new_stack, and call func(). 
+ *  new thread will set its esp to new_stack, get its ktid, and call 
+ *  thr_child_init() to save its ktid in its tcb and set its TLS base to its 
+ *  tcb. Then it will call func(). 
  *  After return from func(), it will push the return value to stack, and call
  *  thr_exit() if the thread doesn't call itself.
  *
@@ -44,7 +81,8 @@ int asm_xchg(int *lock_available, int val);
  *  @param func The address of function for new thread to run
  *  @param new_stack The address of new stack (esp) for new thread to run on.
  *                   Note that the argument for new thread to run func(args) has 
- *                   been pushed to stack conforming to the calling conventions.
+ *                   been pushed to stack conforming to the calling conventions,
+ *                   and the tcb of the new thread is at new_stack.
  * 
  *  @return On success the thread ID of the new thread is returned, on error a 
  *          negative number is returned
@@ -53,9 +91,21 @@ int thr_create_kernel(void *(*func)(void *), void *new_stack);
 
 int thr_getktid();
 
-int thr_hashtableexit_init();
+/** @brief Get the TLS block of the calling thread
+ *  
+ *  The TLS block of a thread is its tcb, which is the base of the TLS 
+ *  segment loaded in %gs by set_tls_base(), and its first word points to
+ *  itself, so the block is found with a single load from %gs:0.
+ *
+ *  It must not be called by a thread before thr_init() or by a new thread 
+ *  before thr_create_kernel() has set its TLS base.
+ * 
+ *  @return The TLS block of the calling thread
+ */
+void *asm_get_tls();
 
-int thr_exitstatus_hashfunc(void *key);
+struct tcb_s;
+int thr_child_init(struct tcb_s *thr, int ktid);
 
 /** @brief Delete a thread from arraytcb and vanish
  *  
@@ -68,6 +118,12 @@ int thr_exitstatus_hashfunc(void *key);
  *          remove_pages(page_remove_info[2]);
  *      if (page_remove_info[5])
  *          remove_pages(page_remove_info[4]);
+ *      if (lock_state)
+ *          *lock_state = new_state;
+ *      else {
+ *          waiter->reject = 1;
+ *          make_runnable(waiter->ktid);
+ *      }
  *      SPINLOCK_UNLOCK(&mutex_arraytcb->inner_lock);
  *      vanish();
  *  However, it must be written in assembly because when stack region is
@@ -81,10 +137,18 @@ int thr_exitstatus_hashfunc(void *key);
  *                          indicate which pages should be deallcated. More info
  *                          please refer to thr_lib_helper.c 
  *                          get_pages_to_remove().
+ *  @param lock_state The address of mutex_arraytcb->lock_state if the mutex
+ *                    should be released after the stack is removed, NULL if
+ *                    the mutex has been handed over to another thread
+ *  @param new_state The value to set *lock_state to
+ *  @param waiter The waiter that mutex_arraytcb has been handed over to if 
+ *                lock_state is NULL. It is woken up only after the stack is 
+ *                removed, because it may reuse the stack slot right away
  * 
  *  @return Should never return
  */
-void asm_thr_exit(void *inner_lock, int* page_remove_info);
+void asm_thr_exit(void *inner_lock, int* page_remove_info, int *lock_state,
+                  int new_state, struct mutex_node *waiter);
 
 /** @brief Indicate a symbol in thr_create_kernel()
  *  
@@ -2,10 +2,13 @@
  *  @brief This file contains implementation of thread management library 
  *
  *  This file contains thread management library including thr_init(), 
- *  thr_create(), thr_join(), thr_exit(), thr_getid(), thr_getktid(), 
- *  thr_yield(). Some functions will lock the entire arraytcb data strcuture to
- *  avoid race condition although we have figured out that probably it is better
- *  to allocate a mutex lock for each tcb structure to support more concurrency.
+ *  thr_create(), thr_join(), thr_detach(), thr_exit(), thr_getid(), 
+ *  thr_getktid(), thr_yield(), thr_set_stack_cache() and thread specific 
+ *  data. The tcb of each thread is also its TLS block, found through %gs, so
+ *  a thread finds its own tcb in O(1) without looking at its stack. Some 
+ *  functions will lock the entire arraytcb data strcuture to avoid race 
+ *  condition although we have figured out that probably it is better to 
+ *  allocate a mutex lock for each tcb structure to support more concurrency.
  *
  *  @bug No known bug
  */
@@ -21,13 +24,12 @@
 #include <thr_lib_helper.h>
 #include <thr_internals.h>
 #include <arraytcb.h>
-#include <hashtable.h>
 
 /** @brief The initial size of arraytcb */
 #define INIT_THR_NUM 32
 
-/** @brief The size of hash table to stroe exit status */
-#define EXIT_HASH_SIZE 1021
+/** @brief Default maximum number of idle stacks kept mapped */
+#define DEFAULT_STACK_CACHE_SIZE 8
 
 /** @brief The size of page_remove_info array */
 #define PAGE_REMOVE_INFO_SIZE 6 
@@ -40,6 +42,9 @@ static int page_remove_info[PAGE_REMOVE_INFO_SIZE];
 /** @brief The amount of stack space available for each thread */
 static unsigned int stack_size;
 
+/** @brief Maximum number of idle stacks kept mapped for future threads */
+static int stack_cache_size = DEFAULT_STACK_CACHE_SIZE;
+
 /** @brief Number of threads created */
 static unsigned int thread_count;
 
@@ -49,8 +54,75 @@ static mutex_t mutex_thread_count;
 /** @brief Mutex to protect arraytcb */
 static mutex_t mutex_arraytcb;
 
-/** @brief Hash table to store exit status of exiting thread */
-static hashtable_t hash_exit;
+/** @brief Number of thread specific data keys created */
+static int num_keys;
+
+/** @brief tcbs of exited detached threads, linked by tid_next, waiting to be
+ *         freed by the next thread that joins or exits */
+static tcb_t *reaped_tcbs;
+
+/** @brief Free the tcbs of exited detached threads
+ *
+ *  An exiting thread can not free its own tcb, which is its TLS block, so 
+ *  it leaves the tcb in reaped_tcbs instead. It is freed by the next 
+ *  thr_join() or thr_exit() of any thread.
+ *
+ *  @return void
+ */
+static void free_reaped_tcbs() {
+    if (!reaped_tcbs)
+        return;
+
+    mutex_lock(&mutex_arraytcb);
+    tcb_t *thr = reaped_tcbs;
+    reaped_tcbs = NULL;
+    mutex_unlock(&mutex_arraytcb);
+
+    while (thr) {
+        tcb_t *next = thr->tid_next;
+        cond_destroy(&thr->cond_var);
+        free(thr);
+        thr = next;
+    }
+}
+
+/** @brief Undo arraytcb_insert_thread() for a thread that failed to start
+ *
+ *  The slot is deleted and the tcb is removed from the tid index and freed.
+ *  If the slot doesn't go to the stack cache, whatever part of its stack is 
+ *  mapped is removed. The pages are removed while arraytcb is locked, like 
+ *  thr_exit() does, so that no thread can map a shared page in between.
+ *
+ *  @param thr The tcb of the thread
+ *  @param is_stack_ok 1 if the stack of the slot is completely mapped, 0 if 
+ *                     mapping it failed half way
+ *
+ *  @return void
+ */
+static void thr_create_undo(tcb_t *thr, int is_stack_ok) {
+    int remove_info[PAGE_REMOVE_INFO_SIZE];
+    int i;
+
+    mutex_lock(&mutex_arraytcb);
+
+    int is_cached = arraytcb_delete_thread(thr->index, 
+                                           is_stack_ok ? stack_cache_size : 0);
+    arraytcb_remove_thread(thr);
+
+    if (is_cached == 0) {
+        // some pages may not be mapped, removing them just fails
+        get_pages_to_remove(thr->index, remove_info);
+        for (i = 0; i < PAGE_REMOVE_INFO_SIZE; i += 2) {
+            if (remove_info[i + 1])
+                remove_pages((void*)remove_info[i]);
+        }
+    }
+
+    mutex_unlock(&mutex_arraytcb);
+
+    cond_destroy(&thr->cond_var);
+    free(thr);
+}
 
 /** @brief Initialize the thread library
  *
@@ -78,12 +150,17 @@ int thr_init(unsigned int size) {
 
     is_error |= thr_lib_helper_init(stack_size);
 
-    is_error |= thr_hashtableexit_init();
-
     // insert master thread to arraytcb
-    is_error |= arraytcb_insert_thread(0, &mutex_arraytcb);
-    // set ktid for master thread
-    is_error |= arraytcb_set_ktid(0, gettid());
+    int is_stack_mapped;
+    is_error |= arraytcb_insert_thread(0, &mutex_arraytcb, &is_stack_mapped);
+    // set ktid and TLS for master thread
+    is_error |= thr_child_init(arraytcb_get_thread(0), gettid());
+
+    // the tcb of a thread can be used to select thread caches from now on
+    if (!is_error) {
+        spinlock_thr_init();
+        malloc_thr_init();
+    }
 
     return is_error ? -1 : 0;
 }
@@ -106,14 +183,24 @@ int thr_create(void *(*func)(void *), void *args) {
     mutex_unlock(&mutex_thread_count);
 
     uint32_t stack_addr = 0;
+    int is_stack_mapped;
     
-    int index = arraytcb_insert_thread(tid, &mutex_arraytcb);
+    int index = arraytcb_insert_thread(tid, &mutex_arraytcb, &is_stack_mapped);
     if(index == -1) return -1;
 
-    // allocate a stack with stack_size for new thread
-    if ((stack_addr = (uint32_t)get_new_stack_top(index)) 
-            % ALIGNMENT != 0){
+    // allocate a stack with stack_size for new thread, unless the slot is 
+    // from the stack cache and its stack is still mapped
+    if (is_stack_mapped)
+        stack_addr = get_stack_top(index);
+    else
+        stack_addr = get_new_stack_top(index);
+    mutex_lock(&mutex_arraytcb);
+    tcb_t *new_thr = arraytcb_get_thread(index);
+    mutex_unlock(&mutex_arraytcb);
+
+    if (stack_addr % ALIGNMENT != 0){
         // return value can not be divided by ALIGNMENT, it is an error 
+        thr_create_undo(new_thr, 0);
         return -1;
     }
 
@@ -122,14 +209,15 @@ int thr_create(void *(*func)(void *), void *args) {
 
     // "push" ktid to new stack --> will do in thr_create_kernel()
 
-    // "push" stack index to new stack  
-    memcpy((void*)(stack_addr-12), &index, 4);
+    // "push" tcb to new stack  
+    memcpy((void*)(stack_addr-12), &new_thr, 4);
 
     // create a new thread, tell it where it should start running (eip), and
     // its stack address (esp)
     int child_ktid;
     if ((child_ktid = thr_create_kernel(func, (void*)(stack_addr-12))) < 0) {
         // thread_fork error
+        thr_create_undo(new_thr, 1);
         return -1;
     }
 
@@ -152,8 +240,8 @@ int thr_create(void *(*func)(void *), void *args) {
 /** @brief Join and clean up a thread
  *  
  *  This function joins a thread, if the thread is running, block
- *  and wait for it; else, look up its return status in the exit 
- *  hashtable and clean up the hashtable entry.
+ *  and wait for it. Then take its exit status from its tcb and destroy 
+ *  the tcb.
  * 
  *  @param tid The thread id (assigned by our thread lib) to join on
  *  @param statusp The place to store return status of the thread to join 
@@ -162,58 +250,74 @@ int thr_create(void *(*func)(void *), void *args) {
  *
  */
 int thr_join(int tid, void **statusp) {
-    // check if tid has been created 
-    mutex_lock(&mutex_thread_count);
-    if (tid >= thread_count){
-        mutex_unlock(&mutex_thread_count);
-        return -1;
-    }
-    mutex_unlock(&mutex_thread_count);
-
-    // try to find the tcb
     mutex_lock(&mutex_arraytcb);
+
+    // the tcb stays in the tid index until the thread is joined
     tcb_t* thr = arraytcb_find_thread(tid);
-    if (thr) {
-        // tid can be found in arraytcb, it is still running
-        switch(thr->state){
-        case JOINED:
-            // tid has been joined by other thread
-            mutex_unlock(&mutex_arraytcb);
-            return -1;
-        case RUNNING:
-            // tid is still running, block and waiting for it
-            thr->state = JOINED;
-            cond_wait(&thr->cond_var, &mutex_arraytcb);
-            break;
-        default:
-            // tcb state error
-            return -1;;
-        } 
+    if (!thr || thr->is_joined) {
+        // tid doesn't exist, has been reaped, or is joined by other thread
+        mutex_unlock(&mutex_arraytcb);
+        return -1;
     }
 
-    // thread of tid has exitted
+    thr->is_joined = 1;
+    while (thr->state != EXITED)
+        cond_wait(&thr->cond_var, &mutex_arraytcb);
+
+    arraytcb_remove_thread(thr);
     mutex_unlock(&mutex_arraytcb);
 
-    // try to find exit status of tid in hash table
-    int is_find;
+    // the exiting thread doesn't touch its tcb after releasing the mutex
     if (statusp)
-        *statusp = hashtable_remove(&hash_exit, (void*)tid, &is_find);
-    else
-        hashtable_remove(&hash_exit, (void*)tid, &is_find);
+        *statusp = thr->exit_status;
+    cond_destroy(&thr->cond_var);
+    free(thr);
 
-    if (is_find) {
-        return 0;
-    } else {
-        // Can not find exit status of tid in hash table, might already been 
-        // reaped by other thread
+    // free the tcbs of detached threads that have exited meanwhile
+    free_reaped_tcbs();
+
+    return 0;
+}
+
+/** @brief Detach a thread so that it is cleaned up without a join
+ *  
+ *  A detached thread can not be joined. Its tcb is freed when it exits, or
+ *  right now if it has exited.
+ * 
+ *  @param tid The thread id (assigned by our thread lib) to detach
+ *
+ *  @return 0 on success; -1 if the thread doesn't exist or is joined
+ *
+ */
+int thr_detach(int tid) {
+    mutex_lock(&mutex_arraytcb);
+
+    tcb_t* thr = arraytcb_find_thread(tid);
+    if (!thr || thr->is_joined) {
+        mutex_unlock(&mutex_arraytcb);
         return -1;
     }
-   
+
+    // no thread can join it from now on
+    thr->is_joined = 1;
+    if (thr->state != EXITED) {
+        thr->is_detached = 1;
+        mutex_unlock(&mutex_arraytcb);
+        return 0;
+    }
+
+    arraytcb_remove_thread(thr);
+    mutex_unlock(&mutex_arraytcb);
+
+    cond_destroy(&thr->cond_var);
+    free(thr);
+
+    return 0;
 }
 
 /** @brief Exits the thread with exit status
  *  
- *  Report exit status in exit hashtable, delete the its tcb, 
+ *  Report exit status in its tcb, delete it from arraytcb, 
  *  release its stack space and call vanish().
  * 
  *  @param status The return status
@@ -222,29 +326,34 @@ int thr_join(int tid, void **statusp) {
  *
  */
 void thr_exit(void *status) {
-    // Get stack position index of the current thread
-    int index = get_stack_position_index();
+    // get my tcb and stack position index
+    tcb_t *thr = THR_SELF();
+    int index = thr->index;
 
-    // get my tcb
-    tcb_t *thr = arraytcb_get_thread(index);
-    if(thr == NULL) {
-        // Something's wrong
-        panic("thr_exit() failed, can not find tcb, something's wrong");
-    }
+    // free the tcbs of detached threads that exited before this one, the 
+    // tcb of this thread, if detached, is freed by the next one
+    free_reaped_tcbs();
     
-    // put exit status to hash table for future reaping
-    hashtable_put(&hash_exit, (void*)(thr->tid), status);
-
     mutex_lock(&mutex_arraytcb);
 
-    // check if some threads has called join on it
-    if(thr->state == JOINED) {
+    // keep exit status in the tcb for future reaping
+    thr->exit_status = status;
+    thr->state = EXITED;
+
+    if (thr->is_detached) {
+        // nobody will join, leave the tcb to be freed by another thread
+        arraytcb_remove_thread(thr);
+        thr->tid_next = reaped_tcbs;
+        reaped_tcbs = thr;
+    } else if(thr->is_joined) {
+        // check if some threads has called join on it
         // Signal the thread who called join
         cond_signal(&thr->cond_var);
     } 
 
-    // release resource
-    if(arraytcb_delete_thread(index) < 0) {
+    // release resource, the stack is kept mapped if it goes to stack cache
+    int is_cached = arraytcb_delete_thread(index, stack_cache_size);
+    if(is_cached < 0) {
         panic("thr_exit() failed, can not delete tcb of %d", thr->tid);
     }
 
@@ -264,65 +373,128 @@ void thr_exit(void *status) {
     // call mutex_unlock(mutex_arraytcb) "manually" to avoid "unlocking"
     SPINLOCK_LOCK(&mutex_arraytcb.inner_lock);
 
-    node_t *tmpnode = dequeue(&mutex_arraytcb.deque);
+    mutex_node_t *waiter = Q_GET_FRONT(&mutex_arraytcb.waiters);
+    int *lock_state = NULL;
 
-    if (!tmpnode) {
-        mutex_arraytcb.lock_available = 1;
+    if (!waiter) {
+        // nobody is waiting, the mutex will be set to available in 
+        // asm_thr_exit() after the stack is removed
+        lock_state = &mutex_arraytcb.lock_state;
     } else {
-        tmpnode->reject = 1;
+        // hand over the mutex to the thread in the head of queue
+        Q_REMOVE(&mutex_arraytcb.waiters, waiter, link);
+        asm_xchg(&mutex_arraytcb.lock_state, 
+                 Q_GET_FRONT(&mutex_arraytcb.waiters) == NULL ? 
+                 MUTEX_LOCKED : MUTEX_CONTENDED);
+        // the waiter is woken up in asm_thr_exit() after the stack is 
+        // removed, it may reuse the stack slot as soon as it runs
     }
 
-    get_pages_to_remove(index, page_remove_info);
+    if (is_cached) {
+        page_remove_info[HIGHEST_PAGE_CAN_REMOVE] = 0;
+        page_remove_info[MIDDLE_PAGES_CAN_REMOVE] = 0;
+        page_remove_info[LOWEST_PAGE_CAN_REMOVE] = 0;
+    } else {
+        get_pages_to_remove(index, page_remove_info);
+    }
 
-    // will call SPINLOCK_UNLOCK(&mutex_arraytcb->inner_lock), remove_page() abd
-    //  vanish() in asm_thr_exit() to avoid using stack
-    asm_thr_exit(&mutex_arraytcb.inner_lock, page_remove_info);
+    // will call remove_page(), set *lock_state to MUTEX_UNLOCKED or wake up
+    // the waiter, SPINLOCK_UNLOCK(&mutex_arraytcb->inner_lock) and vanish() 
+    // in asm_thr_exit() to avoid using stack
+    asm_thr_exit(&mutex_arraytcb.inner_lock, page_remove_info, lock_state, 
+                 MUTEX_UNLOCKED, waiter);
 
     panic("reach a place in thr_exit() that should never be reached");
     return;
 
 }
 
-/** @brief Get calling thread's thread id assigned by the thread lib
+/** @brief Set the ktid and TLS of a thread, called by the thread itself
  *  
- *  Look up tid in arraytcb
+ *  It is called by thr_init() for the master thread and by 
+ *  thr_create_kernel() for a new thread before it runs anything else.
  *
- *  @return tid on success; -1 on error
+ *  @param thr The tcb of the calling thread
+ *  @param ktid The ktid of the calling thread
+ *
+ *  @return 0 on success; -1 on error
  *
  */
-int thr_getid() {
-    // Get stack position index of the current thread
-    int index = get_stack_position_index();
-
-    // get my tcb
-    tcb_t *thr = arraytcb_get_thread(index);
-    if(thr == NULL) {
-        // can not find my tcb, something wrong...
+int thr_child_init(tcb_t *thr, int ktid) {
+    if (thr == NULL)
         return -1;
-    }
 
-    return thr->tid;
+    thr->ktid = ktid;
+
+    // the tcb is the TLS block, %gs:0 points to it from now on
+    return set_tls_base(thr) < 0 ? -1 : 0;
+}
+
+/** @brief Get calling thread's thread id assigned by the thread lib
+ *  
+ *  Look up tid in the tcb, which is the TLS block of the thread
+ *
+ *  @return tid
+ *
+ */
+int thr_getid() {
+    return THR_SELF()->tid;
 }
 
 /** @brief Get calling thread's thread id assigned by the kernel
  *  
- *  Look up ktid in arraytcb
+ *  Look up ktid in the tcb, which is the TLS block of the thread
  *
- *  @return ktid on success; -1 on error
+ *  @return ktid
  *
  */
 int thr_getktid() {
-    // Get stack position index of the current thread
-    int index = get_stack_position_index();
+    return THR_SELF()->ktid;
+}
 
-    // get my tcb
-    tcb_t *thr = arraytcb_get_thread(index);
-    if(thr == NULL) {
-        // can not find my tcb, something wrong...
+/** @brief Create a thread specific data key
+ *
+ *  Every thread has its own value for a key, which is NULL until the 
+ *  thread sets it. Keys can not be deleted.
+ *
+ *  @return The key on success; -1 if all THR_TLS_KEYS keys are used
+ *
+ */
+int thr_key_create(void) {
+    int key = asm_xadd(&num_keys, 1);
+    if (key >= THR_TLS_KEYS) {
+        asm_xadd(&num_keys, -1);
         return -1;
     }
+    return key;
+}
 
-    return thr->ktid;
+/** @brief Get the value of a thread specific data key of calling thread
+ *
+ *  @param key The key from thr_key_create()
+ *
+ *  @return The value; NULL if the key is not valid or not set
+ *
+ */
+void *thr_getspecific(int key) {
+    if (key < 0 || key >= THR_TLS_KEYS)
+        return NULL;
+    return THR_SELF()->specific[key];
+}
+
+/** @brief Set the value of a thread specific data key of calling thread
+ *
+ *  @param key The key from thr_key_create()
+ *  @param value The value
+ *
+ *  @return 0 on success; -1 if the key is not valid
+ *
+ */
+int thr_setspecific(int key, void *value) {
+    if (key < 0 || key >= THR_TLS_KEYS)
+        return -1;
+    THR_SELF()->specific[key] = value;
+    return 0;
 }
 
 /** @brief Defers execution of the invoking thread
@@ -340,7 +512,7 @@ int thr_yield(int tid) {
     mutex_lock(&mutex_arraytcb);
     tcb_t *thr = arraytcb_find_thread(tid);
     
-    if (!thr){
+    if (!thr || thr->state == EXITED){
         // tid doesn't exist
         mutex_unlock(&mutex_arraytcb);
         return -1;
@@ -353,31 +525,24 @@ int thr_yield(int tid) {
 
 }
 
-/** @brief Initialize exit_status hash table
- *  
- *  First set hash table size and hash function.
- *  Then invoke hashtable_init() API to do initialization.
+/** @brief Set how many idle thread stacks are kept mapped
+ *
+ *  When a thread exits, its stack is kept mapped if there are less than 
+ *  max_idle idle stacks, so that the next thr_create() can reuse it without 
+ *  any new_pages() or remove_pages(). Setting it to 0 disables the cache. 
+ *  Stacks that are already cached stay mapped until they are reused.
  *
- *  @return On success return 0, on error return a negative number
+ *  @param max_idle Maximum number of idle stacks to keep mapped
+ *
+ *  @return 0 on success; -1 on error
  */
-int thr_hashtableexit_init() {
-    hash_exit.size = EXIT_HASH_SIZE;
-    hash_exit.func = thr_exitstatus_hashfunc;
-    return hashtable_init(&hash_exit);
-}
+int thr_set_stack_cache(int max_idle) {
+    if (max_idle < 0)
+        return -1;
 
-/** @brief The hash function for exit_status hash table
- *  
- *  Exit_status hash table takes tid as key and exit status as value. So this 
- *  hash function simply uses modular to do hashing. Note that this hash 
- *  function is specific for exit_status hash table.
- *  
- *  @param key The key to calculate index of exit_status hash table
- * 
- *  @return The index of exit_status hash table 
- */
-int thr_exitstatus_hashfunc(void *key) {
-    int tid = (int)key;
-    return tid % EXIT_HASH_SIZE;
-}
+    mutex_lock(&mutex_arraytcb);
+    stack_cache_size = max_idle;
+    mutex_unlock(&mutex_arraytcb);
 
+    return 0;
+}
@@ -49,6 +49,33 @@ int thr_lib_helper_init(unsigned int size) {
     return 0;
 }
 
+/** @brief Get stack top of a stack 'slot'
+ *
+ *  The stack of the slot must have been allocated by get_new_stack_top()
+ *  before, e.g. when the slot is reused from the stack cache.
+ *
+ *  @param index The index of thread stacks (0 based)
+ *
+ *  @return Stack top of the slot
+ */
+uint32_t get_stack_top(int index) {
+    if(index == 0) {
+        return root_thread_stack_low;
+    }
+
+    uint32_t new_thread_stack_high = root_thread_stack_low - 
+        index * stack_size + stack_size - 1;
+
+    // The 1st available new stack position is last thread's stack low - 1
+    // Keep decrementing until it aligns with 4
+    uint32_t new_stack_top = new_thread_stack_high; 
+    while(new_stack_top % ALIGNMENT != 0) {
+        new_stack_top--;
+    }
+
+    return new_stack_top;
+}
+
 /** @brief Get stack top for a new thread
  *  
  *  Compute the stack region for a new thread, allocate new pages for its
@@ -139,14 +166,7 @@ uint32_t get_new_stack_top(int index) {
         } 
     }
 
-    // The 1st available new stack position is last thread's stack low - 1
-    // Keep decrementing until it aligns with 4
-    uint32_t new_stack_top = new_thread_stack_high; 
-    while(new_stack_top % ALIGNMENT != 0) {
-        new_stack_top--;
-    }
-
-    return new_stack_top;
+    return get_stack_top(index);
 }
 
 /** @brief Get the information about pages to remove in a thread's stack space
@@ -178,8 +198,6 @@ uint32_t get_pages_to_remove(int index, int *page_remove_info) {
     uint32_t new_thread_stack_high = new_thread_stack_low + 
         stack_size - 1;
 
-    tcb_t *thr;
-
     // The page address where new_thread_stack_high is in
     uint32_t new_thread_stack_high_page = new_thread_stack_high 
         & PAGE_ALIGN_MASK;
@@ -194,9 +212,8 @@ uint32_t get_pages_to_remove(int index, int *page_remove_info) {
             break;
         }
 
-        thr = arraytcb_get_thread(index - i);
-        if(thr) {
-            // There's thread alive
+        if(arraytcb_is_stack_in_use(index - i)) {
+            // There's thread alive or the stack is cached
             can_remove = 0;
             break;
         } 
@@ -239,9 +256,8 @@ uint32_t get_pages_to_remove(int index, int *page_remove_info) {
             break;
         }
 
-        thr = arraytcb_get_thread(index + i);
-        if(thr) {
-            // There's thread alive
+        if(arraytcb_is_stack_in_use(index + i)) {
+            // There's thread alive or the stack is cached
             can_remove = 0;
             break;
         } 
@@ -272,25 +288,6 @@ uint32_t get_pages_to_remove(int index, int *page_remove_info) {
 }
 
 
-/** @brief Get stack position index of the current thread 
- *  
- *
- *  @return Stack position index of the current thread
- */
-int get_stack_position_index() {
-
-    uint32_t esp = asm_get_esp();
-
-    if(esp <= root_thread_stack_high && esp >= root_thread_stack_low) {
-        return 0;
-    } else {
-        // (root_thread_stack_low - esp - 1) so that all esp within a stack 
-        // region maps to the same number
-        return 1 + (root_thread_stack_low - esp - 1) / stack_size;
-    }
-
-}
-
 /** @brief get old %ebp value based on current %ebp
  *
  *  @param ebp Value of current %ebp
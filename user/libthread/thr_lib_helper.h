@@ -37,7 +37,7 @@ uint32_t asm_get_ebp();
 int thr_lib_helper_init(unsigned int size);
 uint32_t get_pages_to_remove(int index, int *page_remove_info);
 uint32_t get_new_stack_top(int count);
-int get_stack_position_index();
+uint32_t get_stack_top(int index);
 void* get_last_ebp(void* ebp);
 void set_rootthr_retaddr();
 
@@ -135,7 +135,6 @@ void * chase(void * arg) {
 
 int main( int argc, char *argv[] ) {
     int i;
-    void * status_temporary; // not really used anymore
 
     thr_init(STACK_SIZE);
     REPORT_START_CMPLT;
@@ -186,9 +185,7 @@ int main( int argc, char *argv[] ) {
     for (i = 0; i < n_chasethreads; i++) {
         assert(thrgrp_create(&tg, chase, (void *)i) >= 0);
     }
-    for (i = 0; i < n_chasethreads; i++) {
-        assert(thrgrp_join(&tg, &status_temporary) == 0);
-    }
+    assert(thrgrp_join_all(&tg) == n_chasethreads);
 	free(mtxs);
     REPORT_END_SUCCESS; 
     thr_exit((void *)0);
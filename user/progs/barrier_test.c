@@ -0,0 +1,139 @@
+/**
+ * @file barrier_test.c
+ * @brief A stress test of barriers and latches with misbehavior
+ *
+ * For each misbehavior mode, NUM_THREADS threads are held at a start latch,
+ * then they run NUM_PHASES phases separated by a barrier. In every phase each
+ * thread counts its arrival, checks that no thread has arrived in the next
+ * phase yet, and after the barrier checks that every thread arrived. Exactly one
+ * thread of each phase must get BARRIER_SERIAL_THREAD. The main thread waits
+ * for all of them on a finish latch before it checks the results.
+ *
+ * @author Jian Wang (jianwan3)
+ * @author Ke Wu (kewu)
+ * @bug No known bugs.
+ */
+
+#include <thread.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <barrier.h>
+#include <latch.h>
+#include <thr_internals.h>
+
+#include "410_tests.h"
+DEF_TEST_NAME("barrier_test:");
+
+#define STACK_SIZE 4096
+#define NUM_THREADS 8
+#define NUM_PHASES 50
+#define MAX_MISBEHAVE 16
+
+barrier_t barrier;
+latch_t start_latch;
+latch_t finish_latch;
+
+int arrivals[NUM_PHASES + 1];
+int num_serial;
+int is_failed;
+
+void* racer(void* token);
+
+/**
+ * @brief Runs the phases for each misbehavior mode and checks the results
+ *
+ * @param argc The number of arguments
+ * @param argv The argument array
+ * @return 1 on success, < 0 on error.
+ */
+int main(int argc, char *argv[])
+{
+	int tids[NUM_THREADS];
+	int mode, i;
+
+	REPORT_LOCAL_INIT;
+
+	REPORT_START_CMPLT;
+
+	REPORT_ON_ERR(thr_init(STACK_SIZE));
+
+	for (mode = 0; mode < MAX_MISBEHAVE; mode++) {
+	  lprintf("%s%strying mode %d",TEST_PFX,test_name,mode);
+	  misbehave(mode);
+
+	  for (i = 0; i <= NUM_PHASES; i++)
+	    arrivals[i] = 0;
+	  num_serial = 0;
+
+	  REPORT_FAILOUT_ON_ERR(barrier_init(&barrier, NUM_THREADS));
+	  REPORT_FAILOUT_ON_ERR(latch_init(&start_latch, 1));
+	  REPORT_FAILOUT_ON_ERR(latch_init(&finish_latch, NUM_THREADS));
+
+	  for (i = 0; i < NUM_THREADS; i++)
+	    REPORT_FAILOUT_ON_ERR((tids[i] = thr_create(racer, (void*)i)));
+
+	  if (latch_try_wait(&finish_latch)) {
+	    REPORT_MISC("Finish latch opened before the start");
+	    REPORT_END_FAIL;
+	    thr_exit((void *)-40);
+	  }
+	  latch_count_down(&start_latch);
+	  latch_wait(&finish_latch);
+
+	  if (is_failed) {
+	    REPORT_MISC("Thread left the barrier before everyone arrived");
+	    REPORT_END_FAIL;
+	    thr_exit((void *)-60);
+	  }
+	  if (num_serial != NUM_PHASES) {
+	    REPORT_ERR("wrong number of serial threads: ", num_serial);
+	    REPORT_END_FAIL;
+	    thr_exit((void *)-80);
+	  }
+
+	  for (i = 0; i < NUM_THREADS; i++)
+	    REPORT_FAILOUT_ON_ERR(thr_join(tids[i], NULL));
+
+	  barrier_destroy(&barrier);
+	  latch_destroy(&start_latch);
+	  latch_destroy(&finish_latch);
+	}
+
+	REPORT_END_SUCCESS;
+	thr_exit((void *)0);
+	return 0;
+}
+
+/**
+ * @brief Runs all phases, checking the arrivals after each barrier
+ *
+ * @param token Index of the thread
+ * @return The passed in token.
+ */
+void* racer(void* token)
+{
+	int phase;
+
+	latch_wait(&start_latch);
+
+	for (phase = 0; phase < NUM_PHASES; phase++) {
+	  asm_xadd(&arrivals[phase], 1);
+	  if ((int)token == phase % NUM_THREADS)
+	    yield(-1);
+
+	  // Nobody can get past this phase before this thread arrives
+	  if (arrivals[phase + 1] != 0)
+	    is_failed = 1;
+
+	  if (barrier_wait(&barrier) == BARRIER_SERIAL_THREAD)
+	    asm_xadd(&num_serial, 1);
+
+	  if (arrivals[phase] != NUM_THREADS)
+	    is_failed = 1;
+	}
+
+	latch_count_down(&finish_latch);
+	return token;
+}
@@ -0,0 +1,124 @@
+/** @file bench_mem.c
+ *  @brief Benchmark for memory management
+ *
+ *  Measures:
+ *     new_pages:     new_pages() of a region of arg pages
+ *     remove_pages:  remove_pages() of a region of arg pages, untouched
+ *     zfod:          the first write to each page of a new region, which 
+ *                    takes a zero-fill-on-demand fault, per page
+ *     remove_dirty:  remove_pages() of a region of arg pages, all written
+ *     fork:          fork() and wait() with a dirty region of arg pages,
+ *                    which copies every page of the region, per page
+ *  See bench.h for the output format.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <syscall.h>
+#include <stdlib.h>
+#include <bench.h>
+
+/** @brief Number of regions of each size */
+#define NUM_ITERS 16
+
+/** @brief Base of the regions, far away from the heap and the stack */
+#define REGION_BASE ((char *)0x40000000)
+
+/** @brief Sizes of the regions, in pages */
+static int region_pages[] = { 1, 4, 16, 64, 256 };
+
+/** @brief Get the base of a region
+ *
+ *  @param index Index of the region
+ *  @param num_pages Number of pages of every region
+ *
+ *  @return Base of the region
+ */
+static char *region_base(int index, int num_pages) {
+    return REGION_BASE + index * num_pages * PAGE_SIZE;
+}
+
+/** @brief Allocate a region, or exit
+ *
+ *  @param index Index of the region
+ *  @param num_pages Number of pages of every region
+ *
+ *  @return void
+ */
+static void region_new(int index, int num_pages) {
+    if (new_pages(region_base(index, num_pages), num_pages * PAGE_SIZE) < 0)
+        exit(-1);
+}
+
+/** @brief Free a region, or exit
+ *
+ *  @param index Index of the region
+ *  @param num_pages Number of pages of every region
+ *
+ *  @return void
+ */
+static void region_remove(int index, int num_pages) {
+    if (remove_pages(region_base(index, num_pages)) < 0)
+        exit(-1);
+}
+
+/** @brief Write to every page of a region
+ *
+ *  @param index Index of the region
+ *  @param num_pages Number of pages of every region
+ *
+ *  @return void
+ */
+static void region_touch(int index, int num_pages) {
+    char *base = region_base(index, num_pages);
+    int i;
+    for (i = 0; i < num_pages; i++)
+        base[i * PAGE_SIZE] = 1;
+}
+
+int main() {
+    int num_sizes = sizeof(region_pages) / sizeof(region_pages[0]);
+    bench_t b;
+    int i, j;
+
+    for (i = 0; i < num_sizes; i++) {
+        int num_pages = region_pages[i];
+
+        bench_start(&b, "bench_mem", "new_pages", num_pages);
+        for (j = 0; j < NUM_ITERS; j++)
+            region_new(j, num_pages);
+        bench_end(&b, NUM_ITERS);
+
+        bench_start(&b, "bench_mem", "remove_pages", num_pages);
+        for (j = 0; j < NUM_ITERS; j++)
+            region_remove(j, num_pages);
+        bench_end(&b, NUM_ITERS);
+
+        // one iteration is one fault here
+        region_new(0, num_pages);
+        bench_start(&b, "bench_mem", "zfod", num_pages);
+        region_touch(0, num_pages);
+        bench_end(&b, num_pages);
+
+        // one iteration is one copied page here
+        bench_start(&b, "bench_mem", "fork", num_pages);
+        for (j = 0; j < NUM_ITERS; j++) {
+            int status;
+            int pid = fork();
+            if (pid == 0)
+                exit(0);
+            if (pid < 0 || wait(&status) < 0)
+                exit(-1);
+        }
+        bench_end(&b, NUM_ITERS * num_pages);
+
+        bench_start(&b, "bench_mem", "remove_dirty", num_pages);
+        region_remove(0, num_pages);
+        bench_end(&b, 1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+/** @file bench_print.c
+ *  @brief Benchmark for console output
+ *
+ *  Measures print() of lines of arg bytes, one iteration is one line. See 
+ *  bench.h for the output format.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <syscall.h>
+#include <string.h>
+#include <bench.h>
+
+/** @brief Number of lines printed of each length */
+#define NUM_ITERS 200
+
+/** @brief Maximum length of a line, including the newline */
+#define MAX_LINE_LEN 80
+
+/** @brief Lengths of the lines */
+static int line_lens[] = { 1, 16, 80 };
+
+/** @brief The line */
+static char line[MAX_LINE_LEN];
+
+int main() {
+    int num_lens = sizeof(line_lens) / sizeof(line_lens[0]);
+    bench_t b;
+    int i, j;
+
+    memset(line, '.', MAX_LINE_LEN);
+
+    for (i = 0; i < num_lens; i++) {
+        int len = line_lens[i];
+        line[len - 1] = '\n';
+
+        bench_start(&b, "bench_print", "print", len);
+        for (j = 0; j < NUM_ITERS; j++)
+            print(len, line);
+        bench_end(&b, NUM_ITERS);
+
+        line[len - 1] = '.';
+    }
+
+    return 0;
+}
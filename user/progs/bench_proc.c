@@ -0,0 +1,85 @@
+/** @file bench_proc.c
+ *  @brief Benchmark for process and thread life cycles
+ *
+ *  Measures:
+ *     fork_wait:   fork() a child that exits right away, and wait() for it
+ *     exec:        fork() a child that exec()s this program, which exits 
+ *                  right away, and wait() for it
+ *     thr_create:  thr_create() a thread that exits right away, and 
+ *                  thr_join() it
+ *  See bench.h for the output format.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <syscall.h>
+#include <thread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <bench.h>
+
+/** @brief Number of processes or threads created by each benchmark */
+#define NUM_ITERS 200
+
+/** @brief Stack size of a thread */
+#define STACK_SIZE 4096
+
+/** @brief Arguments to exec() this program so that it exits right away */
+static char *exit_args[] = { "bench_proc", "exit", 0 };
+
+/** @brief A thread that exits right away
+ *
+ *  @param arg Unused
+ *
+ *  @return NULL
+ */
+void *nop(void *arg) {
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    bench_t b;
+    int status;
+    int i;
+
+    if (argc > 1 && strcmp(argv[1], "exit") == 0)
+        return 0;
+
+    bench_start(&b, "bench_proc", "fork_wait", 0);
+    for (i = 0; i < NUM_ITERS; i++) {
+        int pid = fork();
+        if (pid == 0)
+            exit(0);
+        if (pid < 0 || wait(&status) < 0)
+            exit(-1);
+    }
+    bench_end(&b, NUM_ITERS);
+
+    bench_start(&b, "bench_proc", "exec", 0);
+    for (i = 0; i < NUM_ITERS; i++) {
+        int pid = fork();
+        if (pid == 0) {
+            exec(exit_args[0], exit_args);
+            exit(-1);
+        }
+        if (pid < 0 || wait(&status) < 0 || status != 0)
+            exit(-1);
+    }
+    bench_end(&b, NUM_ITERS);
+
+    // fork() of a multi-threaded program is not supported, so thread last
+    thr_init(STACK_SIZE);
+    bench_start(&b, "bench_proc", "thr_create", 0);
+    for (i = 0; i < NUM_ITERS; i++) {
+        int tid = thr_create(nop, NULL);
+        if (tid < 0 || thr_join(tid, NULL) < 0)
+            exit(-1);
+    }
+    bench_end(&b, NUM_ITERS);
+
+    thr_exit(NULL);
+    return 0;
+}
@@ -0,0 +1,124 @@
+/** @file bench_sched.c
+ *  @brief Benchmark for thread switches
+ *
+ *  Two threads hand the CPU back and forth:
+ *     yield:          each thread yield()s to the other one
+ *     make_runnable:  each thread make_runnable()s the other one and 
+ *                     deschedule()s itself, on a multi-core kernel the two 
+ *                     threads may run on different cores
+ *  One iteration is a round trip. See bench.h for the output format.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <syscall.h>
+#include <thread.h>
+#include <stdlib.h>
+#include <bench.h>
+
+/** @brief Number of round trips */
+#define NUM_ITERS 2000
+
+/** @brief Stack size of a thread */
+#define STACK_SIZE 4096
+
+/** @brief ktid of the two threads */
+static volatile int ktids[2];
+
+/** @brief wakeups[i] is set when thread i should run */
+static volatile int wakeups[2];
+
+/** @brief Block until woken by the other thread
+ *
+ *  @param i Index of the calling thread
+ *
+ *  @return void
+ */
+static void wait_turn(int i) {
+    // deschedule() returns right away if the wakeup has come already
+    while (!wakeups[i])
+        deschedule((int *)&wakeups[i]);
+    wakeups[i] = 0;
+}
+
+/** @brief Wake up the other thread
+ *
+ *  @param i Index of the thread to wake up
+ *
+ *  @return void
+ */
+static void give_turn(int i) {
+    wakeups[i] = 1;
+    make_runnable(ktids[i]);
+}
+
+/** @brief The other end of the yield() ping-pong
+ *
+ *  @param arg Unused
+ *
+ *  @return NULL
+ */
+void *yielder(void *arg) {
+    int i;
+    ktids[1] = thr_getktid();
+    for (i = 0; i < NUM_ITERS; i++)
+        yield(ktids[0]);
+    return NULL;
+}
+
+/** @brief The other end of the make_runnable() ping-pong
+ *
+ *  @param arg Unused
+ *
+ *  @return NULL
+ */
+void *waker(void *arg) {
+    int i;
+    ktids[1] = thr_getktid();
+    for (i = 0; i < NUM_ITERS; i++) {
+        wait_turn(1);
+        give_turn(0);
+    }
+    return NULL;
+}
+
+int main() {
+    bench_t b;
+    int tid;
+    int i;
+
+    thr_init(STACK_SIZE);
+    ktids[0] = thr_getktid();
+
+    ktids[1] = 0;
+    tid = thr_create(yielder, NULL);
+    if (tid < 0)
+        exit(-1);
+    while (!ktids[1])
+        yield(-1);
+    bench_start(&b, "bench_sched", "yield", 0);
+    for (i = 0; i < NUM_ITERS; i++)
+        yield(ktids[1]);
+    bench_end(&b, NUM_ITERS);
+    thr_join(tid, NULL);
+
+    ktids[1] = 0;
+    tid = thr_create(waker, NULL);
+    if (tid < 0)
+        exit(-1);
+    while (!ktids[1])
+        yield(-1);
+    bench_start(&b, "bench_sched", "make_runnable", 0);
+    for (i = 0; i < NUM_ITERS; i++) {
+        give_turn(1);
+        wait_turn(0);
+    }
+    bench_end(&b, NUM_ITERS);
+    thr_join(tid, NULL);
+
+    thr_exit(NULL);
+    return 0;
+}
@@ -0,0 +1,39 @@
+/** @file bench_syscall.c
+ *  @brief Benchmark for the cost of entering and leaving the kernel
+ *
+ *  Measures a null system call (sleep(0), which returns right away), 
+ *  gettid() and get_ticks(). See bench.h for the output format.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <syscall.h>
+#include <bench.h>
+
+/** @brief Number of calls of each system call */
+#define NUM_ITERS 10000
+
+int main() {
+    bench_t b;
+    int i;
+
+    bench_start(&b, "bench_syscall", "null", 0);
+    for (i = 0; i < NUM_ITERS; i++)
+        sleep(0);
+    bench_end(&b, NUM_ITERS);
+
+    bench_start(&b, "bench_syscall", "gettid", 0);
+    for (i = 0; i < NUM_ITERS; i++)
+        gettid();
+    bench_end(&b, NUM_ITERS);
+
+    bench_start(&b, "bench_syscall", "get_ticks", 0);
+    for (i = 0; i < NUM_ITERS; i++)
+        get_ticks();
+    bench_end(&b, NUM_ITERS);
+
+    return 0;
+}
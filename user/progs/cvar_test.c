@@ -160,8 +160,7 @@ int main( int argc, char *argv[] )
 	thr_yield(instigator_tid);
 
 	
-	for (i=0;i<NR_MANIACS; ++i)
-		thrgrp_join(&maniac_grp, NULL);
+	thrgrp_join_all(&maniac_grp);
 		
 	done=1;
 	cond_signal(&c);
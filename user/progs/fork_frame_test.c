@@ -0,0 +1,154 @@
+/** @file fork_frame_test.c
+ *  @brief Test program for the kernel stack frame of forked threads
+ *
+ *  The kernel starts a child of fork() or thread_fork() from a frame built
+ *  by internal_thread_fork() on top of the registers saved by the syscall
+ *  wrapper. This program forks and creates threads many times and checks in
+ *  every child that fork() returned 0, that the data segment selectors are
+ *  the same as in the parent and that the stack of the parent was carried
+ *  over. A child that gets a bad frame faults instead of exiting with 0.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <thread.h>
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/** @brief Number of fork() */
+#define NUM_FORKS 16
+
+/** @brief Number of threads */
+#define NUM_THREADS 8
+
+/** @brief Data segment selectors */
+typedef struct {
+    /** @brief %ds */
+    unsigned int ds;
+    /** @brief %es */
+    unsigned int es;
+    /** @brief %fs */
+    unsigned int fs;
+    /** @brief %gs */
+    unsigned int gs;
+} selectors_t;
+
+/** @brief Selectors of the main thread */
+static selectors_t main_sel;
+
+/** @brief Set if any thread finds an error */
+static int is_failed;
+
+/** @brief Read the data segment selectors
+ *
+ *  @param sel Where to store the selectors
+ *
+ *  @return void
+ */
+static void get_selectors(selectors_t *sel) {
+    unsigned int v;
+
+    __asm__ __volatile__("movl %%ds, %0" : "=r"(v));
+    sel->ds = v & 0xffff;
+    __asm__ __volatile__("movl %%es, %0" : "=r"(v));
+    sel->es = v & 0xffff;
+    __asm__ __volatile__("movl %%fs, %0" : "=r"(v));
+    sel->fs = v & 0xffff;
+    __asm__ __volatile__("movl %%gs, %0" : "=r"(v));
+    sel->gs = v & 0xffff;
+}
+
+/** @brief Fork NUM_FORKS times and check every child
+ *
+ *  @return 0 on success; -1 on error
+ */
+static int test_fork() {
+    int i;
+
+    for (i = 0; i < NUM_FORKS; i++) {
+        // a value on the stack that the child must see
+        volatile int cookie = 0x410 + i;
+        selectors_t before, after;
+        int status;
+
+        get_selectors(&before);
+        int pid = fork();
+        get_selectors(&after);
+
+        if (pid == 0) {
+            if (cookie != 0x410 + i || before.ds != after.ds ||
+                before.es != after.es || before.fs != after.fs ||
+                before.gs != after.gs)
+                exit(1);
+            exit(0);
+        }
+        if (pid < 0)
+            return -1;
+        if (wait(&status) != pid || status != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/** @brief Check the selectors of a new thread
+ *
+ *  %gs is not checked, it may select the TLS segment of the thread.
+ *
+ *  @param arg The index of the thread
+ *
+ *  @return The index of the thread
+ */
+void *worker(void *arg) {
+    selectors_t sel;
+
+    get_selectors(&sel);
+    if (sel.ds != main_sel.ds || sel.es != main_sel.es ||
+        sel.fs != main_sel.fs || thr_getid() <= 0)
+        is_failed = 1;
+    return arg;
+}
+
+/** @brief Create NUM_THREADS threads and check every one of them
+ *
+ *  @return 0 on success; -1 on error
+ */
+static int test_thread_fork() {
+    int thr_ids[NUM_THREADS];
+    int i;
+
+    get_selectors(&main_sel);
+    for (i = 0; i < NUM_THREADS; i++) {
+        thr_ids[i] = thr_create(worker, (void *)i);
+        if (thr_ids[i] < 0)
+            return -1;
+    }
+    for (i = 0; i < NUM_THREADS; i++) {
+        void *status;
+        if (thr_join(thr_ids[i], &status) < 0 || status != (void *)i)
+            return -1;
+    }
+    return is_failed ? -1 : 0;
+}
+
+int main() {
+    if (test_fork() < 0) {
+        lprintf("fork_frame_test: fork() Failure");
+        exit(-1);
+    }
+
+    thr_init(4096);
+
+    if (test_thread_fork() < 0) {
+        lprintf("fork_frame_test: thread_fork() Failure");
+        exit(-1);
+    }
+
+    lprintf("fork_frame_test: Success");
+    thr_exit(NULL);
+    return 0;
+}
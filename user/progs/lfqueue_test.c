@@ -0,0 +1,156 @@
+/** @file lfqueue_test.c
+ *  @brief Test program for the lock-free queues
+ *
+ *  A few producers push distinct items to a small MPMC queue while as many
+ *  consumers pop them, so both sides often block. Every item must be popped
+ *  exactly once, and the items of one producer must be seen by a consumer
+ *  in the order they were pushed. Then a producer and a consumer pass a
+ *  sequence of items through a small SPSC ring, which must keep the order.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <thread.h>
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <lfqueue.h>
+
+/** @brief Number of producers and of consumers of the MPMC queue */
+#define NUM_THREADS 3
+
+/** @brief Number of items pushed by each producer */
+#define NUM_ITEMS 2000
+
+/** @brief Capacity of the queues */
+#define CAPACITY 8
+
+/** @brief The MPMC queue */
+static mpmc_queue_t queue;
+
+/** @brief The SPSC ring */
+static spsc_ring_t ring;
+
+/** @brief Number of times each item of the MPMC queue is popped */
+static char popped[NUM_THREADS][NUM_ITEMS];
+
+/** @brief Set if any thread finds an error */
+static int is_failed;
+
+/** @brief Push NUM_ITEMS items to the MPMC queue
+ *
+ *  @param arg Index of the producer
+ *
+ *  @return NULL
+ */
+void *producer(void *arg) {
+    int p = (int)arg;
+    int i;
+
+    for (i = 0; i < NUM_ITEMS; i++) {
+        int item = p * NUM_ITEMS + i + 1;
+        if (i % 2 || mpmc_try_push(&queue, (void *)item) < 0)
+            mpmc_push(&queue, (void *)item);
+        if (i % 100 == 0)
+            yield(-1);
+    }
+    return NULL;
+}
+
+/** @brief Pop NUM_ITEMS items from the MPMC queue
+ *
+ *  @param arg Unused
+ *
+ *  @return NULL
+ */
+void *consumer(void *arg) {
+    int last[NUM_THREADS];
+    int i;
+
+    for (i = 0; i < NUM_THREADS; i++)
+        last[i] = -1;
+
+    for (i = 0; i < NUM_ITEMS; i++) {
+        int item = (int)mpmc_pop(&queue) - 1;
+        int p = item / NUM_ITEMS;
+
+        if (item < 0 || p >= NUM_THREADS || item % NUM_ITEMS <= last[p]) {
+            is_failed = 1;
+            return NULL;
+        }
+        last[p] = item % NUM_ITEMS;
+        popped[p][last[p]]++;
+    }
+    return NULL;
+}
+
+/** @brief Push NUM_ITEMS items to the SPSC ring
+ *
+ *  @param arg Unused
+ *
+ *  @return NULL
+ */
+void *ring_producer(void *arg) {
+    int i;
+
+    for (i = 1; i <= NUM_ITEMS; i++) {
+        if (i % 2 || spsc_try_push(&ring, (void *)i) < 0)
+            spsc_push(&ring, (void *)i);
+    }
+    return NULL;
+}
+
+int main() {
+    int thr_ids[2 * NUM_THREADS];
+    void *item;
+    int i, j;
+
+    thr_init(4096);
+
+    if (mpmc_init(&queue, CAPACITY) < 0 || spsc_init(&ring, CAPACITY) < 0 ||
+            mpmc_init(&queue, 6) == 0) {
+        lprintf("lfqueue_test: init failed");
+        exit(-1);
+    }
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        thr_ids[2 * i] = thr_create(producer, (void *)i);
+        thr_ids[2 * i + 1] = thr_create(consumer, NULL);
+    }
+    for (i = 0; i < 2 * NUM_THREADS; i++)
+        thr_join(thr_ids[i], NULL);
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        for (j = 0; j < NUM_ITEMS; j++) {
+            if (popped[i][j] != 1)
+                is_failed = 1;
+        }
+    }
+    if (mpmc_try_pop(&queue, &item) == 0)
+        is_failed = 1;
+
+    thr_ids[0] = thr_create(ring_producer, NULL);
+    for (i = 1; i <= NUM_ITEMS; i++) {
+        if ((int)spsc_pop(&ring) != i)
+            is_failed = 1;
+    }
+    thr_join(thr_ids[0], NULL);
+    if (spsc_try_pop(&ring, &item) == 0)
+        is_failed = 1;
+
+    mpmc_destroy(&queue);
+    spsc_destroy(&ring);
+
+    if (is_failed) {
+        lprintf("lfqueue_test: Failure");
+        exit(-1);
+    }
+
+    lprintf("lfqueue_test: Success");
+    thr_exit(NULL);
+    return 0;
+}
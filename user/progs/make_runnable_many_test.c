@@ -0,0 +1,101 @@
+/** @file make_runnable_many_test.c
+ *  @brief Test program for make_runnable_many()
+ *
+ *  A number of threads deschedule() themselves, then the main thread makes
+ *  all of them runnable with a single make_runnable_many() call together 
+ *  with a tid that does not exist. The results of the descheduled threads 
+ *  should be zero and the result of the bogus tid should be negative.
+ *
+ *  @author Ke Wu (kewu)
+ *  @author Jian Wang (jianwan3)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <thread.h>
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/** @brief Number of threads to deschedule */
+#define NUM_THREADS 8
+
+/** @brief A tid that does not exist */
+#define BOGUS_TID 0x7fffffff
+
+/** @brief The kernel tid of each thread */
+static int ktids[NUM_THREADS];
+
+/** @brief The reject flag of each thread */
+static int rejects[NUM_THREADS];
+
+/** @brief Set by each thread after it is woken up */
+static int woken[NUM_THREADS];
+
+/** @brief Record tid and deschedule until made runnable
+ *
+ *  @param arg Index of the thread
+ *
+ *  @return NULL
+ */
+void *sleeper(void *arg) {
+    int i = (int)arg;
+    ktids[i] = gettid();
+    while (!rejects[i])
+        deschedule(&rejects[i]);
+    woken[i] = 1;
+    return NULL;
+}
+
+int main() {
+    int i;
+    int tids[NUM_THREADS + 1];
+    int thr_ids[NUM_THREADS];
+
+    thr_init(4096);
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        ktids[i] = -1;
+        rejects[i] = 0;
+        thr_ids[i] = thr_create(sleeper, (void *)i);
+        if (thr_ids[i] < 0) {
+            lprintf("make_runnable_many_test: thr_create failed");
+            exit(-1);
+        }
+    }
+
+    // wait until all threads are about to deschedule
+    for (i = 0; i < NUM_THREADS; i++) {
+        while (ktids[i] < 0)
+            yield(-1);
+    }
+    sleep(10);
+
+    for (i = 0; i < NUM_THREADS; i++)
+        tids[i] = ktids[i];
+    tids[NUM_THREADS] = BOGUS_TID;
+
+    for (i = 0; i < NUM_THREADS; i++)
+        rejects[i] = 1;
+    int rv = make_runnable_many(tids, NUM_THREADS + 1);
+    lprintf("make_runnable_many() made %d threads runnable", rv);
+
+    if (rv > NUM_THREADS || tids[NUM_THREADS] >= 0) {
+        lprintf("make_runnable_many_test: Failure");
+        exit(-1);
+    }
+
+    // a thread that didn't deschedule in time will see reject and won't block
+    for (i = 0; i < NUM_THREADS; i++) {
+        thr_join(thr_ids[i], NULL);
+        if (!woken[i]) {
+            lprintf("make_runnable_many_test: Failure");
+            exit(-1);
+        }
+    }
+
+    lprintf("make_runnable_many_test: Success");
+    thr_exit(NULL);
+    return 0;
+}
@@ -0,0 +1,297 @@
+/** @file malloc_bench.c
+ *  @brief Trace-driven benchmark for the user memory allocator
+ *
+ *  A few allocation traces are generated up front, each is a sequence of
+ *  alloc/realloc/free operations on numbered slots:
+ *     small:  random alloc and free of 1 to 256 bytes
+ *     tree:   build and tear down a tree of equal sized nodes
+ *     string: grow strings by realloc, like bistromath does
+ *     large:  random alloc and free of 1KB to 64KB
+ *  Every trace is then replayed NUM_ROUNDS times against the heap allocator
+ *  (_malloc() and friends) and against the thread-caching malloc(), and the
+ *  number of ticks taken is reported, one line per trace and allocator:
+ *     malloc_bench: trace=<name> alloc=<heap|malloc> ops=<n> ticks=<n>
+ *  The contents of every block are checked before it is freed.
+ *
+ *  @author Ke Wu (kewu)
+ *  @author Jian Wang (jianwan3)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+
+/** @brief Maximum number of operations in a trace */
+#define MAX_OPS 8000
+
+/** @brief Number of slots a trace can use */
+#define NUM_SLOTS 512
+
+/** @brief Number of times each trace is replayed */
+#define NUM_ROUNDS 10
+
+/** @brief Operation type */
+typedef enum {
+    OP_ALLOC,
+    OP_REALLOC,
+    OP_FREE
+} op_type_t;
+
+/** @brief Operation of a trace */
+typedef struct {
+    /** @brief Operation type */
+    op_type_t type;
+    /** @brief Slot to operate on */
+    int slot;
+    /** @brief Size for OP_ALLOC and OP_REALLOC */
+    int size;
+} op_t;
+
+/** @brief Trace type */
+typedef struct {
+    /** @brief Name of the trace */
+    const char *name;
+    /** @brief Number of operations */
+    int num_ops;
+    /** @brief Operations */
+    op_t ops[MAX_OPS];
+} trace_t;
+
+/** @brief Allocator interface */
+typedef struct {
+    /** @brief Name of the allocator */
+    const char *name;
+    /** @brief malloc() of the allocator */
+    void *(*alloc)(size_t);
+    /** @brief realloc() of the allocator */
+    void *(*realloc)(void *, size_t);
+    /** @brief free() of the allocator */
+    void (*free)(void *);
+} allocator_t;
+
+/** @brief The trace being generated or replayed */
+static trace_t trace;
+
+/** @brief Block in each slot during generation and replay */
+static char *slots[NUM_SLOTS];
+
+/** @brief Size of the block in each slot */
+static int sizes[NUM_SLOTS];
+
+/** @brief State of the pseudo random number generator */
+static unsigned int seed = 410;
+
+/** @brief Allocators to benchmark */
+static allocator_t allocators[] = {
+    { "heap", _malloc, _realloc, _free },
+    { "malloc", malloc, realloc, free }
+};
+
+/** @brief Get a pseudo random number
+ *
+ *  @return A pseudo random number in [0, 32768)
+ */
+static int next_rand() {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+/** @brief Append an operation to the trace
+ *
+ *  Slots are tracked in sizes[] so that the trace never frees an empty slot
+ *  or allocates to a full one.
+ *
+ *  @param type Operation type
+ *  @param slot Slot to operate on
+ *  @param size Size for OP_ALLOC and OP_REALLOC
+ *
+ *  @return void
+ */
+static void append(op_type_t type, int slot, int size) {
+    if (trace.num_ops == MAX_OPS)
+        return;
+    trace.ops[trace.num_ops].type = type;
+    trace.ops[trace.num_ops].slot = slot;
+    trace.ops[trace.num_ops].size = size;
+    trace.num_ops++;
+    sizes[slot] = (type == OP_FREE) ? 0 : size;
+}
+
+/** @brief Free every slot that is still in use at the end of the trace
+ *
+ *  @return void
+ */
+static void free_all() {
+    int i;
+    for (i = 0; i < NUM_SLOTS; i++) {
+        if (sizes[i])
+            append(OP_FREE, i, 0);
+    }
+}
+
+/** @brief Generate a trace of random alloc and free within a size range
+ *
+ *  @param name Name of the trace
+ *  @param num_slots Number of slots to use, bounds the live heap size
+ *  @param min_size Minimum size of a block
+ *  @param max_size Maximum size of a block
+ *
+ *  @return void
+ */
+static void gen_random(const char *name, int num_slots, int min_size,
+                       int max_size) {
+    trace.name = name;
+    trace.num_ops = 0;
+    memset(sizes, 0, sizeof(sizes));
+
+    while (trace.num_ops < MAX_OPS - NUM_SLOTS) {
+        int slot = next_rand() % num_slots;
+        if (sizes[slot]) {
+            append(OP_FREE, slot, 0);
+        } else {
+            int size = min_size + next_rand() % (max_size - min_size + 1);
+            append(OP_ALLOC, slot, size);
+        }
+    }
+    free_all();
+}
+
+/** @brief Generate a trace that builds and tears down trees of nodes
+ *
+ *  @return void
+ */
+static void gen_tree() {
+    int i;
+
+    trace.name = "tree";
+    trace.num_ops = 0;
+    memset(sizes, 0, sizeof(sizes));
+
+    while (trace.num_ops < MAX_OPS - 2 * NUM_SLOTS) {
+        for (i = 0; i < NUM_SLOTS; i++)
+            append(OP_ALLOC, i, 24);
+        // tear down leaves first, in post order
+        for (i = NUM_SLOTS - 1; i >= 0; i--)
+            append(OP_FREE, i, 0);
+    }
+}
+
+/** @brief Generate a trace that grows strings by realloc
+ *
+ *  @return void
+ */
+static void gen_string() {
+    trace.name = "string";
+    trace.num_ops = 0;
+    memset(sizes, 0, sizeof(sizes));
+
+    while (trace.num_ops < MAX_OPS - NUM_SLOTS) {
+        int slot = next_rand() % 64;
+        if (!sizes[slot]) {
+            append(OP_ALLOC, slot, 8);
+        } else if (sizes[slot] > 4096) {
+            append(OP_FREE, slot, 0);
+        } else {
+            append(OP_REALLOC, slot, sizes[slot] + 1 + next_rand() % 64);
+        }
+    }
+    free_all();
+}
+
+/** @brief Replay the trace with an allocator
+ *
+ *  @param allocator The allocator
+ *
+ *  @return 0 on success; -1 if out of memory or a block is corrupted
+ */
+static int replay(allocator_t *allocator) {
+    int i;
+
+    for (i = 0; i < trace.num_ops; i++) {
+        op_t *op = &trace.ops[i];
+        char *buf = slots[op->slot];
+
+        switch (op->type) {
+        case OP_ALLOC:
+            buf = allocator->alloc(op->size);
+            if (!buf)
+                return -1;
+            buf[0] = buf[op->size - 1] = (char)op->slot;
+            break;
+        case OP_REALLOC:
+            if (buf[0] != (char)op->slot)
+                return -1;
+            buf = allocator->realloc(buf, op->size);
+            if (!buf || buf[0] != (char)op->slot)
+                return -1;
+            buf[op->size - 1] = (char)op->slot;
+            break;
+        case OP_FREE:
+            if (buf[0] != (char)op->slot ||
+                buf[sizes[op->slot] - 1] != (char)op->slot)
+                return -1;
+            allocator->free(buf);
+            buf = NULL;
+            break;
+        }
+        slots[op->slot] = buf;
+        sizes[op->slot] = (op->type == OP_FREE) ? 0 : op->size;
+    }
+    return 0;
+}
+
+/** @brief Replay the trace with every allocator and report the results
+ *
+ *  @return 0 on success; -1 on error
+ */
+static int run_trace() {
+    int num_allocators = sizeof(allocators) / sizeof(allocators[0]);
+    int i, j;
+
+    for (i = 0; i < num_allocators; i++) {
+        unsigned int start = get_ticks();
+        for (j = 0; j < NUM_ROUNDS; j++) {
+            if (replay(&allocators[i]) < 0) {
+                printf("malloc_bench: trace=%s alloc=%s failed\n",
+                       trace.name, allocators[i].name);
+                return -1;
+            }
+        }
+        unsigned int ticks = get_ticks() - start;
+        printf("malloc_bench: trace=%s alloc=%s ops=%d ticks=%u\n",
+               trace.name, allocators[i].name, NUM_ROUNDS * trace.num_ops,
+               ticks);
+        lprintf("malloc_bench: trace=%s alloc=%s ops=%d ticks=%u",
+                trace.name, allocators[i].name, NUM_ROUNDS * trace.num_ops,
+                ticks);
+    }
+    return 0;
+}
+
+int main() {
+    int is_error = 0;
+
+    gen_random("small", NUM_SLOTS, 1, 256);
+    is_error |= run_trace();
+
+    gen_tree();
+    is_error |= run_trace();
+
+    gen_string();
+    is_error |= run_trace();
+
+    gen_random("large", 32, 1024, 65536);
+    is_error |= run_trace();
+
+    if (is_error) {
+        lprintf("malloc_bench: Failure");
+        exit(-1);
+    }
+    lprintf("malloc_bench: Success");
+    return 0;
+}
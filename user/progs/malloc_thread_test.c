@@ -0,0 +1,120 @@
+/** @file malloc_thread_test.c
+ *  @brief Test program for thread caches and arenas of malloc
+ *
+ *  A number of threads allocate blocks of many sizes and fill them with a
+ *  pattern. After they exit, another group of threads checks and frees the
+ *  blocks allocated by a different thread, so most frees are remote frees.
+ *  Finally every thread allocates and frees again to reuse those blocks.
+ *
+ *  @author Ke Wu (kewu)
+ *  @author Jian Wang (jianwan3)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <thread.h>
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Number of threads in each group */
+#define NUM_THREADS 6
+
+/** @brief Number of blocks allocated by each thread */
+#define NUM_BLOCKS 200
+
+/** @brief Blocks allocated by each thread */
+static char *blocks[NUM_THREADS][NUM_BLOCKS];
+
+/** @brief Set if any thread finds a corrupted block */
+static int is_failed;
+
+/** @brief Get the size of a block
+ *
+ *  @param i Index of the thread
+ *  @param j Index of the block
+ *
+ *  @return Size of the block, from 1 byte to a few KB
+ */
+static int block_size(int i, int j) {
+    return 1 + (i * 131 + j * 37) % ((j % 10 == 0) ? 3000 : 600);
+}
+
+/** @brief Allocate NUM_BLOCKS blocks and fill them
+ *
+ *  @param arg Index of the thread
+ *
+ *  @return NULL
+ */
+void *allocator(void *arg) {
+    int i = (int)arg;
+    int j;
+
+    for (j = 0; j < NUM_BLOCKS; j++) {
+        blocks[i][j] = malloc(block_size(i, j));
+        if (!blocks[i][j]) {
+            is_failed = 1;
+            return NULL;
+        }
+        memset(blocks[i][j], i + j, block_size(i, j));
+    }
+    return NULL;
+}
+
+/** @brief Check and free the blocks of another thread, then reuse them
+ *
+ *  @param arg Index of the thread
+ *
+ *  @return NULL
+ */
+void *freer(void *arg) {
+    int i = ((int)arg + 1) % NUM_THREADS;
+    int j, k;
+
+    for (j = 0; j < NUM_BLOCKS; j++) {
+        for (k = 0; k < block_size(i, j); k++) {
+            if (blocks[i][j][k] != (char)(i + j))
+                is_failed = 1;
+        }
+        free(blocks[i][j]);
+    }
+
+    for (j = 0; j < NUM_BLOCKS; j++) {
+        char *buf = malloc(block_size(i, j));
+        if (!buf) {
+            is_failed = 1;
+            return NULL;
+        }
+        memset(buf, 0, block_size(i, j));
+        free(buf);
+    }
+    return NULL;
+}
+
+int main() {
+    int i;
+    int thr_ids[NUM_THREADS];
+
+    thr_init(4096);
+
+    for (i = 0; i < NUM_THREADS; i++)
+        thr_ids[i] = thr_create(allocator, (void *)i);
+    for (i = 0; i < NUM_THREADS; i++)
+        thr_join(thr_ids[i], NULL);
+
+    for (i = 0; i < NUM_THREADS; i++)
+        thr_ids[i] = thr_create(freer, (void *)i);
+    for (i = 0; i < NUM_THREADS; i++)
+        thr_join(thr_ids[i], NULL);
+
+    if (is_failed) {
+        lprintf("malloc_thread_test: Failure");
+        exit(-1);
+    }
+
+    lprintf("malloc_thread_test: Success");
+    thr_exit(NULL);
+    return 0;
+}
@@ -3,6 +3,10 @@
  *
  * @brief A very cool, fractal test.
  *
+ * The fractal is rendered up front with parallel_for() on a thread pool, and
+ * the time it takes is reported. The wanderers then run as tasks of the same
+ * pool, one worker each.
+ *
  * @author Keith Bare
  */
 
@@ -16,7 +20,7 @@
 #include "thread.h"
 #include "cond.h"
 #include "mutex.h"
-#include "thrgrp.h"
+#include "pool.h"
 
 /* Modified code copied from shell.c */
 /* Since P3 does not require GETCHAR, we define it here */
@@ -251,10 +255,6 @@ void process_pixel(int row, int col)
         return;
     }
 
-    if (state[row][col].count < 0) {
-        state[row][col].color = mandelbrot_calc(row, col);
-    }
-
     if (state[row][col].trapped_threads >= wakeup_threshold) {
         cond_broadcast(&traps[state[row][col].trap_num]);
     } else if (state[row][col].trap_num >= 0) {
@@ -284,11 +284,26 @@ void process_pixel(int row, int col)
 }
 
 /*!
- * @brief Main function for wanderer_threads.
+ * @brief Computes the colors of a row, the body of the rendering loop.
+ *
+ * @param row row to compute
+ * @param arg unused
+ */
+void render_row(int row, void *arg)
+{
+    int col;
+
+    for (col = 0; col < CONSOLE_WIDTH; col++) {
+        state[row][col].color = mandelbrot_calc(row, col);
+    }
+}
+
+/*!
+ * @brief Main function for wanderer tasks.
  *
  * @param arg
  */
-void *wanderer_main(void *arg)
+void wanderer_main(void *arg)
 {
     int row, col;
 
@@ -317,8 +332,6 @@ void *wanderer_main(void *arg)
         }
 
     }
-
-    return NULL;
 }
 
 /*!
@@ -339,10 +352,10 @@ void usage() {
  */
 int main(int argc, char *argv[])
 {
-    thrgrp_group_t thread_group;
+    pool_t pool;
     int num_threads = 15;
     int num_traps = 8;
-    void *status;
+    unsigned int ticks;
 
     int i;
     int row, col;
@@ -399,12 +412,20 @@ int main(int argc, char *argv[])
         printf("\n");
     }
 
-    lprintf("Initializing thread group...\n");
-    assert(thrgrp_init_group(&thread_group) >= 0);
+    lprintf("Creating thread pool...\n");
+    assert(pool_init(&pool, num_threads) >= 0);
 
-    lprintf("Creating wanderer threads...\n");
+    lprintf("Rendering...\n");
+    ticks = get_ticks();
+    assert(parallel_for(&pool, 0, CONSOLE_HEIGHT - 1, 1, render_row,
+                        NULL) >= 0);
+    ticks = get_ticks() - ticks;
+    lprintf("mandelbrot: rendered %dx%d with %d workers in %u ticks\n",
+            CONSOLE_WIDTH, CONSOLE_HEIGHT - 1, num_threads, ticks);
+
+    lprintf("Submitting wanderer tasks...\n");
     for (i = 0; i < num_threads; i++) {
-        thrgrp_create(&thread_group, &wanderer_main, NULL);
+        assert(pool_submit(&pool, &wanderer_main, NULL) >= 0);
     }
 
     lprintf("Waiting to exit...\n");
@@ -427,13 +448,8 @@ int main(int argc, char *argv[])
         cond_broadcast(&traps[i]);
     }
 
-    lprintf("Joining with wanderer threads...\n");
-    for (i = 0; i < num_threads; i++) {
-        thrgrp_join(&thread_group, &status);
-    }
-
-    lprintf("Destroying thread group...\n");
-    thrgrp_destroy_group(&thread_group);
+    lprintf("Waiting for wanderer tasks and destroying thread pool...\n");
+    pool_destroy(&pool);
 
     for (row = 0; row < CONSOLE_HEIGHT - 1; row++) {
         for (col = 0; col < CONSOLE_WIDTH; col++) {
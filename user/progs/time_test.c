@@ -0,0 +1,109 @@
+/** @file time_test.c
+ *  @brief Test program for get_time_ns()
+ *
+ *  A few threads read get_time_ns() many times, yielding in between so 
+ *  that they run on different cores, and publish what they read; no thread
+ *  may ever read a time smaller than one published before its read. 
+ *  sleep() must take about as long as get_time_ns() says, and a kernel 
+ *  address must be rejected.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <thread.h>
+#include <mutex.h>
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/** @brief Number of threads */
+#define NUM_THREADS 4
+
+/** @brief Number of reads of each thread */
+#define NUM_READS 500
+
+/** @brief Number of ticks to sleep */
+#define SLEEP_TICKS 10
+
+/** @brief Nanoseconds per tick, get_ticks() runs at 100Hz */
+#define NS_PER_TICK 10000000ull
+
+/** @brief Largest time published by any thread */
+static unsigned long long published;
+
+/** @brief Mutex to protect published */
+static mutex_t published_lock;
+
+/** @brief Set if any thread finds an error */
+static int is_failed;
+
+/** @brief Read the time and check it against what has been published
+ *
+ *  @param arg Unused
+ *
+ *  @return NULL
+ */
+void *reader(void *arg) {
+    int i;
+    for (i = 0; i < NUM_READS; i++) {
+        unsigned long long before, now;
+
+        mutex_lock(&published_lock);
+        before = published;
+        mutex_unlock(&published_lock);
+
+        if (get_time_ns(&now) < 0 || now < before) {
+            is_failed = 1;
+            return NULL;
+        }
+
+        mutex_lock(&published_lock);
+        if (now > published)
+            published = now;
+        mutex_unlock(&published_lock);
+        yield(-1);
+    }
+    return NULL;
+}
+
+int main() {
+    unsigned long long start, end;
+    int tids[NUM_THREADS];
+    int i;
+
+    if (get_time_ns((unsigned long long *)0x1000) >= 0) {
+        lprintf("time_test: kernel address accepted");
+        is_failed = 1;
+    }
+
+    get_time_ns(&start);
+    sleep(SLEEP_TICKS);
+    get_time_ns(&end);
+    // sleep() may oversleep, but never by more than a few ticks here
+    if (end - start < (SLEEP_TICKS - 1) * NS_PER_TICK ||
+        end - start > (SLEEP_TICKS + 10) * NS_PER_TICK) {
+        lprintf("time_test: sleep(%d) took %llu ns", SLEEP_TICKS, 
+                end - start);
+        is_failed = 1;
+    }
+
+    thr_init(4096);
+    mutex_init(&published_lock);
+    for (i = 0; i < NUM_THREADS; i++)
+        tids[i] = thr_create(reader, NULL);
+    for (i = 0; i < NUM_THREADS; i++)
+        thr_join(tids[i], NULL);
+
+    if (is_failed) {
+        lprintf("time_test: Failure");
+        exit(-1);
+    }
+
+    lprintf("time_test: Success");
+    thr_exit(NULL);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/** @file tls_test.c
+ *  @brief Test program for thread local storage
+ *
+ *  Every thread stores its own value for a few thread specific data keys,
+ *  then yields many times so that the threads are switched in and out, and
+ *  checks that it still sees its own values and its own tid through %gs.
+ *  set_tls_base() must also reject a kernel address.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <thread.h>
+#include <thread_ext.h>
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/** @brief Number of threads */
+#define NUM_THREADS 8
+
+/** @brief Number of keys used by each thread */
+#define NUM_KEYS 4
+
+/** @brief Number of rounds of yield and check */
+#define NUM_ROUNDS 50
+
+/** @brief Thread specific data keys */
+static int keys[NUM_KEYS];
+
+/** @brief Set if any thread finds an error */
+static int is_failed;
+
+/** @brief Set, yield and check thread specific data
+ *
+ *  @param arg Unused
+ *
+ *  @return NULL
+ */
+void *worker(void *arg) {
+    int tid = thr_getid();
+    int i, j;
+
+    for (j = 0; j < NUM_KEYS; j++) {
+        if (thr_getspecific(keys[j]) != NULL)
+            is_failed = 1;
+        thr_setspecific(keys[j], (void *)(tid * NUM_KEYS + j));
+    }
+
+    for (i = 0; i < NUM_ROUNDS; i++) {
+        yield(-1);
+        if (thr_getid() != tid)
+            is_failed = 1;
+        for (j = 0; j < NUM_KEYS; j++) {
+            if (thr_getspecific(keys[j]) != (void *)(tid * NUM_KEYS + j))
+                is_failed = 1;
+        }
+    }
+    return (void *)tid;
+}
+
+int main() {
+    int thr_ids[NUM_THREADS];
+    void *status;
+    int i;
+
+    thr_init(4096);
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        if ((keys[i] = thr_key_create()) < 0)
+            is_failed = 1;
+    }
+
+    // a kernel address can not be a TLS base, and %gs must not change
+    if (set_tls_base((void *)0x1000) >= 0)
+        is_failed = 1;
+
+    for (i = 0; i < NUM_THREADS; i++)
+        thr_ids[i] = thr_create(worker, NULL);
+    for (i = 0; i < NUM_THREADS; i++) {
+        if (thr_join(thr_ids[i], &status) < 0 || (int)status != thr_ids[i])
+            is_failed = 1;
+    }
+
+    if (thr_getid() != 0 || thr_getspecific(keys[0]) != NULL)
+        is_failed = 1;
+
+    if (is_failed) {
+        lprintf("tls_test: Failure");
+        exit(-1);
+    }
+
+    lprintf("tls_test: Success");
+    thr_exit(NULL);
+    return 0;
+}
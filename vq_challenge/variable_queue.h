@@ -2,9 +2,24 @@
  *
  *  @brief Generalized queue module for data collection
  *
- *  @author Your name here
+ *  The queues are intrusive, typed, doubly linked lists. Elements embed one
+ *  link per queue they can be put in, and the head only keeps pointers to the
+ *  front and the tail element, so no node has to be allocated or looked up
+ *  to insert an element, and a known element can be removed in O(1).
+ *
+ *  All macros may evaluate their arguments more than once, so arguments
+ *  must not have side effects.
+ *
+ *  @author Jian Wang (jianwan3)
+ *  @author Ke Wu (kewu)
+ *  @bug No known bugs.
  **/
 
+#ifndef _VARIABLE_QUEUE_H_
+#define _VARIABLE_QUEUE_H_
+
+#include <stddef.h>
+
 
 
 /** @def Q_NEW_HEAD(Q_HEAD_TYPE, Q_ELEM_TYPE) 
@@ -22,7 +37,11 @@
  *  
  **/
  
-#define Q_NEW_HEAD(Q_HEAD_TYPE, Q_ELEM_TYPE) ;
+#define Q_NEW_HEAD(Q_HEAD_TYPE, Q_ELEM_TYPE)                                \
+    typedef struct {                                                        \
+        struct Q_ELEM_TYPE *front;                                          \
+        struct Q_ELEM_TYPE *tail;                                           \
+    } Q_HEAD_TYPE
 
 /** @def Q_NEW_LINK(Q_ELEM_TYPE)
  *
@@ -40,7 +59,11 @@
  *
  *  @param Q_ELEM_TYPE the type of the structure containing the link
  **/
- #define Q_NEW_LINK(Q_ELEM_TYPE) ;
+#define Q_NEW_LINK(Q_ELEM_TYPE)                                             \
+    struct {                                                                \
+        struct Q_ELEM_TYPE *next;                                           \
+        struct Q_ELEM_TYPE *prev;                                           \
+    }
  
  
 /** @def Q_INIT_HEAD(Q_HEAD)
@@ -49,7 +72,11 @@
  *         properly.
  *  @param Q_HEAD Pointer to queue head to initialize
  **/
-#define Q_INIT_HEAD(Q_HEAD) ;
+#define Q_INIT_HEAD(Q_HEAD)                                                 \
+    do {                                                                    \
+        (Q_HEAD)->front = NULL;                                             \
+        (Q_HEAD)->tail = NULL;                                              \
+    } while (0)
 
 /** @def Q_INIT_ELEM(Q_ELEM, LINK_NAME)
  *
@@ -61,7 +88,11 @@
  *  @param Q_ELEM Pointer to the structure instance containing the link
  *  @param LINK_NAME The name of the link to initialize
  **/
-#define Q_INIT_ELEM(Q_ELEM, LINK_NAME) ;
+#define Q_INIT_ELEM(Q_ELEM, LINK_NAME)                                      \
+    do {                                                                    \
+        (Q_ELEM)->LINK_NAME.next = NULL;                                    \
+        (Q_ELEM)->LINK_NAME.prev = NULL;                                    \
+    } while (0)
  
 /** @def Q_INSERT_FRONT(Q_HEAD, Q_ELEM, LINK_NAME)
  *
@@ -76,10 +107,18 @@
  *  @param Q_ELEM Pointer to the element to insert into the queue
  *  @param LINK_NAME Name of the link used to organize the queue
  *
- *  @return Void (you may change this if your implementation calls for a 
- *                return value)
+ *  @return Void
  **/
-#define Q_INSERT_FRONT(Q_HEAD, Q_ELEM, LINK_NAME) ;
+#define Q_INSERT_FRONT(Q_HEAD, Q_ELEM, LINK_NAME)                           \
+    do {                                                                    \
+        (Q_ELEM)->LINK_NAME.prev = NULL;                                    \
+        (Q_ELEM)->LINK_NAME.next = (Q_HEAD)->front;                         \
+        if ((Q_HEAD)->front != NULL)                                        \
+            (Q_HEAD)->front->LINK_NAME.prev = (Q_ELEM);                     \
+        else                                                                \
+            (Q_HEAD)->tail = (Q_ELEM);                                      \
+        (Q_HEAD)->front = (Q_ELEM);                                         \
+    } while (0)
  
 /** @def Q_INSERT_TAIL(Q_HEAD, Q_ELEM, LINK_NAME) 
  *  @brief Inserts the queue element pointed to by Q_ELEM at the end of the 
@@ -93,10 +132,18 @@
  *  @param Q_ELEM Pointer to the element to insert into the queue
  *  @param LINK_NAME Name of the link used to organize the queue
  *
- *  @return Void (you may change this if your implementation calls for a 
- *                return value)
+ *  @return Void
  **/
-#define Q_INSERT_TAIL(Q_HEAD, Q_ELEM, LINK_NAME) ;
+#define Q_INSERT_TAIL(Q_HEAD, Q_ELEM, LINK_NAME)                            \
+    do {                                                                    \
+        (Q_ELEM)->LINK_NAME.next = NULL;                                    \
+        (Q_ELEM)->LINK_NAME.prev = (Q_HEAD)->tail;                          \
+        if ((Q_HEAD)->tail != NULL)                                         \
+            (Q_HEAD)->tail->LINK_NAME.next = (Q_ELEM);                      \
+        else                                                                \
+            (Q_HEAD)->front = (Q_ELEM);                                     \
+        (Q_HEAD)->tail = (Q_ELEM);                                          \
+    } while (0)
 
 
 /** @def Q_GET_FRONT(Q_HEAD)
@@ -108,7 +155,7 @@
  *  @return Pointer to the first element in the queue, or NULL if the queue
  *          is empty
  **/
-#define Q_GET_FRONT(Q_HEAD) ;
+#define Q_GET_FRONT(Q_HEAD) ((Q_HEAD)->front)
  
 /** @def Q_GET_TAIL(Q_HEAD)
  *
@@ -119,7 +166,7 @@
  *  @return Pointer to the last element in the queue, or NULL if the queue
  *          is empty
  **/
-#define Q_GET_TAIL(Q_HEAD) ;
+#define Q_GET_TAIL(Q_HEAD) ((Q_HEAD)->tail)
 
 
 /** @def Q_GET_NEXT(Q_ELEM, LINK_NAME)
@@ -135,7 +182,7 @@
  *
  *  @return The element after Q_ELEM, or NULL if there is no next element
  **/
-#define Q_GET_NEXT(Q_ELEM, LINK_NAME) ;
+#define Q_GET_NEXT(Q_ELEM, LINK_NAME) ((Q_ELEM)->LINK_NAME.next)
  
 /** @def Q_GET_PREV(Q_ELEM, LINK_NAME)
  * 
@@ -150,7 +197,7 @@
  *
  *  @return The element before Q_ELEM, or NULL if there is no next element
  **/
-#define Q_GET_PREV(Q_ELEM, LINK_NAME) ;
+#define Q_GET_PREV(Q_ELEM, LINK_NAME) ((Q_ELEM)->LINK_NAME.prev)
 
 /** @def Q_INSERT_AFTER(Q_HEAD, Q_INQ, Q_TOINSERT, LINK_NAME)
  *
@@ -167,7 +214,16 @@
  *  @param LINK_NAME  Name of link field used to organize the queue
  **/
 
-#define Q_INSERT_AFTER(Q_HEAD,Q_INQ,Q_TOINSERT,LINK_NAME);
+#define Q_INSERT_AFTER(Q_HEAD,Q_INQ,Q_TOINSERT,LINK_NAME)                  \
+    do {                                                                    \
+        (Q_TOINSERT)->LINK_NAME.prev = (Q_INQ);                             \
+        (Q_TOINSERT)->LINK_NAME.next = (Q_INQ)->LINK_NAME.next;             \
+        if ((Q_INQ)->LINK_NAME.next != NULL)                                \
+            (Q_INQ)->LINK_NAME.next->LINK_NAME.prev = (Q_TOINSERT);         \
+        else                                                                \
+            (Q_HEAD)->tail = (Q_TOINSERT);                                  \
+        (Q_INQ)->LINK_NAME.next = (Q_TOINSERT);                             \
+    } while (0)
 
 /** @def Q_INSERT_BEFORE(Q_HEAD, Q_INQ, Q_TOINSERT, LINK_NAME)
  *
@@ -184,7 +240,16 @@
  *  @param LINK_NAME  Name of link field used to organize the queue
  **/
 
-#define Q_INSERT_BEFORE(Q_HEAD,Q_INQ,Q_TOINSERT,LINK_NAME);
+#define Q_INSERT_BEFORE(Q_HEAD,Q_INQ,Q_TOINSERT,LINK_NAME)                 \
+    do {                                                                    \
+        (Q_TOINSERT)->LINK_NAME.next = (Q_INQ);                             \
+        (Q_TOINSERT)->LINK_NAME.prev = (Q_INQ)->LINK_NAME.prev;             \
+        if ((Q_INQ)->LINK_NAME.prev != NULL)                                \
+            (Q_INQ)->LINK_NAME.prev->LINK_NAME.next = (Q_TOINSERT);         \
+        else                                                                \
+            (Q_HEAD)->front = (Q_TOINSERT);                                 \
+        (Q_INQ)->LINK_NAME.prev = (Q_TOINSERT);                             \
+    } while (0)
 
 /** @def Q_REMOVE(Q_HEAD,Q_ELEM,LINK_NAME)
  * 
@@ -202,10 +267,23 @@
  *         Q_HEAD.
  *  @param LINK_NAME The name of the link used to organize Q_HEAD's queue
  * 
- *  @return Void (if you would like to return a value, you may change this
- *                specification)
+ *  @return Void
  **/
-#define Q_REMOVE(Q_HEAD,Q_ELEM,LINK_NAME) ;
+#define Q_REMOVE(Q_HEAD,Q_ELEM,LINK_NAME)                                   \
+    do {                                                                    \
+        if ((Q_ELEM)->LINK_NAME.prev != NULL)                               \
+            (Q_ELEM)->LINK_NAME.prev->LINK_NAME.next =                      \
+                                                (Q_ELEM)->LINK_NAME.next;   \
+        else                                                                \
+            (Q_HEAD)->front = (Q_ELEM)->LINK_NAME.next;                     \
+        if ((Q_ELEM)->LINK_NAME.next != NULL)                               \
+            (Q_ELEM)->LINK_NAME.next->LINK_NAME.prev =                      \
+                                                (Q_ELEM)->LINK_NAME.prev;   \
+        else                                                                \
+            (Q_HEAD)->tail = (Q_ELEM)->LINK_NAME.prev;                      \
+        (Q_ELEM)->LINK_NAME.next = NULL;                                    \
+        (Q_ELEM)->LINK_NAME.prev = NULL;                                    \
+    } while (0)
 
 /** @def Q_FOREACH(CURRENT_ELEM,Q_HEAD,LINK_NAME) 
  *
@@ -236,4 +314,9 @@
  *         by Q_HEAD.
  **/
 
-#define Q_FOREACH(CURRENT_ELEM,Q_HEAD,LINK_NAME) ;
+#define Q_FOREACH(CURRENT_ELEM,Q_HEAD,LINK_NAME)                            \
+    for ((CURRENT_ELEM) = (Q_HEAD)->front;                                  \
+         (CURRENT_ELEM) != NULL;                                            \
+         (CURRENT_ELEM) = (CURRENT_ELEM)->LINK_NAME.next)
+
+#endif /* _VARIABLE_QUEUE_H_ */